@@ -0,0 +1,147 @@
+/**
+ * This class wraps a SegmentTree so that one writer can Update it
+ * while any number of threads Query it, without readers taking locks.
+ *
+ * It follows the Left-Right technique: two identical trees are kept.
+ * Readers always use the one that `left_right_` points to, and announce
+ * themselves on a read indicator while they do. The writer updates the
+ * other tree, points readers at it, waits for the readers still on the
+ * old tree to leave, and then repeats the update there. A query thus
+ * never sees a tree being written to, and its answer is the state after
+ * some prefix of the updates, for any Base type.
+ *
+ * Queries are wait-free. An update costs two tree updates plus waiting
+ * for the queries in flight, and the tree takes twice the memory.
+ *
+ */
+
+#ifndef _CONCURRENTSEGMENTTREE_H_
+#define _CONCURRENTSEGMENTTREE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <functional>
+
+#include "segtree.h"
+
+template <typename Base, typename Op = std::function<Base(Base&, Base&)> >
+class ConcurrentSegmentTree
+{
+
+public:
+
+    /**
+     * Creates a ConcurrentSegmentTree from given vector
+     *
+     * init_values, bin_func, type : As for SegmentTree
+     *
+     */
+    ConcurrentSegmentTree(std::vector<Base> const   &init_values,
+                          Op                        bin_func,
+                          int                       type);
+
+    /**
+     * Creates a ConcurrentSegmentTree from given leaf value and size
+     *
+     * init_value, len, bin_func, type : As for SegmentTree
+     *
+     */
+    ConcurrentSegmentTree(Base const                &init_value,
+                          std::size_t const         &len,
+                          Op                        bin_func,
+                          int                       type);
+
+    /**
+     * Queries on range [l_index, r_index], from any thread, while an
+     * update may be running.
+     *
+     * l_index, r_index: Inclusive left and right ranges, zero-indexed.
+     *
+     * Returns solution to query of Base template type.
+     *
+     */
+    Base Query(std::size_t  l_index,
+               std::size_t  r_index);
+
+    /**
+     * Performs update on a leaf. Updates from several threads are
+     * serialized, while queries keep running.
+     *
+     * new_value    : New value of leaf
+     * index        : Index of the leaf (zero indexed)
+     *
+     */
+    void Update(Base const          &new_value,
+                std::size_t const   &index);
+
+    /**
+     * Performs update on a leaf. The new value is copied into the
+     * first copy of the tree and moved into the second.
+     *
+     */
+    void Update(Base                &&new_value,
+                std::size_t const   &index);
+
+
+private:
+
+    /**
+     * Count of the readers on one version, spread over stripes
+     * on separate cache lines so that readers on different threads
+     * do not contend on a single counter.
+     *
+     */
+    class ReadIndicator
+    {
+    public:
+        ReadIndicator();
+
+        void Arrive();
+        void Depart();
+        bool IsEmpty() const;
+
+    private:
+        static std::size_t const kStripes = 16;
+
+        /**
+         * Stripe of the calling thread, picked once per thread.
+         *
+         */
+        static std::size_t Stripe();
+
+        struct alignas(64) Counter
+        {
+            std::atomic<long> count;
+        };
+
+        Counter counters_[kStripes];
+    };
+
+    /**
+     * Spins (yielding) until no reader is announced on `indicator`.
+     *
+     */
+    static void WaitForReaders(ReadIndicator const &indicator);
+
+    /**
+     * Update with the new value copied or moved into the second copy
+     * of the tree, as given.
+     *
+     */
+    template <typename Value>
+    void UpdateValue(Value              &&new_value,
+                     std::size_t const  &index);
+
+    // Private Data Members
+    SegmentTree<Base, Op>   trees_[2];          ///< the two copies of the tree
+    std::atomic<int>        left_right_;        ///< copy that readers are sent to
+    std::atomic<int>        version_index_;     ///< indicator that new readers announce on
+    ReadIndicator           indicators_[2];     ///< readers in flight per version
+    std::mutex              writer_mutex_;      ///< serializes updates
+};
+
+#include "concurrentsegtree.cpp"  //To include template members
+
+#endif
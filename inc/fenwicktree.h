@@ -0,0 +1,106 @@
+/**
+ * This class has the Query and Update interface of SegmentTree, for
+ * operations that can be undone, such as sum or xor over integers.
+ *
+ * It is a Fenwick (binary indexed) tree. Slot i holds the aggregate of
+ * the lowbit(i) values ending at leaf i, so it needs n slots where the
+ * iterative SegmentTree needs 2n nodes. A prefix is folded from the
+ * O(log n) slots met by clearing the lowest bit, and a range is the
+ * difference of two prefixes, given by the inverse operation.
+ *
+ * The operation must be commutative, with inv_func(a op b, b) == a,
+ * e.g. SumOp with DifferenceOp, or XorOp with itself.
+ *
+ */
+
+#ifndef _FENWICKTREE_H_
+#define _FENWICKTREE_H_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "monoids.h"
+
+template <typename Base,
+          typename Op = std::function<Base(Base&, Base&)>,
+          typename InvOp = Op>
+class FenwickTree
+{
+
+public:
+
+    /**
+     * Creates a FenwickTree from a vector of values, in O(n). Throws
+     * std::invalid_argument if the vector is empty.
+     *
+     * init_values  : Values of the leaves
+     * bin_func     : Lambda (or Op policy instance) to combine values
+     * inv_func     : Lambda (or policy instance) that undoes bin_func,
+     *                inv_func(a op b, b) == a
+     *
+     */
+    FenwickTree(std::vector<Base> const     &init_values,
+                Op                          bin_func,
+                InvOp                       inv_func);
+
+    /**
+     * Creates a FenwickTree with every leaf set to init_value. Throws
+     * std::invalid_argument if len is 0.
+     *
+     * init_value   : Value of every leaf
+     * len          : Number of leaves
+     * bin_func     : Lambda (or Op policy instance) to combine values
+     * inv_func     : Lambda (or policy instance) that undoes bin_func
+     *
+     */
+    FenwickTree(Base const          &init_value,
+                std::size_t const   &len,
+                Op                  bin_func,
+                InvOp               inv_func);
+
+    /**
+     * Queries on the range of leaves from l_index to r_index, both
+     * included, in O(log n).
+     *
+     * Returns solution to query of Base template type.
+     *
+     */
+    Base Query(std::size_t  l_index,
+               std::size_t  r_index);
+
+    /**
+     * Updates the leaf at index to new_value, in O(log n). The change
+     * is added to every slot over the leaf, as inv_func(new, old).
+     *
+     */
+    void Update(Base const          &new_value,
+                std::size_t const   &index);
+
+    /**
+     * Returns the number of leaves.
+     *
+     */
+    std::size_t Size() const;
+
+
+private:
+
+    /**
+     * Folds the leaves [l_bound, r_bound) as the slots of the prefix
+     * r_bound less those of the prefix l_bound. Slots shared by both
+     * prefixes are never read.
+     *
+     */
+    Base Range(std::size_t l_bound, std::size_t r_bound);
+
+    // Private Data Members
+    std::vector<Base>   tree_;      ///< slot i - 1 holds the lowbit(i) leaves ending at leaf i - 1
+    Op                  bin_func_;  ///< function that operates on tree
+    InvOp               inv_func_;  ///< inverse of bin_func_
+    std::size_t         len_;       ///< number of leaves
+};
+
+#include "fenwicktree.cpp"  //To include template members
+
+#endif
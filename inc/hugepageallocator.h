@@ -0,0 +1,142 @@
+/**
+ * An allocator for the nodes of large trees, e.g.
+ * SegmentTree<Base, Op, HugePageAllocator<Base> >.
+ *
+ * Blocks of at least kHugePageSize bytes are mapped with `mmap`,
+ * aligned to kHugePageSize, and backed by huge pages when the system
+ * has them, so a walk down a tree of gigabytes takes far fewer TLB
+ * misses. Smaller blocks come from operator new. The pages can also be
+ * bound to, or interleaved across, a set of NUMA nodes with `mbind`.
+ *
+ * Every request falls back quietly: with no reserved huge pages the
+ * block is mapped with normal pages (still advised as transparent huge
+ * pages), and a failed `mbind` leaves the pages placed by the kernel.
+ *
+ * All instances are interchangeable, whatever their settings, since a
+ * block is freed according to its size alone.
+ *
+ */
+
+#ifndef _HUGEPAGEALLOCATOR_H_
+#define _HUGEPAGEALLOCATOR_H_
+
+#include <cstddef>
+
+/**
+ * How HugePageAllocator backs the blocks it maps.
+ *
+ * HUGE_PAGES_NONE          : Normal pages only
+ * HUGE_PAGES_TRANSPARENT   : Normal pages, advised with MADV_HUGEPAGE
+ *                            so that the kernel merges them into
+ *                            transparent huge pages
+ * HUGE_PAGES_EXPLICIT      : Pages reserved in the hugetlb pool
+ *                            (MAP_HUGETLB), falling back to transparent
+ *                            huge pages when the pool is empty
+ *
+ */
+enum HugePageMode
+{
+    HUGE_PAGES_NONE         = 0,
+    HUGE_PAGES_TRANSPARENT  = 1,
+    HUGE_PAGES_EXPLICIT     = 2
+};
+
+/**
+ * Where HugePageAllocator places the blocks it maps.
+ *
+ * NUMA_DEFAULT     : Left to the kernel, usually the node of the thread
+ *                    that first touches each page
+ * NUMA_BIND        : Only on the given nodes
+ * NUMA_INTERLEAVE  : Page by page, in turn over the given nodes
+ *
+ */
+enum NumaPolicy
+{
+    NUMA_DEFAULT    = 0,
+    NUMA_BIND       = 1,
+    NUMA_INTERLEAVE = 2
+};
+
+template <typename T>
+class HugePageAllocator
+{
+
+public:
+
+    typedef T value_type;
+
+    /**
+     * Creates an allocator with the given settings.
+     *
+     * huge_pages   : A HugePageMode, HUGE_PAGES_TRANSPARENT by default
+     * numa_policy  : A NumaPolicy, NUMA_DEFAULT by default
+     * numa_nodes   : Bit i set for NUMA node i. Ignored by NUMA_DEFAULT.
+     *
+     */
+    explicit HugePageAllocator(int              huge_pages = HUGE_PAGES_TRANSPARENT,
+                               int              numa_policy = NUMA_DEFAULT,
+                               unsigned long    numa_nodes = 0);
+
+    template <typename U>
+    HugePageAllocator(HugePageAllocator<U> const &other);
+
+    /**
+     * Allocates n values. Throws std::bad_alloc if no memory is left.
+     *
+     */
+    T *allocate(std::size_t n);
+
+    /**
+     * Frees the n values at p, given by allocate(n).
+     *
+     */
+    void deallocate(T *p, std::size_t n);
+
+    int HugePages() const { return huge_pages_; }
+    int Numa() const { return numa_policy_; }
+    unsigned long NumaNodes() const { return numa_nodes_; }
+
+    static std::size_t const    kHugePageSize = std::size_t(2) << 20;   ///< size of a huge page on x86-64 and most arm64 kernels
+
+
+private:
+
+    template <typename U>
+    friend class HugePageAllocator;
+
+    /**
+     * Returns the bytes mapped for n values: rounded up to a whole
+     * number of huge pages, so that munmap also frees hugetlb pages.
+     *
+     */
+    static std::size_t MappedLength(std::size_t n);
+
+    /**
+     * Maps length bytes of normal pages, aligned to kHugePageSize.
+     * Returns NULL on failure.
+     *
+     */
+    static void *MapAligned(std::size_t length);
+
+    /**
+     * Applies numa_policy_ to the length bytes at p. Any failure, e.g.
+     * on a kernel without NUMA, is ignored.
+     *
+     */
+    void BindNuma(void *p, std::size_t length) const;
+
+    // Private Data Members
+    int             huge_pages_;    ///< a HugePageMode
+    int             numa_policy_;   ///< a NumaPolicy
+    unsigned long   numa_nodes_;    ///< bit i set for NUMA node i
+};
+
+template <typename T, typename U>
+bool operator==(HugePageAllocator<T> const &, HugePageAllocator<U> const &);
+
+template <typename T, typename U>
+bool operator!=(HugePageAllocator<T> const &, HugePageAllocator<U> const &);
+
+#include "hugepageallocator.cpp"  //To include template members
+
+#endif
@@ -0,0 +1,214 @@
+/**
+ * This class provides a segment tree with lazy propagation, so that
+ * an update can be applied to a whole range of leaves [l, r] in
+ * O(log n), alongside O(log n) range queries.
+ *
+ * A range update is described by a Tag. The user supplies how a tag
+ * changes the aggregate of a node, and how two pending tags compose,
+ * e.g. for range add / range sum:
+ *
+ *     apply_func   : [](int &sum, int &add, std::size_t count)
+ *                      { return sum + add * (int)count; }
+ *     compose_func : [](int &older, int &newer) { return older + newer; }
+ *
+ */
+
+#ifndef _LAZYSEGMENTTREE_H_
+#define _LAZYSEGMENTTREE_H_
+
+#include <cstddef>
+#include <vector>
+#include <functional>
+
+template <typename Base, typename Tag>
+class LazySegmentTree
+{
+
+public:
+
+    /**
+     * Creates a LazySegmentTree from given vector. Throws
+     * std::invalid_argument if the vector is empty.
+     *
+     * init_values  : Initial vector of leaf values
+     * bin_func     : Lambda that represents a binary closed operation
+     *                of init_values type
+     * apply_func   : Lambda returning the new value of a node, given its
+     *                current value, a tag and the number of leaves the
+     *                node covers
+     * compose_func : Lambda returning the single tag equivalent to
+     *                applying its first argument, then its second
+     * type         : False, if iterative segment tree
+     *                True, if recursive segment tree
+     *
+     */
+    LazySegmentTree(std::vector<Base> const                         &init_values,
+                    std::function<Base(Base&, Base&)>               bin_func,
+                    std::function<Base(Base&, Tag&, std::size_t)>   apply_func,
+                    std::function<Tag(Tag&, Tag&)>                  compose_func,
+                    bool                                            type);
+
+    /**
+     * Creates a LazySegmentTree from given leaf value and size.
+     * Throws std::invalid_argument if len is 0.
+     *
+     * init_value   : Initial value of all leaf nodes
+     * len          : Number of leaves in the segment tree
+     * bin_func, apply_func, compose_func, type : As above
+     *
+     */
+    LazySegmentTree(Base const                                      &init_value,
+                    std::size_t const                               &len,
+                    std::function<Base(Base&, Base&)>               bin_func,
+                    std::function<Base(Base&, Tag&, std::size_t)>   apply_func,
+                    std::function<Tag(Tag&, Tag&)>                  compose_func,
+                    bool                                            type);
+
+    /**
+     * Queries on LazySegmentTree on range [l_index, r_index]
+     *
+     * l_index, r_index: Inclusive left and right ranges, zero-indexed.
+     *
+     * Returns solution to query of Base template type.
+     *
+     */
+    Base Query(std::size_t  l_index,
+               std::size_t  r_index);
+
+    /**
+     * Applies a tag to every leaf in the range [l_index, r_index]
+     *
+     * l_index, r_index : Inclusive left and right ranges, zero-indexed.
+     * tag              : Update to apply on the range
+     *
+     */
+    void RangeUpdate(std::size_t    l_index,
+                     std::size_t    r_index,
+                     Tag const      &tag);
+
+    /**
+     * Performs update on a LazySegmentTree leaf
+     *
+     * new_value    : New value of leaf
+     * index        : Index of the leaf (zero indexed)
+     *
+     */
+    void Update(Base const          &new_value,
+                std::size_t const   &index);
+
+
+private:
+
+    /**
+     * Sets up the storage of the selected layout, before building.
+     *
+     */
+    void Allocate();
+
+    /**
+     * Build the tree in recursive fashion, taking leaf `i` from
+     * init_values[i], or init_values[0] if it holds a single value.
+     *
+     * l_index, r_index : [l_index, r_index] 0-indexed denotes current
+     *                    sub-tree range
+     * tree_index       : index of the current node of tree_ vector
+     *
+     */
+    void BuildTreeRecursive(std::size_t             l_index,
+                            std::size_t             r_index,
+                            std::vector<Base> const &init_values,
+                            std::size_t             tree_index);
+
+    /**
+     * Builds the tree in iterative fashion, taking leaf `i` from
+     * init_values[i], or init_values[0] if it holds a single value.
+     *
+     */
+    void BuildTreeIterative(std::vector<Base> const &init_values);
+
+    /**
+     * Applies tag to the node at tree_index, which covers `count` leaves,
+     * and records it as pending for the node's children.
+     *
+     */
+    void ApplyTag(std::size_t   tree_index,
+                  Tag           &tag,
+                  std::size_t   count);
+
+    /**
+     * Recursive layout: hands the pending tag of a node over to its
+     * two children, covering [l_index, boundary] and [boundary + 1, r_index].
+     *
+     */
+    void PushDown(std::size_t tree_index,
+                  std::size_t l_index,
+                  std::size_t boundary,
+                  std::size_t r_index);
+
+    Base QueryRecursive(std::size_t l_qbound,
+                        std::size_t r_qbound,
+                        std::size_t l_index,
+                        std::size_t r_index,
+                        std::size_t tree_index);
+
+    void RangeUpdateRecursive(std::size_t   l_qbound,
+                              std::size_t   r_qbound,
+                              Tag           &tag,
+                              std::size_t   l_index,
+                              std::size_t   r_index,
+                              std::size_t   tree_index);
+
+    void UpdateRecursive(Base const         &new_value,
+                         std::size_t const  &final_index,
+                         std::size_t        l_index,
+                         std::size_t        r_index,
+                         std::size_t        tree_index);
+
+    /**
+     * Iterative layout: number of real (non padding) leaves below the
+     * node at tree_index, which lies `height` levels above the leaves.
+     *
+     */
+    std::size_t LeafCount(std::size_t tree_index,
+                          std::size_t height);
+
+    /**
+     * Iterative layout: pushes all pending tags on the path from the
+     * root down to (excluding) the node at tree_index.
+     *
+     */
+    void PushPath(std::size_t tree_index);
+
+    /**
+     * Iterative layout: recomputes all ancestors of the node at
+     * tree_index, re-applying their own pending tags.
+     *
+     */
+    void PullPath(std::size_t tree_index);
+
+    Base QueryIterative(std::size_t l_qbound,
+                        std::size_t r_qbound);
+
+    void RangeUpdateIterative(std::size_t   l_qbound,
+                              std::size_t   r_qbound,
+                              Tag           &tag);
+
+    void UpdateIterative(Base const         &new_value,
+                         std::size_t const  &index);
+
+    // Private Data Members
+    std::vector<Base>                               tree_;          ///< vector that stores tree values
+    std::vector<Tag>                                tags_;          ///< pending tag of every internal node
+    std::vector<char>                               pending_;       ///< whether tags_[i] is to be pushed
+    std::function<Base(Base&, Base&)>               bin_func_;      ///< function that operates on tree
+    std::function<Base(Base&, Tag&, std::size_t)>   apply_func_;    ///< applies a tag to a node
+    std::function<Tag(Tag&, Tag&)>                  compose_func_;  ///< merges two pending tags
+    std::size_t                                     len_;           ///< number of leaves in tree
+    std::size_t                                     size_;          ///< iterative: leaves rounded up to a power of two
+    std::size_t                                     height_;        ///< iterative: log2(size_)
+    bool                                            type_;          ///< True for recursive, else iterative
+};
+
+#include "lazysegtree.cpp"  //To include template members
+
+#endif
@@ -0,0 +1,177 @@
+/**
+ * Compile-time operation policies that can be passed as the `Op`
+ * template parameter of SegmentTree, e.g.
+ *
+ *     SegmentTree<int, SumOp<int>> s_tree{values, SumOp<int>{}, false};
+ *
+ * Unlike the type-erased `std::function` default, calls to these
+ * operations are resolved statically, so they can be inlined into the
+ * build, query and update loops.
+ *
+ * A policy is any callable of the form `Base(Base const&, Base const&)`.
+ * It may additionally provide `static Base Identity()`, which is used
+ * instead of `Base{}` wherever the tree needs a neutral element.
+ *
+ * For types that are expensive to create, such as strings, the
+ * operation can instead accumulate in place, with the form
+ * `void(Base &acc, Base const &rhs)` setting `acc` to `acc op rhs`.
+ * SegmentTree then combines into nodes and partial results that
+ * already exist, reusing their storage, rather than returning a new
+ * value for every combine.
+ *
+ */
+
+#ifndef _MONOIDS_H_
+#define _MONOIDS_H_
+
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+template <typename Base>
+struct SumOp
+{
+    Base operator()(Base const &a, Base const &b) const { return a + b; }
+    static Base Identity() { return Base(0); }
+};
+
+template <typename Base>
+struct ProductOp
+{
+    Base operator()(Base const &a, Base const &b) const { return a * b; }
+    static Base Identity() { return Base(1); }
+};
+
+template <typename Base>
+struct MinOp
+{
+    Base operator()(Base const &a, Base const &b) const { return b < a ? b : a; }
+    static Base Identity() { return std::numeric_limits<Base>::max(); }
+};
+
+template <typename Base>
+struct MaxOp
+{
+    Base operator()(Base const &a, Base const &b) const { return a < b ? b : a; }
+    static Base Identity() { return std::numeric_limits<Base>::lowest(); }
+};
+
+template <typename Base>
+struct AndOp
+{
+    Base operator()(Base const &a, Base const &b) const { return a & b; }
+    static Base Identity() { return ~Base(0); }
+};
+
+template <typename Base>
+struct OrOp
+{
+    Base operator()(Base const &a, Base const &b) const { return a | b; }
+    static Base Identity() { return Base(0); }
+};
+
+template <typename Base>
+struct XorOp
+{
+    Base operator()(Base const &a, Base const &b) const { return a ^ b; }
+    static Base Identity() { return Base(0); }
+};
+
+/**
+ * Inverse of SumOp, returning `a - b`, for FenwickTree. XorOp is its
+ * own inverse.
+ *
+ */
+template <typename Base>
+struct DifferenceOp
+{
+    Base operator()(Base const &a, Base const &b) const { return a - b; }
+};
+
+
+/**
+ * Resolves the neutral element of an operation: `Op::Identity()` if the
+ * operation declares one, otherwise a value initialized `Base{}` (the
+ * behaviour the tree has always relied on for `std::function` operations).
+ *
+ */
+template <typename Base, typename Op>
+class MonoidIdentity
+{
+    template <typename T>
+    static auto Pick(int) -> decltype(T::Identity(), Base())
+    {
+        return T::Identity();
+    }
+
+    template <typename T>
+    static Base Pick(...)
+    {
+        return Base{};
+    }
+
+public:
+
+    static Base Get() { return Pick<Op>(0); }
+};
+
+/**
+ * IsInPlaceOp<Base, Op>::value is true if Op has the in-place form
+ * `void(Base &acc, Base const &rhs)`.
+ *
+ */
+template <typename Base, typename Op>
+class IsInPlaceOp
+{
+    template <typename T>
+    static auto Test(int) -> typename std::is_void<decltype(
+        std::declval<T &>()(std::declval<Base &>(), std::declval<Base const &>()))>::type;
+
+    template <typename T>
+    static std::false_type Test(...);
+
+public:
+
+    static bool const value = decltype(Test<Op>(0))::value;
+};
+
+/**
+ * Applies an operation of either form.
+ *
+ * Accumulate sets `acc` to `acc op rhs`. Combine sets `out` to `a op b`;
+ * `out` may be `a` itself, but not `b`. With an in-place operation,
+ * `a` is copy assigned into `out`, which keeps the storage `out`
+ * already holds, then `b` is accumulated.
+ *
+ */
+template <typename Base, typename Op, bool InPlace = IsInPlaceOp<Base, Op>::value>
+struct MonoidCombine
+{
+    static void Accumulate(Op &op, Base &acc, Base &rhs)
+    {
+        acc = op(acc, rhs);
+    }
+
+    static void Combine(Op &op, Base &out, Base &a, Base &b)
+    {
+        out = op(a, b);
+    }
+};
+
+template <typename Base, typename Op>
+struct MonoidCombine<Base, Op, true>
+{
+    static void Accumulate(Op &op, Base &acc, Base const &rhs)
+    {
+        op(acc, rhs);
+    }
+
+    static void Combine(Op &op, Base &out, Base const &a, Base const &b)
+    {
+        if (&out != &a)
+            out = a;
+        op(out, b);
+    }
+};
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * This class provides a persistent segment tree: earlier versions of
+ * the tree can still be queried after it has been updated.
+ *
+ * Nodes live in an arena and refer to their children by index, so
+ * versions share all the nodes they have in common. An update copies
+ * the O(log n) nodes on the path from the root to its leaf, unless
+ * they were created after the last snapshot, since those belong to
+ * the current version alone and are updated in place.
+ *
+ * Snapshot() freezes the current version and returns a handle to it.
+ * Release() drops a handle. Once the arena has doubled in size since
+ * it was last compacted, the nodes of released versions are freed in
+ * bulk by copying the reachable nodes to a new arena, so memory grows
+ * with the number of updates, not with n times the number of versions.
+ *
+ */
+
+#ifndef _PERSISTENTSEGMENTTREE_H_
+#define _PERSISTENTSEGMENTTREE_H_
+
+#include <cstddef>
+#include <map>
+#include <vector>
+#include <functional>
+
+template <typename Base, typename Op = std::function<Base(Base&, Base&)> >
+class PersistentSegmentTree
+{
+
+public:
+
+    /**
+     * Creates a PersistentSegmentTree from given vector
+     *
+     * init_values  : Initial vector of leaf values
+     * bin_func     : Lambda (or Op policy instance) that represents a
+     *                binary closed operation of init_values type
+     *
+     */
+    PersistentSegmentTree(std::vector<Base> const   &init_values,
+                          Op                        bin_func);
+
+    /**
+     * Creates a PersistentSegmentTree from given leaf value and size.
+     * Subtrees of the same size are shared, so it takes O(log n) nodes.
+     *
+     * init_value   : Initial value of all leaf nodes
+     * len          : Number of leaves in the segment tree
+     * bin_func     : As above
+     *
+     */
+    PersistentSegmentTree(Base const                &init_value,
+                          std::size_t const         &len,
+                          Op                        bin_func);
+
+    /**
+     * Queries the current version on range [l_index, r_index]
+     *
+     * l_index, r_index: Inclusive left and right ranges, zero-indexed.
+     *
+     * Returns solution to query of Base template type.
+     *
+     */
+    Base Query(std::size_t  l_index,
+               std::size_t  r_index);
+
+    /**
+     * Queries a snapshot on range [l_index, r_index]
+     *
+     * version          : Handle returned by Snapshot(), not released
+     * l_index, r_index : As above
+     *
+     */
+    Base Query(std::size_t  version,
+               std::size_t  l_index,
+               std::size_t  r_index);
+
+    /**
+     * Performs update on a leaf of the current version
+     *
+     * new_value    : New value of leaf
+     * index        : Index of the leaf (zero indexed)
+     *
+     */
+    void Update(Base const          &new_value,
+                std::size_t const   &index);
+
+    /**
+     * Freezes the current version, in O(1).
+     *
+     * Returns the handle of the snapshot, to be passed to Query.
+     *
+     */
+    std::size_t Snapshot();
+
+    /**
+     * Drops a snapshot. Its nodes are freed with the next compaction.
+     *
+     * version  : Handle returned by Snapshot(), not released
+     *
+     */
+    void Release(std::size_t version);
+
+    /**
+     * Returns the number of nodes in the arena, live or not.
+     *
+     */
+    std::size_t NodeCount() const;
+
+
+private:
+
+    struct Node
+    {
+        Base        value;      ///< value of the subtree
+        std::size_t left;       ///< arena index of the left child, kNone for a leaf
+        std::size_t right;      ///< arena index of the right child, kNone for a leaf
+    };
+
+    /**
+     * Builds the subtree over [l_index, r_index] from init_values,
+     * returning the arena index of its root.
+     *
+     */
+    std::size_t BuildRecursive(std::size_t              l_index,
+                               std::size_t              r_index,
+                               std::vector<Base> const  &init_values);
+
+    /**
+     * Builds a subtree of `len` leaves equal to init_value, reusing
+     * the subtrees of the same size recorded in `built`.
+     *
+     */
+    std::size_t BuildShared(std::size_t                             len,
+                            Base const                              &init_value,
+                            std::map<std::size_t, std::size_t>      &built);
+
+    /**
+     * Appends a node to the arena, returning its index.
+     *
+     */
+    std::size_t NewNode(Base const  &value,
+                        std::size_t left,
+                        std::size_t right);
+
+    Base QueryRecursive(std::size_t l_qbound,
+                        std::size_t r_qbound,
+                        std::size_t l_index,
+                        std::size_t r_index,
+                        std::size_t node);
+
+    /**
+     * Updates a leaf below `node`, copying the nodes that are frozen,
+     * and returns the index of the (possibly new) node.
+     *
+     */
+    std::size_t UpdateRecursive(Base const          &new_value,
+                                std::size_t const   &final_index,
+                                std::size_t         l_index,
+                                std::size_t         r_index,
+                                std::size_t         node);
+
+    /**
+     * Throws std::out_of_range unless [l_index, r_index] is a valid range.
+     *
+     */
+    void CheckRange(std::size_t l_index,
+                    std::size_t r_index) const;
+
+    /**
+     * Returns the root of a snapshot, or throws std::invalid_argument
+     * if it does not exist or was released.
+     *
+     */
+    std::size_t RootOf(std::size_t version) const;
+
+    /**
+     * Moves the nodes reachable from the current version and the
+     * retained snapshots to a new arena, dropping the others.
+     *
+     */
+    void Compact();
+
+    /**
+     * Copies the subtree at `node` into `arena`, once per node.
+     *
+     */
+    std::size_t CopyReachable(std::size_t               node,
+                              std::vector<Node>         &arena,
+                              std::vector<std::size_t>  &moved);
+
+    // Private Data Members
+    std::vector<Node>           nodes_;         ///< arena shared by all versions
+    std::vector<std::size_t>    versions_;      ///< root of each snapshot, kNone once released
+    std::size_t                 root_;          ///< root of the current version
+    std::size_t                 mutable_from_;  ///< nodes from here on are only in the current version
+    std::size_t                 compacted_;     ///< arena size after the last build or compaction
+    Op                          bin_func_;      ///< function that operates on tree
+    std::size_t                 len_;           ///< number of leaves in tree
+
+    static std::size_t const    kNone = static_cast<std::size_t>(-1);   ///< no node: a leaf's child, a released version
+};
+
+#include "persistentsegtree.cpp"  //To include template members
+
+#endif
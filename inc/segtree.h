@@ -2,15 +2,103 @@
  * This class provides an interface to a segment (or an interval) tree
  * that operates on generic data using a generic function.
  *
+ * Base : Type of the data stored in the tree
+ * Op   : Type of the binary operation. Defaults to a type-erased
+ *        `std::function`; a policy type such as those in `monoids.h`
+ *        lets the compiler inline the operation into every loop.
+ * Alloc: Allocator of the nodes, `std::allocator` by default. See
+ *        `hugepageallocator.h` for one backed by huge pages.
+ *
  */
 
 #ifndef _SEGMENTTREE_H_
 #define _SEGMENTTREE_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
 #include <vector>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#include "monoids.h"
+#include "simd_kernels.h"
+#include "treestorage.h"
+
+/**
+ * Storage layouts of a SegmentTree, selected through the `type` argument
+ * of the constructors. `false` and `true` keep selecting the iterative
+ * and recursive layouts.
+ *
+ * TREE_ITERATIVE   : Bottom-up binary tree, leaves at [n, 2n)
+ * TREE_RECURSIVE   : Top-down binary tree in heap order
+ * TREE_WIDE        : Bottom-up tree with a fan-out of kWideFanout, about
+ *                    4x shallower. Siblings are contiguous and carry
+ *                    prefix and suffix aggregates within their group,
+ *                    so a query reads one node per side and level.
+ * TREE_BLOCKED     : Leaves stored contiguously in blocks of kBlockSize,
+ *                    with an iterative tree over the block aggregates
+ *                    only. The blocks at the ends of a query are
+ *                    folded leaf by leaf (or by the SIMD kernel).
+ * TREE_COMPACT     : Top-down binary tree in exactly 2n - 1 nodes. The
+ *                    left child of a node follows it, and its right
+ *                    child follows the whole left subtree.
+ * TREE_VEB         : Top-down binary tree in van Emde Boas order. The
+ *                    top half of the levels is stored first, then each
+ *                    subtree hanging below it, each laid out the same
+ *                    way, so a root-to-leaf path touches O(log_B n)
+ *                    cache lines of B nodes whatever B is.
+ *
+ */
+enum TreeType
+{
+    TREE_ITERATIVE  = 0,
+    TREE_RECURSIVE  = 1,
+    TREE_WIDE       = 2,
+    TREE_BLOCKED    = 3,
+    TREE_COMPACT    = 4,
+    TREE_VEB        = 5
+};
+
+/**
+ * IsIterator<T>::value is true if T is an iterator type, so that the
+ * iterator pair constructor of SegmentTree does not take calls meant
+ * for the (value, length) one.
+ *
+ */
+template <typename T, typename = void>
+struct IsIterator : std::false_type
+{
+};
+
+template <typename T>
+struct IsIterator<T, typename std::conditional<
+    false, typename std::iterator_traits<T>::iterator_category, void>::type>
+    : std::true_type
+{
+};
+
+/**
+ * How SegmentTree::Open maps a saved tree into memory.
+ *
+ * MAP_READ_ONLY        : Queries only; updates throw std::logic_error
+ * MAP_COPY_ON_WRITE    : Updates change private copies of the pages
+ *                        they touch, never the file
+ *
+ */
+enum MapMode
+{
+    MAP_READ_ONLY       = 0,
+    MAP_COPY_ON_WRITE   = 1
+};
 
-template <typename Base>
+template <typename Base,
+          typename Op = std::function<Base(Base&, Base&)>,
+          typename Alloc = std::allocator<Base> >
 class SegmentTree
 {
 
@@ -20,31 +108,115 @@ public:
      * Creates a SegmentTree from given vector
      *
      * init_values  : Initial vector of leaf values
-     * bin_func     : Lambda that represents a binary closed operation 
-     *                of init_values type
-     * type         : False, if iterative segment tree
-     *                True, if recursive segment tree
+     * bin_func     : Lambda (or Op policy instance) that represents a 
+     *                binary closed operation of init_values type
+     * type         : False (TREE_ITERATIVE), if iterative segment tree
+     *                True (TREE_RECURSIVE), if recursive segment tree
+     *                TREE_WIDE, if wide segment tree
+     *                TREE_BLOCKED, if blocked segment tree
+     *                TREE_COMPACT, if compact recursive segment tree
+     *                TREE_VEB, if recursive segment tree in vEB order
+     * threads      : Number of threads that build the tree, 1 by default.
+     *                Used by all types but the wide one, and only
+     *                worth it for millions of leaves.
+     * alloc        : Allocator of the nodes, Alloc() by default
      *
      */
     SegmentTree(std::vector<Base> const             &init_values, 
-                std::function<Base(Base&, Base&)>   bin_func, 
-                bool                                type);
+                Op                                  bin_func, 
+                int                                 type,
+                std::size_t                         threads = 1,
+                Alloc const                         &alloc = Alloc());
 
     /**
      * Creates a SegmentTree from given leaf value and size
      * 
      * init_value   : Initial value of all leaf nodes 
      * len          : Number of leaves in the segment tree
-     * bin_func     : Lambda that represents a binary closed operation 
-     *                of init_values type
-     * type         : False, if iterative segment tree
-     *                True, if recursive segment tree
+     * bin_func     : Lambda (or Op policy instance) that represents a 
+     *                binary closed operation of init_values type
+     * type         : False (TREE_ITERATIVE), if iterative segment tree
+     *                True (TREE_RECURSIVE), if recursive segment tree
+     *                TREE_WIDE, if wide segment tree
+     *                TREE_BLOCKED, if blocked segment tree
+     *                TREE_COMPACT, if compact recursive segment tree
+     *                TREE_VEB, if recursive segment tree in vEB order
+     * threads      : As above
+     * alloc        : As above
      *
      */
     SegmentTree(Base const                          &init_value, 
                 std::size_t const                   &len, 
-                std::function<Base(Base&, Base&)>   bin_func, 
-                bool                                type);
+                Op                                  bin_func, 
+                int                                 type,
+                std::size_t                         threads = 1,
+                Alloc const                         &alloc = Alloc());
+
+    /**
+     * Creates a SegmentTree from given vector, moving the leaf values
+     * out of it. The vector is left empty, its memory released before
+     * the internal nodes are built.
+     *
+     * init_values, bin_func, type, threads, alloc : As above
+     *
+     */
+    SegmentTree(std::vector<Base>                   &&init_values,
+                Op                                  bin_func,
+                int                                 type,
+                std::size_t                         threads = 1,
+                Alloc const                         &alloc = Alloc());
+
+    /**
+     * Creates a SegmentTree from the leaf values in [first, last),
+     * written straight into the tree when the iterators can be
+     * traversed twice (forward iterators). Single pass input iterators
+     * are first read into a vector, since the length must be known.
+     *
+     * first, last                  : Iterators to the leaf values
+     * bin_func, type, threads      : As above
+     * alloc                        : As above
+     *
+     */
+    template <typename InputIt, typename = typename std::enable_if<IsIterator<InputIt>::value>::type>
+    SegmentTree(InputIt                             first,
+                InputIt                             last,
+                Op                                  bin_func,
+                int                                 type,
+                std::size_t                         threads = 1,
+                Alloc const                         &alloc = Alloc());
+
+    /**
+     * Creates a SegmentTree from a text file of whitespace separated
+     * leaf values, such as the files in docs/data, each read with
+     * operator>>. The file is read twice: once to count the values,
+     * then to parse them straight into the leaves, so no vector of all
+     * leaves is ever held. Throws std::runtime_error if the file cannot
+     * be read, holds no values, or a value cannot be parsed.
+     *
+     * path                             : File of leaf values
+     * bin_func, type, threads, alloc   : As for the constructors
+     *
+     */
+    static SegmentTree LoadText(std::string const   &path,
+                                Op                  bin_func,
+                                int                 type,
+                                std::size_t         threads = 1,
+                                Alloc const         &alloc = Alloc());
+
+    /**
+     * Creates a SegmentTree from a file holding the leaf values as a
+     * raw array of a trivially copyable Base, read in chunks of
+     * kLoadChunk values. Throws std::runtime_error if the file cannot
+     * be read, is empty, or its size is not a multiple of sizeof(Base).
+     *
+     * path, bin_func, type, threads, alloc : As for LoadText
+     *
+     */
+    static SegmentTree LoadBinary(std::string const     &path,
+                                  Op                    bin_func,
+                                  int                   type,
+                                  std::size_t           threads = 1,
+                                  Alloc const           &alloc = Alloc());
 
     /**
      * Queries on SegmentTree on range [l_index, r_index]
@@ -57,6 +229,67 @@ public:
     Base Query(std::size_t  l_index, 
                std::size_t  r_index); 
 
+    /**
+     * Answers many queries at once, validating all of them before
+     * any work is done.
+     *
+     * ranges       : Inclusive [l_index, r_index] pairs, zero-indexed
+     * results      : Resized to ranges.size(); results[i] holds the 
+     *                answer to ranges[i]
+     *
+     * The iterative tree advances groups of kBatchGroup queries one
+     * level at a time in lockstep, without data dependent branches, so
+     * the memory accesses of a whole group overlap instead of each
+     * query waiting on its own cache misses. Group state lives on the
+     * stack, so a batch does not allocate beyond resizing `results`.
+     *
+     */
+    void QueryBatch(std::vector<std::pair<std::size_t, std::size_t> > const &ranges,
+                    std::vector<Base>                                       &results);
+
+    /**
+     * Finds the first index r >= l_index for which pred holds on the
+     * value of the range [l_index, r], descending the tree once, in
+     * O(log n) calls to pred and the operation.
+     *
+     * l_index  : Left end of the ranges, zero-indexed
+     * pred     : Callable taking a Base const&. It must be monotone:
+     *            once true for some r, it is true for every larger r.
+     *
+     * Returns r, or the number of leaves if pred holds for no range.
+     *
+     */
+    template <typename Pred>
+    std::size_t FindFirst(std::size_t   l_index,
+                          Pred          pred);
+
+    /**
+     * Finds the last index l <= r_index for which pred holds on the
+     * value of the range [l, r_index], descending the tree once.
+     *
+     * r_index  : Right end of the ranges, zero-indexed
+     * pred     : Callable taking a Base const&. It must be monotone:
+     *            once true for some l, it is true for every smaller l.
+     *
+     * Returns l, or the number of leaves if pred holds for no range.
+     *
+     */
+    template <typename Pred>
+    std::size_t FindLast(std::size_t    r_index,
+                         Pred           pred);
+
+    /**
+     * Finds the first index i for which the value of [0, i] is not
+     * less than `value`, e.g. where a prefix sum of non-negative
+     * leaves reaches it. Prefix values must not decrease with i.
+     *
+     * value    : Bound to compare the prefixes with, using operator<
+     *
+     * Returns i, or the number of leaves if no prefix reaches value.
+     *
+     */
+    std::size_t PrefixLowerBound(Base const &value);
+
     /**
      * Performs update on a SegmentTree leaf
      *
@@ -67,14 +300,75 @@ public:
     void Update(Base const          &new_value, 
                 std::size_t const   &index);
 
+    /**
+     * Performs update on a SegmentTree leaf, moving the new value
+     * into it instead of copying it.
+     *
+     * new_value    : New value of leaf
+     * index        : Index of the leaf (zero indexed)
+     *
+     */
+    void Update(Base                &&new_value, 
+                std::size_t const   &index);
+
+    /**
+     * Performs updates on many SegmentTree leaves at once. All leaves
+     * are written first, then every ancestor of a written leaf is 
+     * recomputed a single time, level by level.
+     *
+     * indices      : Indices of the leaves (zero indexed)
+     * values       : values[i] is the new value of leaf indices[i]; for
+     *                a repeated index the last value wins
+     *
+     */
+    void UpdateBatch(std::vector<std::size_t> const  &indices,
+                     std::vector<Base> const         &values);
+
+    /**
+     * Overwrites a contiguous run of leaves in O(k + log n), for k
+     * written leaves.
+     *
+     * first_index  : Index of the first leaf to overwrite (zero indexed)
+     * begin, end   : Forward iterators to the new leaf values
+     *
+     */
+    template <typename ForwardIt>
+    void Assign(std::size_t first_index,
+                ForwardIt   begin,
+                ForwardIt   end);
+
+    /**
+     * Appends a leaf in amortized O(log n), for the iterative type.
+     * Throws std::logic_error for the other types.
+     *
+     * new_value    : Value of the new last leaf, copied or moved in
+     *
+     * The leaves are then kept in a power of two capacity, padded with
+     * the identity. When it is full, it doubles: the existing nodes are
+     * moved, one level at a time, into the left half of a tree twice as
+     * large, without computing any of them again. A tree built with a
+     * length that is not a power of two is rebuilt once, on its first
+     * growth.
+     *
+     */
+    void PushBack(Base const &new_value);
+
+    void PushBack(Base &&new_value);
+
+    /**
+     * Returns the number of leaves.
+     *
+     */
+    std::size_t Size() const;
+
     /**
      * Static method that returns the total size necessary
-     * to store a SegmentTree
+     * to store a SegmentTree of type TREE_RECURSIVE
      *
      * len  : Number of leaf nodes
      *
      */
-    static size_t GetTreeSize(size_t const &len);
+    static std::size_t GetTreeSize(std::size_t const &len);
 
     /**
      * Updates the current lambda that operates of the SegmentTree
@@ -84,7 +378,39 @@ public:
      * TODO: Improve or change utility of this function.
      *
      */ 
-    void UpdateFunction(std::function<Base(Base&, Base&)> bin_func);
+    void UpdateFunction(Op bin_func);
+
+    /**
+     * Writes the tree to a file that Open can map back, for trivially
+     * copyable Base types. Throws std::runtime_error if the file
+     * cannot be written.
+     *
+     * path : File to create or overwrite
+     *
+     */
+    void Save(std::string const &path);
+
+    /**
+     * Maps a tree written by Save. The nodes are used in place, so
+     * opening costs page faults as they are read, not a rebuild.
+     * Throws std::runtime_error if the file cannot be mapped, was
+     * not saved from a tree of the same Base size, or its header does
+     * not describe a valid layout.
+     *
+     * path     : File written by Save
+     * bin_func : Lambda (or Op policy instance) the tree was built with
+     * mode     : MAP_READ_ONLY or MAP_COPY_ON_WRITE
+     * verify   : Whether to check the checksum of the header, layout
+     *            words and nodes, which reads every node
+     * alloc    : Allocator of the nodes once they are no longer mapped,
+     *            e.g. when PushBack grows the tree
+     *
+     */
+    static SegmentTree Open(std::string const   &path,
+                            Op                  bin_func,
+                            int                 mode = MAP_READ_ONLY,
+                            bool                verify = false,
+                            Alloc const         &alloc = Alloc());
 
     /**
      * For developing purposes, print segment tree values.
@@ -94,6 +420,173 @@ public:
 
 private:
 
+    /**
+     * Creates an empty tree, to be filled by Open or the loaders.
+     *
+     */
+    explicit SegmentTree(Op bin_func, Alloc const &alloc = Alloc());
+
+    /**
+     * Allocates and builds the tree of the current type_ for len_
+     * leaves, taking the leaf values in order from next(). Throws
+     * std::invalid_argument for an unknown type.
+     *
+     * next     : Returns the next leaf value each time it is called
+     * threads  : Threads that build the iterative levels
+     *
+     */
+    template <typename NextLeaf>
+    void BuildFromSequence(NextLeaf     next,
+                           std::size_t  threads);
+
+    /**
+     * Recursive build taking the leaf values in order from next(),
+     * since the leaves are reached from left to right.
+     *
+     */
+    template <typename NextLeaf>
+    void BuildTreeRecursiveFrom(std::size_t l_index,
+                                std::size_t r_index,
+                                NextLeaf    &next,
+                                std::size_t tree_index);
+
+    /**
+     * Iterator pair construction, for iterators that can be traversed
+     * twice, and for single pass ones.
+     *
+     */
+    template <typename ForwardIt>
+    void BuildFromRange(ForwardIt                   first,
+                        ForwardIt                   last,
+                        std::size_t                 threads,
+                        std::forward_iterator_tag);
+
+    template <typename InputIt>
+    void BuildFromRange(InputIt                     first,
+                        InputIt                     last,
+                        std::size_t                 threads,
+                        std::input_iterator_tag);
+
+    /**
+     * Throws std::invalid_argument if the tree has no leaves and is not
+     * iterative.
+     *
+     */
+    void CheckLeaves();
+
+    /**
+     * Throws std::logic_error if the tree is mapped read-only.
+     *
+     */
+    void CheckWritable();
+
+    /**
+     * Whether the tree is traversed top-down, in the order of
+     * TREE_RECURSIVE, TREE_COMPACT or TREE_VEB.
+     *
+     */
+    bool IsRecursive() const;
+
+    /**
+     * Returns the number of nodes of the recursive layouts: exactly
+     * 2 * len_ - 1 for TREE_COMPACT, GetTreeSize(len_) otherwise.
+     *
+     */
+    std::size_t RecursiveTreeSize() const;
+
+    /**
+     * Indices of the children of a node of the recursive layouts. For
+     * TREE_VEB these are heap indices, as for TREE_RECURSIVE, which
+     * NodePosition translates.
+     *
+     * tree_index       : index of the node
+     * l_index          : left end of the range of the node
+     * boundary         : last leaf of the left child
+     *
+     */
+    std::size_t LeftChild(std::size_t tree_index) const;
+
+    std::size_t RightChild(std::size_t  tree_index,
+                           std::size_t  l_index,
+                           std::size_t  boundary) const;
+
+    /**
+     * Returns the position in tree_ of a node of the recursive layouts:
+     * its index, or for TREE_VEB the vEB position of its heap index.
+     *
+     */
+    std::size_t NodePosition(std::size_t tree_index) const;
+
+    /**
+     * One step of the translation of a heap index to its vEB position,
+     * for the nodes of one depth: the node lies in the bottom subtree
+     * number (path >> shift) & mask of some split, which adds
+     * base + number * size to its position.
+     *
+     */
+    struct VebStep
+    {
+        std::size_t     shift;      ///< bits of the path below the top of the split
+        std::size_t     mask;       ///< one bit per level of the top of the split
+        std::size_t     base;       ///< nodes of the top of the split
+        std::size_t     size;       ///< nodes of each bottom subtree
+    };
+
+    /**
+     * Fills veb_steps_ for a tree of GetTreeSize(len_) nodes, so that
+     * NodePosition only reads precomputed steps.
+     *
+     */
+    void BuildVebSteps();
+
+    /**
+     * Layout of the files written by Save: this header, meta_count
+     * words of layout specific data (the wide tree's stride and level
+     * offsets), then the nodes from data_offset on.
+     *
+     */
+    struct FileHeader
+    {
+        char            magic[8];       ///< kFileMagic
+        std::uint32_t   version;        ///< kFileVersion
+        std::uint32_t   type;           ///< TreeType of the tree
+        std::uint64_t   len;            ///< number of leaves
+        std::uint64_t   base_size;      ///< sizeof(Base)
+        std::uint64_t   node_count;     ///< size of tree_
+        std::uint64_t   meta_count;     ///< layout words after the header
+        std::uint64_t   data_offset;    ///< file offset of the nodes
+        std::uint64_t   checksum;       ///< of the header (with this field 0), layout words and nodes
+    };
+
+    /**
+     * Throws std::runtime_error unless the header and layout words of
+     * the file at path describe a tree this build can map: a known
+     * type, and as many nodes and layout words as that type needs for
+     * header.len leaves.
+     *
+     */
+    static void CheckHeader(FileHeader const                    &header,
+                            std::vector<std::uint64_t> const    &meta,
+                            std::string const                   &path);
+
+    /**
+     * Checksum of a file: the header with its checksum field zeroed,
+     * then the layout words and the nodes.
+     *
+     */
+    static std::uint64_t FileChecksum(FileHeader                        header,
+                                      std::vector<std::uint64_t> const  &meta,
+                                      Base const                        *nodes);
+
+    /**
+     * FNV-1a style hash of `size` bytes, 8 at a time, continuing
+     * from `hash`.
+     *
+     */
+    static std::uint64_t Checksum(void const    *bytes,
+                                  std::size_t   size,
+                                  std::uint64_t hash);
+
     /**
      * Build the segment tree with given vector for all leaf values
      * in recursive fashion.
@@ -127,21 +620,70 @@ private:
                             Base const  &init_value, 
                             std::size_t tree_index);
 
+    /**
+     * Recursive build with the two subtrees of each node built by
+     * separate threads, until every thread has its own subtree.
+     *
+     * init         : vector for leaf nodes, or value of all of them
+     * threads      : threads available for this subtree
+     * Other arguments as in BuildTreeRecursive
+     *
+     */
+    template <typename Source>
+    void BuildTreeRecursiveParallel(std::size_t     l_index,
+                                    std::size_t     r_index,
+                                    Source const    &init,
+                                    std::size_t     tree_index,
+                                    std::size_t     threads);
+
     /**
      * Builds segment tree with given vector in iterative fashion.
      *
      * init_values  : vector for leaf nodes of the tree.
+     * threads      : threads that copy the leaves and build the levels
      *
      */
-    void BuildTreeIterative(std::vector<Base> const &init_values);
+    void BuildTreeIterative(std::vector<Base> const &init_values,
+                            std::size_t             threads);
 
     /**
      * Builds segment tree with given vector in iterative fashion.
      *
-     * init_values  : vector for leaf nodes of the tree.
+     * init_value   : value of all leaf nodes of the tree.
+     * threads      : threads that copy the leaves and build the levels
+     *
+     */
+    void BuildTreeIterative(Base const  &init_value,
+                            std::size_t threads);
+
+    /**
+     * Computes every internal node of the iterative tree from the
+     * leaves, in passes of contiguous nodes that are handed to the
+     * SIMD kernel of the operation when it has one. Large passes are
+     * split across threads.
+     *
+     */
+    void BuildInternalIterative(std::size_t threads);
+
+    /**
+     * Computes the iterative tree nodes [first, last), whose children
+     * all lie at or after `last`.
+     *
+     */
+    void BuildPassIterative(std::size_t first,
+                            std::size_t last);
+
+    /**
+     * Calls body(first, last) on consecutive chunks of [first, last)
+     * covering it, one thread per chunk, and waits for all of them.
+     * Chunks are at least kParallelGrain long.
      *
      */
-    void BuildTreeIterative(Base const &init_value);
+    template <typename Body>
+    static void ParallelFor(std::size_t first,
+                            std::size_t last,
+                            std::size_t threads,
+                            Body        body);
 
     /**
      * Queries for the bin_func_ value of all the nodes in the range
@@ -152,13 +694,26 @@ private:
      * l_index, r_index     : [l_index, r_index] 0-indexed denotes current
      *                        sub-tree range
      * tree_index           : index of the current node of tree_ vector
+     * nodes, count         : the nodes covering the range are appended
+     *                        to nodes[count...], from left to right
      *
      */
-    Base QueryRecursive(std::size_t l_qbound, 
+    void QueryRecursive(std::size_t l_qbound, 
                         std::size_t r_qbound, 
                         std::size_t l_index, 
                         std::size_t r_index, 
-                        std::size_t tree_index);
+                        std::size_t tree_index,
+                        std::size_t *nodes,
+                        std::size_t &count);
+
+    /**
+     * Sets result to the combination of the count nodes listed, from
+     * left to right, accumulating into its existing storage.
+     *
+     */
+    void FoldNodes(std::size_t const    *nodes,
+                   std::size_t          count,
+                   Base                 &result);
 
     /**
      * Queries for the bin_func_ value of all the nodes in the range
@@ -171,6 +726,38 @@ private:
     Base QueryIterative(std::size_t &l_qbound, 
                         std::size_t &r_qbound);
 
+    /**
+     * Accumulates into l_query, from left to right, the nodes of the
+     * iterative tree that cover the positions [l_ind, r_ind) of its
+     * bottom level (tree_ indices, OPEN right bound). While seeded is
+     * false, the first node is copied into l_query instead.
+     *
+     */
+    void QueryNodesIterative(std::size_t    l_ind,
+                             std::size_t    r_ind,
+                             Base           &l_query,
+                             bool           &seeded);
+
+    /**
+     * Queries for the bin_func_ value of the range [l_qbound, r_qbound]
+     * on the blocked tree: the leaves of partial blocks at either end,
+     * and the block tree over the whole blocks between them.
+     *
+     */
+    Base QueryBlocked(std::size_t l_qbound,
+                      std::size_t r_qbound);
+
+    /**
+     * Answers validated queries on the iterative tree, kBatchGroup at
+     * a time, advancing a group one level per pass.
+     *
+     * ranges   : Validated query ranges
+     * results  : Output, one slot per range
+     *
+     */
+    void QueryBatchIterative(std::vector<std::pair<std::size_t, std::size_t> > const &ranges,
+                             std::vector<Base>                                       &results);
+
     /**
      * Recursively updates leaf node with given value and applies
      * change along the tree.
@@ -182,12 +769,110 @@ private:
      * tree_index           : index of the current node of tree_ vector
      *
      */
-    void UpdateRecursive(Base const         &new_value,
+    template <typename Value>
+    void UpdateRecursive(Value              &&new_value,
                          std::size_t const  &final_index, 
                          std::size_t        l_index, 
                          std::size_t        r_index, 
                          std::size_t        tree_index);
 
+    /**
+     * FindFirst and FindLast on the recursive layout. The subtrees of
+     * tree_index that lie in the range are tried from the nearest to
+     * the farthest end, accumulating every one that leaves pred false.
+     *
+     * l_index, r_index : [l_index, r_index] 0-indexed denotes current
+     *                    sub-tree range
+     * tree_index       : index of the current node of tree_ vector
+     * acc, empty       : value of the ranges skipped so far, and whether
+     *                    there was none yet
+     *
+     * Return the index found, or len_.
+     *
+     */
+    template <typename Pred>
+    std::size_t FindFirstRecursive(std::size_t  l_bound,
+                                   Pred         &pred,
+                                   std::size_t  l_index,
+                                   std::size_t  r_index,
+                                   std::size_t  tree_index,
+                                   Base         &acc,
+                                   bool         &empty);
+
+    template <typename Pred>
+    std::size_t FindLastRecursive(std::size_t   r_bound,
+                                  Pred          &pred,
+                                  std::size_t   l_index,
+                                  std::size_t   r_index,
+                                  std::size_t   tree_index,
+                                  Base          &acc,
+                                  bool          &empty);
+
+    /**
+     * FindFirst and FindLast on the iterative layout. The nodes that
+     * make up the range, as in QueryIterative, are tried in order from
+     * the given end. The first one that makes pred true is descended
+     * to a leaf.
+     *
+     */
+    template <typename Pred>
+    std::size_t FindFirstIterative(std::size_t  l_bound,
+                                   Pred         &pred);
+
+    template <typename Pred>
+    std::size_t FindLastIterative(std::size_t   r_bound,
+                                  Pred          &pred);
+
+    /**
+     * The search of FindFirstIterative and FindLastIterative over the
+     * bottom level positions [l_ind, r_ind) of the iterative tree,
+     * starting from acc, the value of the ranges already skipped.
+     *
+     * Return the bottom level node where pred turns true, with acc
+     * holding the value before it, or 0 if it never does.
+     *
+     */
+    template <typename Pred>
+    std::size_t FindFirstNodes(std::size_t  l_ind,
+                               std::size_t  r_ind,
+                               Pred         &pred,
+                               Base         &acc);
+
+    template <typename Pred>
+    std::size_t FindLastNodes(std::size_t   l_ind,
+                              std::size_t   r_ind,
+                              Pred          &pred,
+                              Base          &acc);
+
+    /**
+     * FindFirst and FindLast on the blocked layout. The leaves of a
+     * partial block at the given end are tried one by one, then the
+     * block tree finds the block where pred turns true, whose leaves
+     * are tried one by one again.
+     *
+     */
+    template <typename Pred>
+    std::size_t FindFirstBlocked(std::size_t    l_bound,
+                                 Pred           &pred);
+
+    template <typename Pred>
+    std::size_t FindLastBlocked(std::size_t     r_bound,
+                                Pred            &pred);
+
+    /**
+     * FindFirst and FindLast on the wide layout. Climbing, a whole
+     * partial group of siblings is tried through its stored suffix
+     * (or prefix) aggregate. Descending, children are tried one by one.
+     *
+     */
+    template <typename Pred>
+    std::size_t FindFirstWide(std::size_t   l_bound,
+                              Pred          &pred);
+
+    template <typename Pred>
+    std::size_t FindLastWide(std::size_t    r_bound,
+                             Pred           &pred);
+
     /**
      * Iteratively updates leaf node with given value and applies
      * change along the tree.
@@ -196,14 +881,223 @@ private:
      * index            : index of the leaf (0-indexed) to update
      *
      */
-    void UpdateIterative(Base const         &new_value, 
+    template <typename Value>
+    void UpdateIterative(Value              &&new_value, 
                          std::size_t const  &index);
 
+    /**
+     * Validates the index and updates the leaf on the tree's layout,
+     * copying or moving new_value into it as given.
+     *
+     */
+    template <typename Value>
+    void UpdateValue(Value              &&new_value,
+                     std::size_t const  &index);
+
+    /**
+     * PushBack with the new value copied or moved into the leaf.
+     *
+     */
+    template <typename Value>
+    void PushBackValue(Value &&new_value);
+
+    /**
+     * Doubles the capacity of the iterative tree (see PushBack).
+     *
+     */
+    void Grow();
+
+    /**
+     * Sets out to the combination of a and b, or accumulates rhs into
+     * acc, with either form of the operation (see MonoidCombine).
+     *
+     */
+    void Combine(Base   &out,
+                 Base   &a,
+                 Base   &b);
+
+    void Accumulate(Base    &acc,
+                    Base    &rhs);
+
+    /**
+     * Accumulates rhs into acc, or copies it there while seeded is
+     * false, so that a query needs no identity.
+     *
+     */
+    void AccumulateSeeded(Base  &acc,
+                          bool  &seeded,
+                          Base  &rhs);
+
+    /**
+     * Returns the neutral element of the operation, `Op::Identity()`
+     * when the policy provides one, else `Base{}`.
+     *
+     */
+    static Base Identity();
+
+    /**
+     * Writes the leaves listed in `order` and recomputes their
+     * ancestors in recursive fashion, visiting each node once.
+     *
+     * indices, values  : As in UpdateBatch
+     * order            : Positions in indices, sorted by leaf index
+     * lo, hi           : [lo, hi) range of order inside current subtree
+     * l_index, r_index : [l_index, r_index] 0-indexed denotes current
+     *                    sub-tree range
+     * tree_index       : index of the current node of tree_ vector
+     *
+     */
+    void UpdateBatchRecursive(std::vector<std::size_t> const    &indices,
+                              std::vector<Base> const           &values,
+                              std::vector<std::size_t> const    &order,
+                              std::size_t                       lo,
+                              std::size_t                       hi,
+                              std::size_t                       l_index,
+                              std::size_t                       r_index,
+                              std::size_t                       tree_index);
+
+    /**
+     * Writes leaves [first_index, last_index] from `it`, in order, and
+     * recomputes their ancestors in recursive fashion.
+     *
+     * it               : Iterator to the next value, advanced per leaf
+     * l_index, r_index : [l_index, r_index] 0-indexed denotes current
+     *                    sub-tree range
+     * tree_index       : index of the current node of tree_ vector
+     *
+     */
+    template <typename ForwardIt>
+    void AssignRecursive(std::size_t    first_index,
+                         std::size_t    last_index,
+                         ForwardIt      &it,
+                         std::size_t    l_index,
+                         std::size_t    r_index,
+                         std::size_t    tree_index);
+
+    /**
+     * Recomputes, in the iterative tree, every internal node in `dirty`
+     * and then all of their ancestors, one level per round.
+     *
+     * dirty    : Sorted, distinct internal node indices. Used as
+     *            scratch space.
+     *
+     */
+    void RecomputeIterative(std::vector<std::size_t> &dirty);
+
+    /**
+     * Sizes the levels of the wide tree and fills tree_ with the
+     * identity, which pads every level to a multiple of kWideFanout.
+     *
+     */
+    void AllocateWide();
+
+    /**
+     * Fills offsets with the first index of each level of a wide tree
+     * of len leaves, and returns the nodes in one section of tree_.
+     *
+     */
+    static std::size_t WideLayout(std::size_t               len,
+                                  std::vector<std::size_t>  &offsets);
+
+    /**
+     * Builds the wide tree. The leaves (level 0) must already be
+     * stored, the levels above are computed from them.
+     *
+     */
+    void BuildTreeWide();
+
+    /**
+     * Refreshes the prefix and suffix aggregates of a group of
+     * kWideFanout siblings, and their parent on the level above.
+     *
+     * level                    : Level of the siblings, 0 for leaves
+     * group                    : Position of the parent on level + 1
+     * first_child, last_child  : Range of siblings (0 to kWideFanout-1)
+     *                            whose values changed
+     *
+     */
+    void RecomputeWide(std::size_t level,
+                       std::size_t group,
+                       std::size_t first_child,
+                       std::size_t last_child);
+
+    /**
+     * Combines the contiguous nodes tree_[first, last) from left to
+     * right. Also folds the leaves of a block of the blocked tree.
+     *
+     */
+    Base FoldWide(std::size_t first,
+                  std::size_t last);
+
+    /**
+     * Queries for the bin_func_ value of the range [l_qbound, r_qbound]
+     * on the wide tree. A partial group of siblings at either end of a
+     * level is read from one stored suffix or prefix aggregate.
+     *
+     */
+    Base QueryWide(std::size_t l_qbound,
+                   std::size_t r_qbound);
+
+    /**
+     * Updates a leaf of the wide tree and recomputes its ancestors.
+     *
+     */
+    template <typename Value>
+    void UpdateWide(Value               &&new_value,
+                    std::size_t const   &index);
+
+    /**
+     * Sizes the blocked tree for len_ leaves: capacity_ blocks, whose
+     * tree takes tree_[0, 2 * capacity_), then the leaves.
+     *
+     */
+    void AllocateBlocked();
+
+    /**
+     * Builds the blocked tree. The leaves must already be stored, the
+     * block aggregates and the tree over them are computed.
+     *
+     */
+    void BuildTreeBlocked(std::size_t threads);
+
+    /**
+     * Recomputes the aggregate of a block of the blocked tree from its
+     * leaves, but not the nodes above it.
+     *
+     */
+    void RecomputeBlock(std::size_t block);
+
+    /**
+     * Updates a leaf of the blocked tree, in O(kBlockSize + log(n /
+     * kBlockSize)): its block is folded again, then its ancestors.
+     *
+     */
+    template <typename Value>
+    void UpdateBlocked(Value                &&new_value,
+                       std::size_t const    &index);
+
     // Private Data Members
-    std::vector<Base>                   tree_;      ///< vector that stores tree values
-    std::function<Base(Base&, Base&)>   bin_func_;  ///< function that operates on tree
+    TreeStorage<Base, Alloc>            tree_;      ///< stores tree values, owned or mapped from a file
+    Op                                  bin_func_;  ///< function that operates on tree
     std::size_t                         len_;       ///< number of leaves in tree
-    bool                                type_;      ///< True for recursive, else iterative
+    std::size_t                         capacity_;  ///< iterative tree: leaves start at tree_[capacity_]; len_ unless grown by PushBack.
+                                                    ///< blocked tree: number of blocks, whose aggregates start there
+    int                                 type_;      ///< Layout of the tree, a TreeType
+
+    static std::size_t const            kWideFanout = 16;   ///< children per node of the wide tree
+    std::vector<std::size_t>            wide_offset_;       ///< wide tree: first tree_ index of each level
+    std::size_t                         wide_stride_;       ///< wide tree: size of each section of tree_
+
+    std::vector<VebStep>                veb_steps_;         ///< vEB tree: steps of depth d at [d * veb_step_count_, ...)
+    std::size_t                         veb_step_count_;    ///< vEB tree: steps per depth, padded to the most of any depth
+
+    static std::size_t const            kBatchGroup = 16;   ///< queries advanced in lockstep by QueryBatch
+    static std::size_t const            kMaxDepth = 64;     ///< bound on the levels a query climbs
+    static std::uint32_t const          kFileVersion = 2;   ///< version of the Save file format
+    static std::size_t const            kLoadChunk = 1 << 16;   ///< values read at once by LoadBinary
+    static std::size_t const            kSimdRun = 128;     ///< longest range folded straight from the leaves
+    static std::size_t const            kParallelGrain = 1 << 14;   ///< least nodes worth a thread in a parallel build
+    static std::size_t const            kBlockSize = 64;    ///< leaves per block of the blocked tree
 };
 
 #include "segtree.cpp"  //To include template members
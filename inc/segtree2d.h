@@ -0,0 +1,160 @@
+/**
+ * This class answers queries over rectangles of a grid of values, e.g.
+ * the total of a block of (time bucket, shard) cells, in O(log rows *
+ * log cols) rather than one query per row.
+ *
+ * It generalizes the iterative layout of SegmentTree to two dimensions.
+ * Every node of a tree over the rows holds a whole iterative tree over
+ * the columns, and all of them are kept in one contiguous vector, row
+ * node after row node. A rectangle is split into O(log rows) row nodes,
+ * and each of those answers the column range in O(log cols).
+ *
+ * The cells of a rectangle are not combined in a fixed order, so the
+ * operation must be commutative as well as associative. It needs no
+ * identity: a query starts from the first node it meets, so a lambda
+ * such as max works on any values, negative ones included.
+ *
+ */
+
+#ifndef _SEGMENTTREE2D_H_
+#define _SEGMENTTREE2D_H_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "monoids.h"
+
+template <typename Base, typename Op = std::function<Base(Base&, Base&)> >
+class SegmentTree2D
+{
+
+public:
+
+    /**
+     * Creates a SegmentTree2D from a grid given as rows of values.
+     * Throws std::invalid_argument if the grid is empty or its rows
+     * differ in length.
+     *
+     * init_values  : Rows of the grid, all of the same length
+     * bin_func     : Lambda (or Op policy instance) to combine values
+     *
+     */
+    SegmentTree2D(std::vector<std::vector<Base> > const   &init_values,
+                  Op                                      bin_func);
+
+    /**
+     * Creates a SegmentTree2D with every cell set to init_value.
+     * Throws std::invalid_argument if rows or cols is 0.
+     *
+     * init_value   : Value of every cell
+     * rows         : Number of rows of the grid
+     * cols         : Number of columns of the grid
+     * bin_func     : Lambda (or Op policy instance) to combine values
+     *
+     */
+    SegmentTree2D(Base const    &init_value,
+                  std::size_t   rows,
+                  std::size_t   cols,
+                  Op            bin_func);
+
+    /**
+     * Queries on the rectangle of cells from (x1, y1) to (x2, y2),
+     * both corners included. x is the row and y the column.
+     *
+     * Returns solution to query of Base template type.
+     *
+     */
+    Base Query(std::size_t x1,
+               std::size_t y1,
+               std::size_t x2,
+               std::size_t y2);
+
+    /**
+     * Updates the cell at row x and column y to new_value, in
+     * O(log rows * log cols).
+     *
+     */
+    void Update(std::size_t     x,
+                std::size_t     y,
+                Base const      &new_value);
+
+    void Update(std::size_t     x,
+                std::size_t     y,
+                Base            &&new_value);
+
+    /**
+     * Returns the number of rows of the grid.
+     *
+     */
+    std::size_t Rows() const;
+
+    /**
+     * Returns the number of columns of the grid.
+     *
+     */
+    std::size_t Cols() const;
+
+
+private:
+
+    /**
+     * Builds the column trees of the leaf rows, then every row node
+     * from its two children, column node by column node.
+     *
+     */
+    void Build();
+
+    /**
+     * Accumulates the column range [l_qbound, r_qbound) of the row
+     * node x into result. seeded is false until result holds a node.
+     *
+     */
+    void QueryRow(std::size_t   x,
+                  std::size_t   l_qbound,
+                  std::size_t   r_qbound,
+                  Base          &result,
+                  bool          &seeded);
+
+    /**
+     * Accumulates node into result, or copies it there if seeded is
+     * still false.
+     *
+     */
+    void AccumulateNode(Base    &node,
+                        Base    &result,
+                        bool    &seeded);
+
+    /**
+     * Update with the new value copied or moved into the cell, as
+     * given.
+     *
+     */
+    template <typename Value>
+    void UpdateValue(std::size_t    x,
+                     std::size_t    y,
+                     Value          &&new_value);
+
+    /**
+     * Returns the position in tree_ of column node y of row node x.
+     *
+     */
+    std::size_t Node(std::size_t x, std::size_t y) const;
+
+    /**
+     * Computes out = a op b, through the in-place form of Op if it has
+     * one.
+     *
+     */
+    void Combine(Base &out, Base &a, Base &b);
+
+    // Private Data Members
+    std::vector<Base>   tree_;      ///< 2 * rows_ row nodes of 2 * cols_ column nodes each
+    Op                  bin_func_;  ///< function that operates on tree
+    std::size_t         rows_;      ///< number of rows of the grid
+    std::size_t         cols_;      ///< number of columns of the grid
+};
+
+#include "segtree2d.cpp"  //To include template members
+
+#endif
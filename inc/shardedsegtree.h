@@ -0,0 +1,196 @@
+/**
+ * This class splits the leaves of a segment tree into contiguous
+ * shards, each one a SegmentTree with its own lock, so that updates
+ * from many threads to different shards run in parallel.
+ *
+ * Each shard also publishes its root, the value of the whole shard,
+ * in a ShardRoot that readers load without any lock. An update writes
+ * its shard, then the shard's new root, both under the shard lock
+ * alone, so writers to different shards share nothing. A query locks
+ * the partial shards at both ends of its range, one at a time, and
+ * combines the roots of the full shards in between, in O(shards).
+ *
+ * Each shard is read in one consistent state, but a query spanning
+ * several shards is not a snapshot across them. It may include an
+ * update running concurrently on one shard and miss one on another.
+ *
+ */
+
+#ifndef _SHARDEDSEGMENTTREE_H_
+#define _SHARDEDSEGMENTTREE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include <functional>
+
+#include "segtree.h"
+
+/**
+ * The root of one shard, stored by the writer holding the shard lock
+ * and loaded by any number of readers without a lock.
+ *
+ * A trivially copyable Base is kept in a seqlock: the value is copied
+ * word by word between two increments of a sequence number, and a
+ * reader retries while the number is odd or changed under it. Any
+ * other Base is kept in an immutable shared copy, swapped atomically.
+ *
+ */
+template <typename Base, bool Trivial = std::is_trivially_copyable<Base>::value>
+class ShardRoot
+{
+
+public:
+
+    ShardRoot();
+
+    /**
+     * Publishes value. Only one thread may store at a time.
+     *
+     */
+    void Store(Base const &value);
+
+    /**
+     * Returns the last value stored, never one half written.
+     *
+     */
+    Base Load() const;
+
+
+private:
+
+    static std::size_t const kWords = (sizeof(Base) + sizeof(unsigned long) - 1) / sizeof(unsigned long);
+
+    // Private Data Members
+    std::atomic<unsigned>       seq_;           ///< odd while a store runs
+    std::atomic<unsigned long>  words_[kWords]; ///< bytes of the value
+};
+
+template <typename Base>
+class ShardRoot<Base, false>
+{
+
+public:
+
+    void Store(Base const &value);
+
+    Base Load() const;
+
+
+private:
+
+    // Private Data Members
+    std::shared_ptr<Base const> value_;         ///< replaced whole by each store
+};
+
+template <typename Base, typename Op = std::function<Base(Base&, Base&)> >
+class ShardedSegmentTree
+{
+
+public:
+
+    /**
+     * Creates a ShardedSegmentTree from given vector
+     *
+     * init_values, bin_func, type  : As for SegmentTree, `type` being
+     *                                the layout of every shard
+     * shards                       : Number of shards, e.g. a few per
+     *                                writer thread. At most one per leaf.
+     *
+     */
+    ShardedSegmentTree(std::vector<Base> const  &init_values,
+                       Op                       bin_func,
+                       int                      type,
+                       std::size_t              shards);
+
+    /**
+     * Creates a ShardedSegmentTree from given leaf value and size
+     *
+     * init_value, len, bin_func, type, shards : As above
+     *
+     */
+    ShardedSegmentTree(Base const               &init_value,
+                       std::size_t const        &len,
+                       Op                       bin_func,
+                       int                      type,
+                       std::size_t              shards);
+
+    /**
+     * Queries on range [l_index, r_index]. Safe to call from any
+     * thread, alongside updates.
+     *
+     * l_index, r_index: Inclusive left and right ranges, zero-indexed.
+     *
+     * Returns solution to query of Base template type.
+     *
+     */
+    Base Query(std::size_t  l_index,
+               std::size_t  r_index);
+
+    /**
+     * Performs update on a leaf, locking its shard, then publishing
+     * the shard's new root.
+     *
+     * new_value    : New value of leaf
+     * index        : Index of the leaf (zero indexed)
+     *
+     */
+    void Update(Base const          &new_value,
+                std::size_t const   &index);
+
+    /**
+     * Performs update on a leaf, moving the new value into it.
+     *
+     */
+    void Update(Base                &&new_value,
+                std::size_t const   &index);
+
+
+private:
+
+    /**
+     * Update with the new value copied or moved into the leaf, as given.
+     *
+     */
+    template <typename Value>
+    void UpdateValue(Value              &&new_value,
+                     std::size_t const  &index);
+
+    /**
+     * Leaves per shard, for len leaves split into about `shards` shards.
+     *
+     */
+    static std::size_t ShardLength(std::size_t len,
+                                   std::size_t shards);
+
+    /**
+     * Number of leaves of a shard, the last one possibly being shorter.
+     *
+     */
+    std::size_t ShardSize(std::size_t shard) const;
+
+    /**
+     * Lock and published root of a shard, kept on their own cache line.
+     *
+     */
+    struct alignas(64) ShardState
+    {
+        std::mutex          lock;
+        ShardRoot<Base>     root;
+    };
+
+    // Private Data Members
+    Op                                  bin_func_;      ///< function that operates on tree
+    std::size_t                         len_;           ///< number of leaves in tree
+    std::size_t                         shard_len_;     ///< leaves per shard, but the last
+    std::size_t                         shard_count_;   ///< number of shards
+    std::vector<SegmentTree<Base, Op> > shards_;        ///< one tree per shard of leaves
+    std::vector<ShardState>             states_;        ///< lock and root per shard
+};
+
+#include "shardedsegtree.cpp"  //To include template members
+
+#endif
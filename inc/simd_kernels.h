@@ -0,0 +1,284 @@
+/**
+ * Vectorized kernels for the common arithmetic monoids of `monoids.h`.
+ *
+ * SimdKernel<Base, Op> is used by SegmentTree for two loops over its
+ * node storage `nodes`:
+ *
+ *  PairReduce  : nodes[out + i] = op(nodes[in + 2i], nodes[in + 2i + 1])
+ *                for i < count, which computes a level (or a stretch of
+ *                one) of the iterative tree from the level below
+ *  Reduce      : folds the run nodes[first, first + count) into one value
+ *
+ * Both report how much of the work they did, so the caller finishes
+ * (or does all of) it with the scalar operation. Kernels exist for
+ * `int`, `long long`, `float` and `double` with SumOp, MinOp, MaxOp, and
+ * for the integer types AndOp, OrOp and XorOp. They are compiled for
+ * AVX2 through function attributes and only used when the running CPU
+ * supports it, so the same binary runs on any x86-64 machine. Other
+ * compilers, architectures, types and operations (including any
+ * `std::function`) always take the scalar path.
+ *
+ * PairReduce gives the same bits as the scalar loop. Reduce reorders the
+ * operation, so it is only provided where that is exact: not for
+ * floating point sums.
+ *
+ */
+
+#ifndef _SIMD_KERNELS_H_
+#define _SIMD_KERNELS_H_
+
+#include <cstddef>
+
+#include "monoids.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SEGTREE_X86_SIMD 1
+#include <immintrin.h>
+#define SEGTREE_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+template <typename Base, typename Op>
+struct SimdKernel
+{
+    static bool const kPairReduce = false;
+    static bool const kReduce = false;
+
+    template <typename Nodes>
+    static std::size_t PairReduce(Nodes &, std::size_t, std::size_t, std::size_t) { return 0; }
+
+    template <typename Nodes>
+    static bool Reduce(Nodes const &, std::size_t, std::size_t, Base &) { return false; }
+};
+
+
+#ifdef SEGTREE_X86_SIMD
+
+namespace segtree_simd
+{
+
+/**
+ * Whether the running CPU supports AVX2, checked once.
+ *
+ */
+inline bool HasAvx2()
+{
+    static bool const has_avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+    return has_avx2;
+}
+
+
+// Lane types: loading, storing, and splitting two vectors into their
+// even and odd elements. Even and odd come out in the same permuted
+// order, which Restore undoes after a lane-wise operation.
+
+struct Lanes32i
+{
+    typedef __m256i Vec;
+    static std::size_t const kLanes = 8;
+
+    template <typename T>
+    SEGTREE_AVX2 static Vec Load(T const *p) { return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p)); }
+    template <typename T>
+    SEGTREE_AVX2 static void Store(T *p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+
+    SEGTREE_AVX2 static void Split(Vec a, Vec b, Vec &even, Vec &odd)
+    {
+        __m256 fa = _mm256_castsi256_ps(a), fb = _mm256_castsi256_ps(b);
+        even = _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+        odd = _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    SEGTREE_AVX2 static Vec Restore(Vec v) { return _mm256_permute4x64_epi64(v, 0xD8); }
+};
+
+struct Lanes64i
+{
+    typedef __m256i Vec;
+    static std::size_t const kLanes = 4;
+
+    template <typename T>
+    SEGTREE_AVX2 static Vec Load(T const *p) { return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p)); }
+    template <typename T>
+    SEGTREE_AVX2 static void Store(T *p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+
+    SEGTREE_AVX2 static void Split(Vec a, Vec b, Vec &even, Vec &odd)
+    {
+        __m256d da = _mm256_castsi256_pd(a), db = _mm256_castsi256_pd(b);
+        even = _mm256_castpd_si256(_mm256_shuffle_pd(da, db, 0x0));
+        odd = _mm256_castpd_si256(_mm256_shuffle_pd(da, db, 0xF));
+    }
+    SEGTREE_AVX2 static Vec Restore(Vec v) { return _mm256_permute4x64_epi64(v, 0xD8); }
+};
+
+struct Lanes32f
+{
+    typedef __m256 Vec;
+    static std::size_t const kLanes = 8;
+
+    SEGTREE_AVX2 static Vec Load(float const *p) { return _mm256_loadu_ps(p); }
+    SEGTREE_AVX2 static void Store(float *p, Vec v) { _mm256_storeu_ps(p, v); }
+
+    SEGTREE_AVX2 static void Split(Vec a, Vec b, Vec &even, Vec &odd)
+    {
+        even = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        odd = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+    SEGTREE_AVX2 static Vec Restore(Vec v)
+    {
+        return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v), 0xD8));
+    }
+};
+
+struct Lanes64f
+{
+    typedef __m256d Vec;
+    static std::size_t const kLanes = 4;
+
+    SEGTREE_AVX2 static Vec Load(double const *p) { return _mm256_loadu_pd(p); }
+    SEGTREE_AVX2 static void Store(double *p, Vec v) { _mm256_storeu_pd(p, v); }
+
+    SEGTREE_AVX2 static void Split(Vec a, Vec b, Vec &even, Vec &odd)
+    {
+        even = _mm256_shuffle_pd(a, b, 0x0);
+        odd = _mm256_shuffle_pd(a, b, 0xF);
+    }
+    SEGTREE_AVX2 static Vec Restore(Vec v) { return _mm256_permute4x64_pd(v, 0xD8); }
+};
+
+
+// Lane-wise operations, Apply(a, b) matching the scalar op(a, b)
+// of the policy bit for bit (including which operand wins a tie or
+// a NaN comparison for MinOp and MaxOp).
+
+struct AddI32 { SEGTREE_AVX2 static __m256i Apply(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); } };
+struct MinI32 { SEGTREE_AVX2 static __m256i Apply(__m256i a, __m256i b) { return _mm256_min_epi32(a, b); } };
+struct MaxI32 { SEGTREE_AVX2 static __m256i Apply(__m256i a, __m256i b) { return _mm256_max_epi32(a, b); } };
+struct AddI64 { SEGTREE_AVX2 static __m256i Apply(__m256i a, __m256i b) { return _mm256_add_epi64(a, b); } };
+struct MinI64
+{
+    SEGTREE_AVX2 static __m256i Apply(__m256i a, __m256i b)
+    {
+        return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+    }
+};
+struct MaxI64
+{
+    SEGTREE_AVX2 static __m256i Apply(__m256i a, __m256i b)
+    {
+        return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(b, a));
+    }
+};
+struct AndI { SEGTREE_AVX2 static __m256i Apply(__m256i a, __m256i b) { return _mm256_and_si256(a, b); } };
+struct OrI  { SEGTREE_AVX2 static __m256i Apply(__m256i a, __m256i b) { return _mm256_or_si256(a, b); } };
+struct XorI { SEGTREE_AVX2 static __m256i Apply(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); } };
+struct AddF32 { SEGTREE_AVX2 static __m256 Apply(__m256 a, __m256 b) { return _mm256_add_ps(a, b); } };
+struct MinF32 { SEGTREE_AVX2 static __m256 Apply(__m256 a, __m256 b) { return _mm256_min_ps(b, a); } };
+struct MaxF32 { SEGTREE_AVX2 static __m256 Apply(__m256 a, __m256 b) { return _mm256_max_ps(b, a); } };
+struct AddF64 { SEGTREE_AVX2 static __m256d Apply(__m256d a, __m256d b) { return _mm256_add_pd(a, b); } };
+struct MinF64 { SEGTREE_AVX2 static __m256d Apply(__m256d a, __m256d b) { return _mm256_min_pd(b, a); } };
+struct MaxF64 { SEGTREE_AVX2 static __m256d Apply(__m256d a, __m256d b) { return _mm256_max_pd(b, a); } };
+
+
+template <typename Base, typename Op, typename Lanes, typename LaneOp, bool Exact>
+struct Avx2Kernel
+{
+    static bool const kPairReduce = true;
+    static bool const kReduce = Exact;
+
+    SEGTREE_AVX2 static std::size_t PairReduceAvx2(Base *out, Base const *in, std::size_t count)
+    {
+        std::size_t i = 0;
+
+        for (; i + Lanes::kLanes <= count; i += Lanes::kLanes)
+        {
+            typename Lanes::Vec even, odd;
+            Lanes::Split(Lanes::Load(in + 2 * i), Lanes::Load(in + 2 * i + Lanes::kLanes), even, odd);
+            Lanes::Store(out + i, Lanes::Restore(LaneOp::Apply(even, odd)));
+        }
+
+        return i;
+    }
+
+    SEGTREE_AVX2 static Base ReduceAvx2(Base const *in, std::size_t count)
+    {
+        // Lane j accumulates elements j, j + kLanes, ..., which needs a
+        // commutative operation, then the lanes are folded.
+        typename Lanes::Vec acc = Lanes::Load(in);
+
+        std::size_t i = Lanes::kLanes;
+        for (; i + Lanes::kLanes <= count; i += Lanes::kLanes)
+            acc = LaneOp::Apply(acc, Lanes::Load(in + i));
+
+        Base lanes[Lanes::kLanes];
+        Lanes::Store(lanes, acc);
+
+        Op op;
+        Base result = lanes[0];
+        for (std::size_t j = 1; j < Lanes::kLanes; j++)
+            result = op(result, lanes[j]);
+        for (; i < count; i++)
+            result = op(result, in[i]);
+
+        return result;
+    }
+
+    template <typename Nodes>
+    static std::size_t PairReduce(Nodes &nodes, std::size_t out, std::size_t in, std::size_t count)
+    {
+        if (count < Lanes::kLanes || !HasAvx2())
+            return 0;
+
+        return PairReduceAvx2(&nodes[out], &nodes[in], count);
+    }
+
+    template <typename Nodes>
+    static bool Reduce(Nodes const &nodes, std::size_t first, std::size_t count, Base &result)
+    {
+        if (!Exact || count < Lanes::kLanes || !HasAvx2())
+            return false;
+
+        result = ReduceAvx2(&nodes[first], count);
+        return true;
+    }
+};
+
+}   // namespace segtree_simd
+
+
+#define SEGTREE_SIMD_KERNEL(BASE, OP, LANES, LANE_OP, EXACT)                                \
+    template <>                                                                             \
+    struct SimdKernel<BASE, OP<BASE> >                                                      \
+        : segtree_simd::Avx2Kernel<BASE, OP<BASE>, segtree_simd::LANES,                     \
+                                   segtree_simd::LANE_OP, EXACT>                            \
+    {                                                                                       \
+    };
+
+SEGTREE_SIMD_KERNEL(int, SumOp, Lanes32i, AddI32, true)
+SEGTREE_SIMD_KERNEL(int, MinOp, Lanes32i, MinI32, true)
+SEGTREE_SIMD_KERNEL(int, MaxOp, Lanes32i, MaxI32, true)
+SEGTREE_SIMD_KERNEL(int, AndOp, Lanes32i, AndI, true)
+SEGTREE_SIMD_KERNEL(int, OrOp, Lanes32i, OrI, true)
+SEGTREE_SIMD_KERNEL(int, XorOp, Lanes32i, XorI, true)
+
+SEGTREE_SIMD_KERNEL(long long, SumOp, Lanes64i, AddI64, true)
+SEGTREE_SIMD_KERNEL(long long, MinOp, Lanes64i, MinI64, true)
+SEGTREE_SIMD_KERNEL(long long, MaxOp, Lanes64i, MaxI64, true)
+SEGTREE_SIMD_KERNEL(long long, AndOp, Lanes64i, AndI, true)
+SEGTREE_SIMD_KERNEL(long long, OrOp, Lanes64i, OrI, true)
+SEGTREE_SIMD_KERNEL(long long, XorOp, Lanes64i, XorI, true)
+
+// Floating point sums are not associative, so their runs are not
+// reduced out of order.
+SEGTREE_SIMD_KERNEL(float, SumOp, Lanes32f, AddF32, false)
+SEGTREE_SIMD_KERNEL(float, MinOp, Lanes32f, MinF32, true)
+SEGTREE_SIMD_KERNEL(float, MaxOp, Lanes32f, MaxF32, true)
+
+SEGTREE_SIMD_KERNEL(double, SumOp, Lanes64f, AddF64, false)
+SEGTREE_SIMD_KERNEL(double, MinOp, Lanes64f, MinF64, true)
+SEGTREE_SIMD_KERNEL(double, MaxOp, Lanes64f, MaxF64, true)
+
+#undef SEGTREE_SIMD_KERNEL
+
+#endif  // SEGTREE_X86_SIMD
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * This class keeps the aggregate of the last `capacity` values pushed
+ * into it, e.g. the maximum latency or the total bytes of the last N
+ * samples.
+ *
+ * The values are stored in a ring buffer of leaves of an iterative
+ * SegmentTree. A push overwrites the oldest leaf, which is a single
+ * update of the tree, and never allocates. A window of the last k
+ * values is one range of leaves, or two when it wraps around the end
+ * of the buffer. Those are then combined older first, so the operation
+ * does not need to be commutative.
+ *
+ */
+
+#ifndef _SLIDINGWINDOWTREE_H_
+#define _SLIDINGWINDOWTREE_H_
+
+#include <cstddef>
+#include <functional>
+
+#include "segtree.h"
+
+template <typename Base, typename Op = std::function<Base(Base&, Base&)> >
+class SlidingWindowTree
+{
+
+public:
+
+    /**
+     * Creates an empty SlidingWindowTree. Throws std::invalid_argument
+     * if capacity is 0.
+     *
+     * capacity : Number of most recent values kept
+     * bin_func : Lambda (or Op policy instance) to combine values
+     *
+     */
+    SlidingWindowTree(std::size_t   capacity,
+                      Op            bin_func);
+
+    /**
+     * Appends a value, evicting the oldest one once `capacity` values
+     * are held. Costs one O(log capacity) update.
+     *
+     * new_value    : Value to append, copied or moved in
+     *
+     */
+    void Push(Base const &new_value);
+
+    void Push(Base &&new_value);
+
+    /**
+     * Queries on the last `last_k` values pushed, from the oldest to
+     * the newest. Throws std::out_of_range if last_k is 0 or more than
+     * Size().
+     *
+     * Returns solution to query of Base template type.
+     *
+     */
+    Base WindowQuery(std::size_t last_k);
+
+    /**
+     * Returns the number of values held, at most the capacity.
+     *
+     */
+    std::size_t Size() const;
+
+    /**
+     * Returns the number of most recent values kept.
+     *
+     */
+    std::size_t Capacity() const;
+
+
+private:
+
+    /**
+     * Push with the new value copied or moved into the leaf, as given.
+     *
+     */
+    template <typename Value>
+    void PushValue(Value &&new_value);
+
+    // Private Data Members
+    SegmentTree<Base, Op>               tree_;      ///< ring buffer of the values, as leaves
+    Op                                  bin_func_;  ///< function that operates on tree
+    std::size_t                         capacity_;  ///< number of leaves
+    std::size_t                         head_;      ///< leaf the next value is written to
+    std::size_t                         size_;      ///< values held, at most capacity_
+};
+
+#include "slidingwindowtree.cpp"  //To include template members
+
+#endif
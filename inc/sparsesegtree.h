@@ -0,0 +1,114 @@
+/**
+ * This class provides a segment tree over the keys [0, max_key], up to
+ * the whole 64-bit range, without storing a leaf per key.
+ *
+ * Nodes are created from a pool when an update first reaches them.
+ * A missing subtree holds the identity of the operation, so a query
+ * returns at once over regions without updates, and memory is
+ * O(updates * log(max_key)) instead of O(max_key).
+ *
+ * The identity is `Op::Identity()` for policies that provide one,
+ * else `Base{}`, unless it is given to the constructor.
+ *
+ */
+
+#ifndef _SPARSESEGMENTTREE_H_
+#define _SPARSESEGMENTTREE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+#include "monoids.h"
+
+template <typename Base, typename Op = std::function<Base(Base&, Base&)> >
+class SparseSegmentTree
+{
+
+public:
+
+    /**
+     * Creates an empty SparseSegmentTree, every key holding the identity
+     *
+     * max_key      : Largest key of the tree, keys being [0, max_key]
+     * bin_func     : Lambda (or Op policy instance) that represents a
+     *                binary closed operation of Base type
+     *
+     */
+    SparseSegmentTree(std::uint64_t const   &max_key,
+                      Op                    bin_func);
+
+    /**
+     * Creates an empty SparseSegmentTree with an explicit identity
+     *
+     * max_key, bin_func    : As above
+     * identity             : Neutral element of bin_func, the value of
+     *                        every key that was never updated
+     *
+     */
+    SparseSegmentTree(std::uint64_t const   &max_key,
+                      Op                    bin_func,
+                      Base const            &identity);
+
+    /**
+     * Queries on range of keys [l_key, r_key]
+     *
+     * l_key, r_key : Inclusive left and right keys
+     *
+     * Returns solution to query of Base template type.
+     *
+     */
+    Base Query(std::uint64_t    l_key,
+               std::uint64_t    r_key);
+
+    /**
+     * Sets the value of a key, creating the nodes on its path
+     *
+     * new_value    : New value of the key
+     * key          : Key to update
+     *
+     */
+    void Update(Base const          &new_value,
+                std::uint64_t const &key);
+
+    /**
+     * Returns the number of nodes allocated from the pool.
+     *
+     */
+    std::size_t NodeCount() const;
+
+
+private:
+
+    struct Node
+    {
+        Base        value;      ///< value of the subtree
+        std::size_t left;       ///< pool index of the left child, kNone if missing
+        std::size_t right;      ///< pool index of the right child, kNone if missing
+    };
+
+    /**
+     * Appends a node holding the identity to the pool, returning its index.
+     *
+     */
+    std::size_t NewNode();
+
+    Base QueryRecursive(std::uint64_t   l_qbound,
+                        std::uint64_t   r_qbound,
+                        std::uint64_t   l_key,
+                        std::uint64_t   r_key,
+                        std::size_t     node);
+
+    // Private Data Members
+    std::vector<Node>           nodes_;         ///< node pool, the root first
+    Op                          bin_func_;      ///< function that operates on tree
+    Base                        identity_;      ///< value of missing subtrees
+    std::uint64_t               max_key_;       ///< largest key
+
+    static std::size_t const    kNone = static_cast<std::size_t>(-1);   ///< no child
+};
+
+#include "sparsesegtree.cpp"  //To include template members
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * This class answers range queries on values that never change, for
+ * idempotent operations such as min, max or gcd, in O(1).
+ *
+ * Level k of the table holds the aggregate of every run of 2^k leaves,
+ * so it takes O(n log n) values, all kept in one vector, level after
+ * level. A range is covered by the two runs of the largest length that
+ * fits, one from each end. They may overlap, which is harmless because
+ * the operation is idempotent (a op a == a), so a query is two lookups
+ * and one combine.
+ *
+ * The table cannot be updated: Update throws std::logic_error, as it
+ * does for a SegmentTree opened read-only.
+ *
+ */
+
+#ifndef _SPARSETABLE_H_
+#define _SPARSETABLE_H_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "segtree.h"
+
+template <typename Base, typename Op = std::function<Base(Base&, Base&)> >
+class SparseTable
+{
+
+public:
+
+    /**
+     * Creates a SparseTable from a vector of values, in O(n log n).
+     * Throws std::invalid_argument if there are no values.
+     *
+     * init_values  : Values of the leaves, copied or moved in
+     * bin_func     : Lambda (or Op policy instance) to combine values,
+     *                which must be idempotent
+     *
+     */
+    SparseTable(std::vector<Base> const     &init_values,
+                Op                          bin_func);
+
+    SparseTable(std::vector<Base>           &&init_values,
+                Op                          bin_func);
+
+    /**
+     * Creates a SparseTable with every leaf set to init_value.
+     *
+     * init_value   : Value of every leaf
+     * len          : Number of leaves
+     * bin_func     : As above
+     *
+     */
+    SparseTable(Base const          &init_value,
+                std::size_t const   &len,
+                Op                  bin_func);
+
+    /**
+     * Creates a SparseTable from the values in [first, last).
+     *
+     */
+    template <typename InputIt, typename = typename std::enable_if<IsIterator<InputIt>::value>::type>
+    SparseTable(InputIt     first,
+                InputIt     last,
+                Op          bin_func);
+
+    /**
+     * Queries on the range of leaves from l_index to r_index, both
+     * included, in O(1).
+     *
+     * Returns solution to query of Base template type.
+     *
+     */
+    Base Query(std::size_t  l_index,
+               std::size_t  r_index);
+
+    /**
+     * Always throws std::logic_error, since the table is read-only.
+     * Build a SegmentTree for values that change.
+     *
+     */
+    void Update(Base const          &new_value,
+                std::size_t const   &index);
+
+    /**
+     * Returns the number of leaves.
+     *
+     */
+    std::size_t Size() const;
+
+
+private:
+
+    /**
+     * Fills the levels above the leaves, which are the first len_
+     * values of table_.
+     *
+     */
+    void Build();
+
+    /**
+     * Returns the largest k with 2^k <= x, for x > 0.
+     *
+     */
+    static std::size_t FloorLog2(std::size_t x);
+
+    // Private Data Members
+    std::vector<Base>           table_;     ///< every level, from the leaves up
+    std::vector<std::size_t>    levels_;    ///< position of each level in table_
+    Op                          bin_func_;  ///< function that operates on table
+    std::size_t                 len_;       ///< number of leaves
+};
+
+#include "sparsetable.cpp"  //To include template members
+
+#endif
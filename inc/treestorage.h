@@ -0,0 +1,99 @@
+/**
+ * Storage of the nodes of a SegmentTree: either an owned vector, or a
+ * view of nodes stored in a file mapped into memory with `mmap`.
+ *
+ * A mapping is private to the process. It is either read-only, or
+ * copy-on-write, in which case writes change the process's pages and
+ * never the file. Copying a storage always gives an owned copy, and
+ * resizing one turns it into owned storage.
+ *
+ * Owned nodes come from Alloc. Mapped ones come from the file, so the
+ * allocator is not used for them.
+ *
+ */
+
+#ifndef _TREESTORAGE_H_
+#define _TREESTORAGE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+template <typename Base, typename Alloc = std::allocator<Base> >
+class TreeStorage
+{
+
+public:
+
+    explicit TreeStorage(Alloc const &alloc = Alloc());
+    TreeStorage(TreeStorage const &other);
+    TreeStorage(TreeStorage &&other);
+    TreeStorage &operator=(TreeStorage other);
+    ~TreeStorage();
+
+    Base &operator[](std::size_t i) { return data_[i]; }
+    Base const &operator[](std::size_t i) const { return data_[i]; }
+
+    std::size_t size() const { return size_; }
+
+    /**
+     * Resizes to n nodes, owned, keeping the first ones, like
+     * std::vector::resize.
+     *
+     */
+    void resize(std::size_t n);
+
+    /**
+     * Replaces the contents with n owned copies of value, like
+     * std::vector::assign.
+     *
+     */
+    void assign(std::size_t n, Base const &value);
+
+    /**
+     * Replaces the contents with a view of `count` nodes stored in the
+     * file at `path`, starting `offset` bytes in. Throws
+     * std::runtime_error if the file cannot be mapped or is too short.
+     *
+     * writable : True for a copy-on-write mapping, else read-only
+     *
+     */
+    void Map(std::string const  &path,
+             std::size_t        offset,
+             std::size_t        count,
+             bool               writable);
+
+    /**
+     * False for a read-only mapping, true otherwise.
+     *
+     */
+    bool Writable() const { return writable_; }
+
+    Alloc get_allocator() const { return owned_.get_allocator(); }
+
+    Base const *data() const { return data_; }
+
+    void swap(TreeStorage &other);
+
+
+private:
+
+    /**
+     * Drops the mapping, if any, and falls back to the owned vector.
+     *
+     */
+    void Unmap();
+
+    // Private Data Members
+    std::vector<Base, Alloc>    owned_;         ///< nodes, unless mapped
+    Base                        *data_;         ///< first node, owned or mapped
+    std::size_t                 size_;          ///< number of nodes
+    void                        *mapping_;      ///< start of the mapping, or NULL
+    std::size_t                 mapping_len_;   ///< length of the mapping in bytes
+    bool                        writable_;      ///< whether nodes may be written
+};
+
+#include "treestorage.cpp"  //To include template members
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef _CONCURRENTSEGMENTTREE_CPP_
+#define _CONCURRENTSEGMENTTREE_CPP_
+
+#include <thread>
+
+#include "concurrentsegtree.h"
+
+
+template <typename Base, typename Op>
+std::size_t const ConcurrentSegmentTree<Base, Op>::ReadIndicator::kStripes;
+
+
+template <typename Base, typename Op>
+ConcurrentSegmentTree<Base, Op>::ConcurrentSegmentTree(
+            std::vector<Base> const   &init_values,
+            Op                        bin_func,
+            int                       type
+)
+    : trees_{SegmentTree<Base, Op>(init_values, bin_func, type),
+             SegmentTree<Base, Op>(init_values, bin_func, type)}
+    , left_right_(0)
+    , version_index_(0)
+{
+}
+
+
+template <typename Base, typename Op>
+ConcurrentSegmentTree<Base, Op>::ConcurrentSegmentTree(
+            Base const                &init_value,
+            std::size_t const         &len,
+            Op                        bin_func,
+            int                       type
+)
+    : trees_{SegmentTree<Base, Op>(init_value, len, bin_func, type),
+             SegmentTree<Base, Op>(init_value, len, bin_func, type)}
+    , left_right_(0)
+    , version_index_(0)
+{
+}
+
+
+template <typename Base, typename Op>
+Base ConcurrentSegmentTree<Base, Op>::Query(
+            std::size_t  l_index,
+            std::size_t  r_index
+)
+{
+    // Announcing on the current version before reading left_right_
+    // guarantees that the writer waits for this reader before it
+    // touches the tree the reader was sent to.
+    ReadIndicator &indicator = indicators_[version_index_.load()];
+    indicator.Arrive();
+
+    try
+    {
+        Base result = trees_[left_right_.load()].Query(l_index, r_index);
+        indicator.Depart();
+        return result;
+    }
+    catch (...)
+    {
+        indicator.Depart();
+        throw;
+    }
+}
+
+
+template <typename Base, typename Op>
+void ConcurrentSegmentTree<Base, Op>::Update(
+            Base const          &new_value,
+            std::size_t const   &index
+)
+{
+    UpdateValue(new_value, index);
+}
+
+
+template <typename Base, typename Op>
+void ConcurrentSegmentTree<Base, Op>::Update(
+            Base                &&new_value,
+            std::size_t const   &index
+)
+{
+    UpdateValue(std::move(new_value), index);
+}
+
+
+template <typename Base, typename Op>
+template <typename Value>
+void ConcurrentSegmentTree<Base, Op>::UpdateValue(
+            Value               &&new_value,
+            std::size_t const   &index
+)
+{
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+
+    int read_tree = left_right_.load();
+
+    // No reader is on the other tree, so it is updated first
+    // (an invalid index throws here, before anything changed),
+    // and new readers are sent to it.
+    trees_[1 - read_tree].Update(new_value, index);
+    left_right_.store(1 - read_tree);
+
+    // Readers that arrived before the switch may still be on the old
+    // tree. New readers are moved to the other indicator, and both are
+    // drained in turn, so that a reader that keeps arriving on one
+    // cannot hold up the writer forever.
+    int version = version_index_.load();
+    WaitForReaders(indicators_[1 - version]);
+    version_index_.store(1 - version);
+    WaitForReaders(indicators_[version]);
+
+    // The value is no longer needed, so it can be moved this time
+    trees_[read_tree].Update(std::forward<Value>(new_value), index);
+}
+
+
+template <typename Base, typename Op>
+void ConcurrentSegmentTree<Base, Op>::WaitForReaders(
+            ReadIndicator const &indicator
+)
+{
+    while (!indicator.IsEmpty())
+        std::this_thread::yield();
+}
+
+
+template <typename Base, typename Op>
+ConcurrentSegmentTree<Base, Op>::ReadIndicator::ReadIndicator()
+{
+    for (std::size_t i = 0; i < kStripes; i++)
+        counters_[i].count.store(0);
+}
+
+
+template <typename Base, typename Op>
+void ConcurrentSegmentTree<Base, Op>::ReadIndicator::Arrive()
+{
+    counters_[Stripe()].count.fetch_add(1);
+}
+
+
+template <typename Base, typename Op>
+void ConcurrentSegmentTree<Base, Op>::ReadIndicator::Depart()
+{
+    counters_[Stripe()].count.fetch_sub(1);
+}
+
+
+template <typename Base, typename Op>
+bool ConcurrentSegmentTree<Base, Op>::ReadIndicator::IsEmpty() const
+{
+    for (std::size_t i = 0; i < kStripes; i++)
+    {
+        if (counters_[i].count.load() != 0)
+            return false;
+    }
+    return true;
+}
+
+
+template <typename Base, typename Op>
+std::size_t ConcurrentSegmentTree<Base, Op>::ReadIndicator::Stripe()
+{
+    static thread_local std::size_t const stripe =
+        std::hash<std::thread::id>()(std::this_thread::get_id()) % kStripes;
+    return stripe;
+}
+
+#endif
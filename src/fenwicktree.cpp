@@ -0,0 +1,131 @@
+#ifndef _FENWICKTREE_CPP_
+#define _FENWICKTREE_CPP_
+
+#include <stdexcept>
+
+#include "fenwicktree.h"
+
+
+template <typename Base, typename Op, typename InvOp>
+FenwickTree<Base, Op, InvOp>::FenwickTree(
+            std::vector<Base> const     &init_values,
+            Op                          bin_func,
+            InvOp                       inv_func
+)
+    : tree_(init_values)
+    , bin_func_(bin_func)
+    , inv_func_(inv_func)
+    , len_(init_values.size())
+{
+    if (len_ == 0)
+    {
+        throw std::invalid_argument("A Fenwick tree needs at least one leaf.");
+    }
+
+    // Every slot, once complete, is added to the next slot that
+    // covers it.
+    for (std::size_t i = 1; i <= len_; i++)
+    {
+        std::size_t parent = i + (i & (0 - i));
+        if (parent <= len_)
+            MonoidCombine<Base, Op>::Accumulate(bin_func_, tree_[parent - 1], tree_[i - 1]);
+    }
+}
+
+
+template <typename Base, typename Op, typename InvOp>
+FenwickTree<Base, Op, InvOp>::FenwickTree(
+            Base const          &init_value,
+            std::size_t const   &len,
+            Op                  bin_func,
+            InvOp               inv_func
+)
+    : FenwickTree(std::vector<Base>(len, init_value), bin_func, inv_func)
+{
+}
+
+
+template <typename Base, typename Op, typename InvOp>
+Base FenwickTree<Base, Op, InvOp>::Query(
+            std::size_t  l_index,
+            std::size_t  r_index
+)
+{
+    if (r_index >= len_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+    if (l_index > r_index)
+    {
+        throw std::out_of_range("The left index must be smaller than the right index.");
+    }
+
+    return Range(l_index, r_index + 1);
+}
+
+
+template <typename Base, typename Op, typename InvOp>
+void FenwickTree<Base, Op, InvOp>::Update(
+            Base const          &new_value,
+            std::size_t const   &index
+)
+{
+    if (index >= len_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+
+    // The old value of the leaf is not kept, which would double the
+    // memory, but read back from the few slots below it.
+    Base old_value = Range(index, index + 1);
+    Base new_copy = new_value;
+    Base delta = inv_func_(new_copy, old_value);
+
+    for (std::size_t i = index + 1; i <= len_; i += i & (0 - i))
+        MonoidCombine<Base, Op>::Accumulate(bin_func_, tree_[i - 1], delta);
+}
+
+
+template <typename Base, typename Op, typename InvOp>
+std::size_t FenwickTree<Base, Op, InvOp>::Size() const
+{
+    return len_;
+}
+
+
+template <typename Base, typename Op, typename InvOp>
+Base FenwickTree<Base, Op, InvOp>::Range(
+            std::size_t l_bound,
+            std::size_t r_bound
+)
+{
+    Base result = MonoidIdentity<Base, Op>::Get();
+
+    if (l_bound == 0)
+    {
+        for (std::size_t i = r_bound; i > 0; i &= i - 1)
+            MonoidCombine<Base, Op>::Accumulate(bin_func_, result, tree_[i - 1]);
+        return result;
+    }
+
+    // Both prefixes step down to the same slots once their indices
+    // meet, so only the slots before that are folded.
+    Base removed = MonoidIdentity<Base, Op>::Get();
+    while (r_bound != l_bound)
+    {
+        if (r_bound > l_bound)
+        {
+            MonoidCombine<Base, Op>::Accumulate(bin_func_, result, tree_[r_bound - 1]);
+            r_bound &= r_bound - 1;
+        }
+        else
+        {
+            MonoidCombine<Base, Op>::Accumulate(bin_func_, removed, tree_[l_bound - 1]);
+            l_bound &= l_bound - 1;
+        }
+    }
+
+    return inv_func_(result, removed);
+}
+
+#endif
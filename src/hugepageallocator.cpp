@@ -0,0 +1,183 @@
+#ifndef _HUGEPAGEALLOCATOR_CPP_
+#define _HUGEPAGEALLOCATOR_CPP_
+
+#include <cstdint>
+#include <limits>
+#include <new>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "hugepageallocator.h"
+
+
+template <typename T>
+std::size_t const HugePageAllocator<T>::kHugePageSize;
+
+
+template <typename T>
+HugePageAllocator<T>::HugePageAllocator(
+            int             huge_pages,
+            int             numa_policy,
+            unsigned long   numa_nodes
+)
+    : huge_pages_(huge_pages)
+    , numa_policy_(numa_policy)
+    , numa_nodes_(numa_nodes)
+{
+}
+
+
+template <typename T>
+template <typename U>
+HugePageAllocator<T>::HugePageAllocator(
+            HugePageAllocator<U> const &other
+)
+    : huge_pages_(other.huge_pages_)
+    , numa_policy_(other.numa_policy_)
+    , numa_nodes_(other.numa_nodes_)
+{
+}
+
+
+template <typename T>
+T *HugePageAllocator<T>::allocate(
+            std::size_t n
+)
+{
+    if (n > (std::numeric_limits<std::size_t>::max() - 2 * kHugePageSize) / sizeof(T))
+    {
+        throw std::bad_alloc();
+    }
+
+    // Below a huge page, a mapping would only waste memory
+    if (n * sizeof(T) < kHugePageSize)
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+
+    std::size_t length = MappedLength(n);
+    void *p = NULL;
+
+#ifdef MAP_HUGETLB
+    if (huge_pages_ == HUGE_PAGES_EXPLICIT)
+    {
+        p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED)
+            p = NULL;
+    }
+#endif
+
+    if (p == NULL)
+    {
+        // No hugetlb pages asked for or left: normal pages, which the
+        // kernel may still merge once they are aligned and advised.
+        p = MapAligned(length);
+        if (p == NULL)
+        {
+            throw std::bad_alloc();
+        }
+
+#ifdef MADV_HUGEPAGE
+        if (huge_pages_ != HUGE_PAGES_NONE)
+            madvise(p, length, MADV_HUGEPAGE);
+#endif
+    }
+
+    // Before the pages are first touched, which is when they are placed
+    BindNuma(p, length);
+
+    return static_cast<T *>(p);
+}
+
+
+template <typename T>
+void HugePageAllocator<T>::deallocate(
+            T           *p,
+            std::size_t n
+)
+{
+    if (n * sizeof(T) < kHugePageSize)
+        ::operator delete(p);
+    else
+        munmap(p, MappedLength(n));
+}
+
+
+template <typename T>
+inline std::size_t HugePageAllocator<T>::MappedLength(
+            std::size_t n
+)
+{
+    return (n * sizeof(T) + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+}
+
+
+template <typename T>
+void *HugePageAllocator<T>::MapAligned(
+            std::size_t length
+)
+{
+    // mmap only aligns to the normal page size, so one huge page more
+    // is mapped and the ends around the aligned block are unmapped.
+    std::size_t padded = length + kHugePageSize;
+    void *p = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+
+    std::uintptr_t start = reinterpret_cast<std::uintptr_t>(p);
+    std::uintptr_t aligned = (start + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+
+    if (aligned != start)
+        munmap(p, aligned - start);
+    if (aligned + length != start + padded)
+        munmap(reinterpret_cast<void *>(aligned + length), start + padded - aligned - length);
+
+    return reinterpret_cast<void *>(aligned);
+}
+
+
+template <typename T>
+void HugePageAllocator<T>::BindNuma(
+            void        *p,
+            std::size_t length
+) const
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    if (numa_policy_ == NUMA_DEFAULT || numa_nodes_ == 0)
+        return;
+
+    // The MPOL_* values of <numaif.h>, which is not always installed.
+    // The kernel reads one bit less than maxnode, hence the + 1.
+    int const mpol_bind = 2, mpol_interleave = 3;
+    int mode = numa_policy_ == NUMA_BIND ? mpol_bind : mpol_interleave;
+    unsigned long maxnode = 8 * sizeof(numa_nodes_) + 1;
+
+    syscall(SYS_mbind, p, length, mode, &numa_nodes_, maxnode, 0);
+#else
+    (void)p;
+    (void)length;
+#endif
+}
+
+
+template <typename T, typename U>
+bool operator==(
+            HugePageAllocator<T> const &,
+            HugePageAllocator<U> const &
+)
+{
+    return true;
+}
+
+
+template <typename T, typename U>
+bool operator!=(
+            HugePageAllocator<T> const &,
+            HugePageAllocator<U> const &
+)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,517 @@
+#ifndef _LAZYSEGMENTTREE_CPP_
+#define _LAZYSEGMENTTREE_CPP_
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "lazysegtree.h"
+#include "segtree.h"
+
+
+template <typename Base, typename Tag>
+LazySegmentTree<Base, Tag>::LazySegmentTree(
+            std::vector<Base> const                         &init_values,
+            std::function<Base(Base&, Base&)>               bin_func,
+            std::function<Base(Base&, Tag&, std::size_t)>   apply_func,
+            std::function<Tag(Tag&, Tag&)>                  compose_func,
+            bool                                            type
+)
+    : bin_func_(bin_func)
+    , apply_func_(apply_func)
+    , compose_func_(compose_func)
+    , len_(init_values.size())
+    , type_(type)
+{
+    if (len_ == 0)
+    {
+        throw std::invalid_argument("A lazy segment tree needs at least one leaf.");
+    }
+
+    Allocate();
+
+    if (type_ == true)
+        BuildTreeRecursive(0, len_ - 1, init_values, 0);
+    else
+        BuildTreeIterative(init_values);
+}
+
+
+template <typename Base, typename Tag>
+LazySegmentTree<Base, Tag>::LazySegmentTree(
+            Base const                                      &init_value,
+            std::size_t const                               &len,
+            std::function<Base(Base&, Base&)>               bin_func,
+            std::function<Base(Base&, Tag&, std::size_t)>   apply_func,
+            std::function<Tag(Tag&, Tag&)>                  compose_func,
+            bool                                            type
+)
+    : bin_func_(bin_func)
+    , apply_func_(apply_func)
+    , compose_func_(compose_func)
+    , len_(len)
+    , type_(type)
+{
+    if (len_ == 0)
+    {
+        throw std::invalid_argument("A lazy segment tree needs at least one leaf.");
+    }
+
+    Allocate();
+
+    // A single element vector is read as the value of every leaf
+    std::vector<Base> init_values(1, init_value);
+
+    if (type_ == true)
+        BuildTreeRecursive(0, len_ - 1, init_values, 0);
+    else
+        BuildTreeIterative(init_values);
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::Allocate()
+{
+    if (type_ == true)
+    {
+        // Same heap shaped layout as the recursive SegmentTree,
+        // with one tag slot per node
+        std::size_t tree_size = SegmentTree<Base>::GetTreeSize(len_);
+        tree_.resize(tree_size);
+        tags_.resize(tree_size);
+        pending_.assign(tree_size, 0);
+    }
+    else
+    {
+        // The bottom-up layout is padded to a power of two leaves so
+        // that every internal node covers one contiguous range, which
+        // a pending tag can be applied to.
+        size_ = 1;
+        height_ = 0;
+        while (size_ < len_)
+        {
+            size_ <<= 1;
+            height_ += 1;
+        }
+        tree_.resize(size_ * 2);
+        tags_.resize(size_);
+        pending_.assign(size_, 0);
+    }
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::BuildTreeRecursive(
+            std::size_t             l_index,
+            std::size_t             r_index,
+            std::vector<Base> const &init_values,
+            std::size_t             tree_index
+)
+{
+    if (l_index == r_index)
+    {
+        // Storing value into leaf node of the tree
+        tree_[tree_index] = init_values.size() == 1 ? init_values[0] : init_values[l_index];
+        return;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t next_tree_index = (tree_index << 1) + 1;
+
+    BuildTreeRecursive(l_index, boundary, init_values, next_tree_index);
+    BuildTreeRecursive(boundary + 1, r_index, init_values, next_tree_index + 1);
+
+    tree_[tree_index] = bin_func_(tree_[next_tree_index], tree_[next_tree_index + 1]);
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::BuildTreeIterative(
+            std::vector<Base> const &init_values
+)
+{
+    for (std::size_t i = 0; i < len_; i++)
+    {
+        // storing the leaf values into the last size_ indices,
+        // the padding leaves keep their value initialized Base{}
+        tree_[size_ + i] = init_values.size() == 1 ? init_values[0] : init_values[i];
+    }
+    for (std::size_t i = size_ - 1; i > 0; i--)
+    {
+        tree_[i] = bin_func_(tree_[i << 1], tree_[(i << 1) | 1]);
+    }
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::ApplyTag(
+            std::size_t tree_index,
+            Tag         &tag,
+            std::size_t count
+)
+{
+    tree_[tree_index] = apply_func_(tree_[tree_index], tag, count);
+
+    if (tree_index >= pending_.size())
+    {
+        // Iterative leaves have no children to hand the tag to
+        return;
+    }
+
+    if (pending_[tree_index])
+    {
+        // Earlier tag still waiting for the children, so the new one
+        // is composed after it.
+        tags_[tree_index] = compose_func_(tags_[tree_index], tag);
+    }
+    else
+    {
+        tags_[tree_index] = tag;
+        pending_[tree_index] = 1;
+    }
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::PushDown(
+            std::size_t tree_index,
+            std::size_t l_index,
+            std::size_t boundary,
+            std::size_t r_index
+)
+{
+    if (!pending_[tree_index])
+        return;
+
+    std::size_t next_tree_index = (tree_index << 1) + 1;
+
+    ApplyTag(next_tree_index, tags_[tree_index], boundary - l_index + 1);
+    ApplyTag(next_tree_index + 1, tags_[tree_index], r_index - boundary);
+    pending_[tree_index] = 0;
+}
+
+
+template <typename Base, typename Tag>
+Base LazySegmentTree<Base, Tag>::QueryRecursive(
+            std::size_t l_qbound,
+            std::size_t r_qbound,
+            std::size_t l_index,
+            std::size_t r_index,
+            std::size_t tree_index
+)
+{
+    if (l_qbound <= l_index && r_index <= r_qbound)
+    {
+        // The current subtree lies completely inside the query range
+        return tree_[tree_index];
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t next_tree_index = (tree_index << 1) + 1;
+
+    // Children must reflect every tag applied above them
+    // before they are read.
+    PushDown(tree_index, l_index, boundary, r_index);
+
+    if (r_qbound <= boundary)
+    {
+        return QueryRecursive(l_qbound, r_qbound, l_index, boundary, next_tree_index);
+    }
+    else if (l_qbound > boundary)
+    {
+        return QueryRecursive(l_qbound, r_qbound, boundary + 1, r_index, next_tree_index + 1);
+    }
+    else
+    {
+        Base l_query = QueryRecursive(l_qbound, boundary, l_index, boundary, next_tree_index);
+        Base r_query = QueryRecursive(boundary + 1, r_qbound, boundary + 1, r_index, next_tree_index + 1);
+        return bin_func_(l_query, r_query);
+    }
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::RangeUpdateRecursive(
+            std::size_t l_qbound,
+            std::size_t r_qbound,
+            Tag         &tag,
+            std::size_t l_index,
+            std::size_t r_index,
+            std::size_t tree_index
+)
+{
+    if (l_qbound <= l_index && r_index <= r_qbound)
+    {
+        // The whole subtree is updated, so the tag is stored at its
+        // root and only handed further down when needed.
+        ApplyTag(tree_index, tag, r_index - l_index + 1);
+        return;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t next_tree_index = (tree_index << 1) + 1;
+
+    PushDown(tree_index, l_index, boundary, r_index);
+
+    if (l_qbound <= boundary)
+        RangeUpdateRecursive(l_qbound, r_qbound, tag, l_index, boundary, next_tree_index);
+    if (r_qbound > boundary)
+        RangeUpdateRecursive(l_qbound, r_qbound, tag, boundary + 1, r_index, next_tree_index + 1);
+
+    tree_[tree_index] = bin_func_(tree_[next_tree_index], tree_[next_tree_index + 1]);
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::UpdateRecursive(
+            Base const          &new_value,
+            std::size_t const   &final_index,
+            std::size_t         l_index,
+            std::size_t         r_index,
+            std::size_t         tree_index
+)
+{
+    if (l_index == r_index)
+    {
+        tree_[tree_index] = new_value;
+        return;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t next_tree_index = (tree_index << 1) + 1;
+
+    PushDown(tree_index, l_index, boundary, r_index);
+
+    if (final_index <= boundary)
+        UpdateRecursive(new_value, final_index, l_index, boundary, next_tree_index);
+    else
+        UpdateRecursive(new_value, final_index, boundary + 1, r_index, next_tree_index + 1);
+
+    tree_[tree_index] = bin_func_(tree_[next_tree_index], tree_[next_tree_index + 1]);
+}
+
+
+template <typename Base, typename Tag>
+std::size_t LazySegmentTree<Base, Tag>::LeafCount(
+            std::size_t tree_index,
+            std::size_t height
+)
+{
+    // First leaf (0-indexed) below the node, and the open end of
+    // its range, clipped to the real leaves.
+    std::size_t first = (tree_index << height) - size_;
+    std::size_t last = first + (std::size_t(1) << height);
+
+    if (first >= len_)
+        return 0;
+    return std::min(last, len_) - first;
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::PushPath(
+            std::size_t tree_index
+)
+{
+    for (std::size_t s = height_; s > 0; s--)
+    {
+        std::size_t i = tree_index >> s;
+
+        if (i == 0 || !pending_[i])
+            continue;
+
+        // Children of i sit s - 1 levels above the leaves. Nodes
+        // covering only padding are skipped, so padding leaves keep
+        // their identity value.
+        std::size_t count = LeafCount(i << 1, s - 1);
+        if (count > 0)
+            ApplyTag(i << 1, tags_[i], count);
+        count = LeafCount((i << 1) | 1, s - 1);
+        if (count > 0)
+            ApplyTag((i << 1) | 1, tags_[i], count);
+
+        pending_[i] = 0;
+    }
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::PullPath(
+            std::size_t tree_index
+)
+{
+    std::size_t height = 0;
+
+    while (tree_index > 1)
+    {
+        tree_index >>= 1;
+        height += 1;
+
+        tree_[tree_index] = bin_func_(tree_[tree_index << 1], tree_[(tree_index << 1) | 1]);
+
+        // A tag stored on this node has not reached its children,
+        // so it is applied again on top of their merged value.
+        if (pending_[tree_index])
+            tree_[tree_index] = apply_func_(tree_[tree_index], tags_[tree_index],
+                                            LeafCount(tree_index, height));
+    }
+}
+
+
+template <typename Base, typename Tag>
+Base LazySegmentTree<Base, Tag>::QueryIterative(
+            std::size_t l_qbound,
+            std::size_t r_qbound
+)
+{
+    std::size_t l_ind = l_qbound + size_, r_ind = r_qbound + size_ + 1;
+
+    // Only the nodes on the two boundary paths can hold tags that
+    // the visited nodes have not seen yet.
+    PushPath(l_ind);
+    PushPath(r_ind - 1);
+
+    Base l_query{};
+    Base r_query{};
+
+    while (l_ind < r_ind)
+    {
+        if (l_ind & 1)
+        {
+            l_query = bin_func_(l_query, tree_[l_ind]);
+            l_ind += 1;
+        }
+        if (r_ind & 1)
+        {
+            r_ind -= 1;
+            r_query = bin_func_(tree_[r_ind], r_query);
+        }
+
+        l_ind >>= 1;
+        r_ind >>= 1;
+    }
+
+    return bin_func_(l_query, r_query);
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::RangeUpdateIterative(
+            std::size_t l_qbound,
+            std::size_t r_qbound,
+            Tag         &tag
+)
+{
+    std::size_t l_first = l_qbound + size_, r_last = r_qbound + size_;
+
+    // Pending tags on the boundary paths are pushed first, so
+    // that tags composed below them keep the order of the updates.
+    PushPath(l_first);
+    PushPath(r_last);
+
+    std::size_t height = 0;
+    for (std::size_t l_ind = l_first, r_ind = r_last + 1; l_ind < r_ind; l_ind >>= 1, r_ind >>= 1, height++)
+    {
+        if (l_ind & 1)
+        {
+            ApplyTag(l_ind, tag, LeafCount(l_ind, height));
+            l_ind += 1;
+        }
+        if (r_ind & 1)
+        {
+            r_ind -= 1;
+            ApplyTag(r_ind, tag, LeafCount(r_ind, height));
+        }
+    }
+
+    // Ancestors of the tagged nodes are recomputed along the
+    // two boundary paths.
+    PullPath(l_first);
+    PullPath(r_last);
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::UpdateIterative(
+            Base const          &new_value,
+            std::size_t const   &index
+)
+{
+    std::size_t i = index + size_;
+
+    PushPath(i);
+    tree_[i] = new_value;
+    PullPath(i);
+}
+
+
+template <typename Base, typename Tag>
+Base LazySegmentTree<Base, Tag>::Query(
+            std::size_t l_qbound,
+            std::size_t r_qbound
+)
+{
+    if (l_qbound >= len_ || r_qbound >= len_)
+    {
+        // query bounds moving out of segment tree range
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+    if (l_qbound > r_qbound)
+    {
+        // query left bound greater than query right bound
+        throw std::out_of_range("The left index must be smaller than the right index.");
+    }
+
+    if (type_ == true)
+        return QueryRecursive(l_qbound, r_qbound, 0, len_ - 1, 0);
+    else
+        return QueryIterative(l_qbound, r_qbound);
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::RangeUpdate(
+            std::size_t l_qbound,
+            std::size_t r_qbound,
+            Tag const   &tag
+)
+{
+    if (l_qbound >= len_ || r_qbound >= len_)
+    {
+        // update bounds moving out of segment tree range
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+    if (l_qbound > r_qbound)
+    {
+        // update left bound greater than update right bound
+        throw std::out_of_range("The left index must be smaller than the right index.");
+    }
+
+    // The user functions take non const references
+    Tag tag_copy = tag;
+
+    if (type_ == true)
+        RangeUpdateRecursive(l_qbound, r_qbound, tag_copy, 0, len_ - 1, 0);
+    else
+        RangeUpdateIterative(l_qbound, r_qbound, tag_copy);
+}
+
+
+template <typename Base, typename Tag>
+void LazySegmentTree<Base, Tag>::Update(
+            Base const          &new_value,
+            std::size_t const   &index
+)
+{
+    if (index >= len_)
+    {
+        // update node out of segment tree range
+        throw std::out_of_range("The index must be within the range of the segment tree.");
+    }
+
+    if (type_ == true)
+        UpdateRecursive(new_value, index, 0, len_ - 1, 0);
+    else
+        UpdateIterative(new_value, index);
+}
+
+#endif
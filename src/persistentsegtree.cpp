@@ -0,0 +1,335 @@
+#ifndef _PERSISTENTSEGMENTTREE_CPP_
+#define _PERSISTENTSEGMENTTREE_CPP_
+
+#include <stdexcept>
+
+#include "persistentsegtree.h"
+
+
+template <typename Base, typename Op>
+std::size_t const PersistentSegmentTree<Base, Op>::kNone;
+
+
+template <typename Base, typename Op>
+PersistentSegmentTree<Base, Op>::PersistentSegmentTree(
+            std::vector<Base> const   &init_values,
+            Op                        bin_func
+)
+    : bin_func_(bin_func)
+    , len_(init_values.size())
+{
+    if (len_ == 0)
+    {
+        throw std::invalid_argument("A persistent segment tree needs at least one leaf.");
+    }
+
+    nodes_.reserve(2 * len_ - 1);
+    root_ = BuildRecursive(0, len_ - 1, init_values);
+
+    // No node is shared yet, so the current version owns all of them
+    mutable_from_ = 0;
+    compacted_ = nodes_.size();
+}
+
+
+template <typename Base, typename Op>
+PersistentSegmentTree<Base, Op>::PersistentSegmentTree(
+            Base const                &init_value,
+            std::size_t const         &len,
+            Op                        bin_func
+)
+    : bin_func_(bin_func)
+    , len_(len)
+{
+    if (len_ == 0)
+    {
+        throw std::invalid_argument("A persistent segment tree needs at least one leaf.");
+    }
+
+    std::map<std::size_t, std::size_t> built;
+    root_ = BuildShared(len_, init_value, built);
+
+    // Subtrees are shared within the version itself, so every
+    // node has to be copied before it is written to.
+    mutable_from_ = nodes_.size();
+    compacted_ = nodes_.size();
+}
+
+
+template <typename Base, typename Op>
+std::size_t PersistentSegmentTree<Base, Op>::BuildRecursive(
+            std::size_t              l_index,
+            std::size_t              r_index,
+            std::vector<Base> const  &init_values
+)
+{
+    if (l_index == r_index)
+        return NewNode(init_values[l_index], kNone, kNone);
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t left = BuildRecursive(l_index, boundary, init_values);
+    std::size_t right = BuildRecursive(boundary + 1, r_index, init_values);
+
+    return NewNode(bin_func_(nodes_[left].value, nodes_[right].value), left, right);
+}
+
+
+template <typename Base, typename Op>
+std::size_t PersistentSegmentTree<Base, Op>::BuildShared(
+            std::size_t                             len,
+            Base const                              &init_value,
+            std::map<std::size_t, std::size_t>      &built
+)
+{
+    // The shape (and so the value) of a subtree of equal leaves only
+    // depends on its number of leaves, and each level of the tree has
+    // at most two different sizes.
+    typename std::map<std::size_t, std::size_t>::iterator it = built.find(len);
+    if (it != built.end())
+        return it->second;
+
+    std::size_t node;
+    if (len == 1)
+    {
+        node = NewNode(init_value, kNone, kNone);
+    }
+    else
+    {
+        // Same split as BuildRecursive: the left half gets the middle leaf
+        std::size_t left = BuildShared((len + 1) >> 1, init_value, built);
+        std::size_t right = BuildShared(len >> 1, init_value, built);
+        node = NewNode(bin_func_(nodes_[left].value, nodes_[right].value), left, right);
+    }
+
+    built[len] = node;
+    return node;
+}
+
+
+template <typename Base, typename Op>
+std::size_t PersistentSegmentTree<Base, Op>::NewNode(
+            Base const  &value,
+            std::size_t left,
+            std::size_t right
+)
+{
+    Node node = {value, left, right};
+    nodes_.push_back(node);
+    return nodes_.size() - 1;
+}
+
+
+template <typename Base, typename Op>
+Base PersistentSegmentTree<Base, Op>::Query(
+            std::size_t  l_index,
+            std::size_t  r_index
+)
+{
+    CheckRange(l_index, r_index);
+    return QueryRecursive(l_index, r_index, 0, len_ - 1, root_);
+}
+
+
+template <typename Base, typename Op>
+Base PersistentSegmentTree<Base, Op>::Query(
+            std::size_t  version,
+            std::size_t  l_index,
+            std::size_t  r_index
+)
+{
+    CheckRange(l_index, r_index);
+    return QueryRecursive(l_index, r_index, 0, len_ - 1, RootOf(version));
+}
+
+
+template <typename Base, typename Op>
+Base PersistentSegmentTree<Base, Op>::QueryRecursive(
+            std::size_t l_qbound,
+            std::size_t r_qbound,
+            std::size_t l_index,
+            std::size_t r_index,
+            std::size_t node
+)
+{
+    if (l_qbound <= l_index && r_index <= r_qbound)
+    {
+        // The subtree lies completely inside the range of the query
+        return nodes_[node].value;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+
+    if (r_qbound <= boundary)
+        return QueryRecursive(l_qbound, r_qbound, l_index, boundary, nodes_[node].left);
+    if (l_qbound > boundary)
+        return QueryRecursive(l_qbound, r_qbound, boundary + 1, r_index, nodes_[node].right);
+
+    Base l_query = QueryRecursive(l_qbound, boundary, l_index, boundary, nodes_[node].left);
+    Base r_query = QueryRecursive(boundary + 1, r_qbound, boundary + 1, r_index, nodes_[node].right);
+    return bin_func_(l_query, r_query);
+}
+
+
+template <typename Base, typename Op>
+void PersistentSegmentTree<Base, Op>::Update(
+            Base const          &new_value,
+            std::size_t const   &index
+)
+{
+    if (index >= len_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+
+    root_ = UpdateRecursive(new_value, index, 0, len_ - 1, root_);
+}
+
+
+template <typename Base, typename Op>
+std::size_t PersistentSegmentTree<Base, Op>::UpdateRecursive(
+            Base const          &new_value,
+            std::size_t const   &final_index,
+            std::size_t         l_index,
+            std::size_t         r_index,
+            std::size_t         node
+)
+{
+    // A node that a snapshot (or another part of this version) may
+    // refer to is copied, the others are written in place. Nodes are
+    // addressed by index since the arena may reallocate.
+    if (node < mutable_from_)
+        node = NewNode(nodes_[node].value, nodes_[node].left, nodes_[node].right);
+
+    if (l_index == r_index)
+    {
+        nodes_[node].value = new_value;
+        return node;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+
+    if (final_index <= boundary)
+    {
+        std::size_t left = UpdateRecursive(new_value, final_index, l_index, boundary, nodes_[node].left);
+        nodes_[node].left = left;
+    }
+    else
+    {
+        std::size_t right = UpdateRecursive(new_value, final_index, boundary + 1, r_index, nodes_[node].right);
+        nodes_[node].right = right;
+    }
+
+    nodes_[node].value = bin_func_(nodes_[nodes_[node].left].value, nodes_[nodes_[node].right].value);
+    return node;
+}
+
+
+template <typename Base, typename Op>
+std::size_t PersistentSegmentTree<Base, Op>::Snapshot()
+{
+    // Every existing node may now be shared with the snapshot
+    versions_.push_back(root_);
+    mutable_from_ = nodes_.size();
+    return versions_.size() - 1;
+}
+
+
+template <typename Base, typename Op>
+void PersistentSegmentTree<Base, Op>::Release(
+            std::size_t version
+)
+{
+    RootOf(version);
+    versions_[version] = kNone;
+
+    // Compacting costs O(live nodes), so waiting for the arena to
+    // double keeps it amortized O(1) per node created.
+    if (nodes_.size() >= 2 * compacted_)
+        Compact();
+}
+
+
+template <typename Base, typename Op>
+std::size_t PersistentSegmentTree<Base, Op>::NodeCount() const
+{
+    return nodes_.size();
+}
+
+
+template <typename Base, typename Op>
+void PersistentSegmentTree<Base, Op>::CheckRange(
+            std::size_t l_index,
+            std::size_t r_index
+) const
+{
+    if (r_index >= len_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+    if (l_index > r_index)
+    {
+        throw std::out_of_range("The left index must be smaller than the right index.");
+    }
+}
+
+
+template <typename Base, typename Op>
+std::size_t PersistentSegmentTree<Base, Op>::RootOf(
+            std::size_t version
+) const
+{
+    if (version >= versions_.size() || versions_[version] == kNone)
+    {
+        throw std::invalid_argument("Unknown or released version.");
+    }
+
+    return versions_[version];
+}
+
+
+template <typename Base, typename Op>
+void PersistentSegmentTree<Base, Op>::Compact()
+{
+    std::vector<Node> arena;
+    std::vector<std::size_t> moved(nodes_.size(), kNone);
+
+    for (std::size_t v = 0; v < versions_.size(); v++)
+    {
+        if (versions_[v] != kNone)
+            versions_[v] = CopyReachable(versions_[v], arena, moved);
+    }
+    root_ = CopyReachable(root_, arena, moved);
+
+    nodes_.swap(arena);
+
+    // Whether a node was private to the current version is not kept,
+    // so all of them are treated as shared.
+    mutable_from_ = nodes_.size();
+    compacted_ = nodes_.size();
+}
+
+
+template <typename Base, typename Op>
+std::size_t PersistentSegmentTree<Base, Op>::CopyReachable(
+            std::size_t               node,
+            std::vector<Node>         &arena,
+            std::vector<std::size_t>  &moved
+)
+{
+    if (moved[node] != kNone)
+        return moved[node];
+
+    Node copy = nodes_[node];
+    if (copy.left != kNone)
+    {
+        // Children are copied first (the same node may be both of them)
+        copy.left = CopyReachable(copy.left, arena, moved);
+        copy.right = CopyReachable(copy.right, arena, moved);
+    }
+
+    arena.push_back(copy);
+    moved[node] = arena.size() - 1;
+    return moved[node];
+}
+
+#endif
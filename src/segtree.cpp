@@ -1,73 +1,435 @@
 #ifndef _SEGMENTTREE_CPP_
 #define _SEGMENTTREE_CPP_
 
-#include <cmath>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include <stdexcept>
+#include <type_traits>
 
 #include "segtree.h"
 
 
-template <typename Base>
-SegmentTree<Base>::SegmentTree(
+template <typename Base, typename Op, typename Alloc>
+std::size_t const SegmentTree<Base, Op, Alloc>::kBatchGroup;
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t const SegmentTree<Base, Op, Alloc>::kMaxDepth;
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t const SegmentTree<Base, Op, Alloc>::kWideFanout;
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t const SegmentTree<Base, Op, Alloc>::kSimdRun;
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t const SegmentTree<Base, Op, Alloc>::kParallelGrain;
+
+template <typename Base, typename Op, typename Alloc>
+std::uint32_t const SegmentTree<Base, Op, Alloc>::kFileVersion;
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t const SegmentTree<Base, Op, Alloc>::kLoadChunk;
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t const SegmentTree<Base, Op, Alloc>::kBlockSize;
+
+
+template <typename Base, typename Op, typename Alloc>
+SegmentTree<Base, Op, Alloc>::SegmentTree(
             std::vector<Base> const             &init_values, 
-            std::function<Base(Base&, Base&)>   bin_func, 
-            bool                                type
+            Op                                  bin_func, 
+            int                                 type,
+            std::size_t                         threads,
+            Alloc const                         &alloc
 )
-    : bin_func_(bin_func)
+    : tree_(alloc)
+    , bin_func_(bin_func)
     , len_(init_values.size())
+    , capacity_(init_values.size())
     , type_(type)
 {
+    CheckLeaves();
 
-    if (type_ == true)
+    if (IsRecursive())
     {
         // Chosing to store and operate on the segment
         // tree in a recursive fashion
-        tree_.resize(GetTreeSize(len_));
-        BuildTreeRecursive(0, len_ - 1, init_values, 0);
+        tree_.resize(RecursiveTreeSize());
+        if (type_ == TREE_VEB)
+            BuildVebSteps();
+        if (threads > 1)
+            BuildTreeRecursiveParallel(0, len_ - 1, init_values, 0, threads);
+        else
+            BuildTreeRecursive(0, len_ - 1, init_values, 0);
     }
-    else
+    else if (type_ == TREE_ITERATIVE)
     {
         // Chosing to store and operate on the segment
         // tree in a iterative fashion
         tree_.resize(len_ * 2);
-        BuildTreeIterative(init_values);
+        BuildTreeIterative(init_values, threads);
+    }
+    else if (type_ == TREE_WIDE)
+    {
+        // Chosing to store and operate on the segment
+        // tree with wide nodes, leaves first
+        AllocateWide();
+        for (std::size_t i = 0; i < len_; i++)
+            tree_[i] = init_values[i];
+        BuildTreeWide();
+    }
+    else if (type_ == TREE_BLOCKED)
+    {
+        // Chosing to store the leaves in contiguous blocks,
+        // with a tree over the blocks only
+        AllocateBlocked();
+        for (std::size_t i = 0; i < len_; i++)
+            tree_[2 * capacity_ + i] = init_values[i];
+        BuildTreeBlocked(threads);
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown segment tree type.");
     }
 }
 
 
-template <typename Base>
-SegmentTree<Base>::SegmentTree(
+template <typename Base, typename Op, typename Alloc>
+SegmentTree<Base, Op, Alloc>::SegmentTree(
             Base const                          &init_value, 
             std::size_t const                   &len, 
-            std::function<Base(Base&, Base&)>   bin_func, 
-            bool                                type
+            Op                                  bin_func, 
+            int                                 type,
+            std::size_t                         threads,
+            Alloc const                         &alloc
 )
-    : bin_func_(bin_func)
+    : tree_(alloc)
+    , bin_func_(bin_func)
     , len_(len)
+    , capacity_(len)
     , type_(type)
 {
+    CheckLeaves();
 
-    if (type_ == true)
+    if (IsRecursive())
     {
         // Chosing to store and operate on the segment
         // tree in a recursive fashion
-        tree_.resize(GetTreeSize(len_));
-        BuildTreeRecursive(0, len_ - 1, init_value, 0);
+        tree_.resize(RecursiveTreeSize());
+        if (type_ == TREE_VEB)
+            BuildVebSteps();
+        if (threads > 1)
+            BuildTreeRecursiveParallel(0, len_ - 1, init_value, 0, threads);
+        else
+            BuildTreeRecursive(0, len_ - 1, init_value, 0);
     }
-    else
+    else if (type_ == TREE_ITERATIVE)
     {
         // Chosing to store and operate on the segment
         // tree in a iterative fashion
         tree_.resize(len_ * 2);
-        BuildTreeIterative(init_value);
+        BuildTreeIterative(init_value, threads);
+    }
+    else if (type_ == TREE_WIDE)
+    {
+        // Chosing to store and operate on the segment
+        // tree with wide nodes, leaves first
+        AllocateWide();
+        for (std::size_t i = 0; i < len_; i++)
+            tree_[i] = init_value;
+        BuildTreeWide();
+    }
+    else if (type_ == TREE_BLOCKED)
+    {
+        // Chosing to store the leaves in contiguous blocks,
+        // with a tree over the blocks only
+        AllocateBlocked();
+        for (std::size_t i = 0; i < len_; i++)
+            tree_[2 * capacity_ + i] = init_value;
+        BuildTreeBlocked(threads);
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown segment tree type.");
+    }
+}
+
+
+
+template <typename Base, typename Op, typename Alloc>
+SegmentTree<Base, Op, Alloc>::SegmentTree(
+            std::vector<Base>                   &&init_values,
+            Op                                  bin_func,
+            int                                 type,
+            std::size_t                         threads,
+            Alloc const                         &alloc
+)
+    : tree_(alloc)
+    , bin_func_(bin_func)
+    , len_(init_values.size())
+    , capacity_(init_values.size())
+    , type_(type)
+{
+    std::size_t i = 0;
+    std::vector<Base> &values = init_values;
+
+    BuildFromSequence([&]() -> Base
+    {
+        Base leaf = std::move(values[i]);
+        if (++i == len_)
+        {
+            // All leaves are in the tree, so the vector is released
+            // before the internal nodes are built.
+            std::vector<Base>().swap(values);
+        }
+        return leaf;
+    }, threads);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename InputIt, typename>
+SegmentTree<Base, Op, Alloc>::SegmentTree(
+            InputIt                             first,
+            InputIt                             last,
+            Op                                  bin_func,
+            int                                 type,
+            std::size_t                         threads,
+            Alloc const                         &alloc
+)
+    : tree_(alloc)
+    , bin_func_(bin_func)
+    , len_(0)
+    , capacity_(0)
+    , type_(type)
+{
+    BuildFromRange(first, last, threads,
+                   typename std::iterator_traits<InputIt>::iterator_category());
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename ForwardIt>
+void SegmentTree<Base, Op, Alloc>::BuildFromRange(
+            ForwardIt                   first,
+            ForwardIt                   last,
+            std::size_t                 threads,
+            std::forward_iterator_tag
+)
+{
+    len_ = std::distance(first, last);
+    BuildFromSequence([&]() -> Base { return *first++; }, threads);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename InputIt>
+void SegmentTree<Base, Op, Alloc>::BuildFromRange(
+            InputIt                     first,
+            InputIt                     last,
+            std::size_t                 threads,
+            std::input_iterator_tag
+)
+{
+    // The values can only be read once, and the length is needed
+    // before the tree can be allocated.
+    std::vector<Base> values(first, last);
+    *this = SegmentTree(std::move(values), bin_func_, type_, threads, tree_.get_allocator());
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+SegmentTree<Base, Op, Alloc> SegmentTree<Base, Op, Alloc>::LoadText(
+            std::string const   &path,
+            Op                  bin_func,
+            int                 type,
+            std::size_t         threads,
+            Alloc const         &alloc
+)
+{
+    std::ifstream in(path.c_str());
+    if (!in)
+    {
+        throw std::runtime_error("Cannot open leaf file " + path + ".");
+    }
+
+    // First pass: counting the values, as runs of non-blank
+    // characters, a chunk at a time.
+    std::vector<char> chunk(kLoadChunk);
+    std::size_t count = 0;
+    bool in_value = false;
+
+    while (in.read(chunk.data(), chunk.size()) || in.gcount() > 0)
+    {
+        for (std::streamsize i = 0; i < in.gcount(); i++)
+        {
+            bool blank = std::isspace(static_cast<unsigned char>(chunk[i])) != 0;
+            count += !blank && !in_value;
+            in_value = !blank;
+        }
+    }
+
+    if (count == 0)
+    {
+        throw std::runtime_error("No leaf values in " + path + ".");
+    }
+
+    in.clear();
+    in.seekg(0);
+
+    SegmentTree tree(bin_func, alloc);
+    tree.len_ = count;
+    tree.type_ = type;
+
+    // Second pass: parsing each value straight into its leaf
+    tree.BuildFromSequence([&]() -> Base
+    {
+        Base leaf;
+        if (!(in >> leaf))
+        {
+            throw std::runtime_error("Cannot parse a leaf value in " + path + ".");
+        }
+        return leaf;
+    }, threads);
+
+    return tree;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+SegmentTree<Base, Op, Alloc> SegmentTree<Base, Op, Alloc>::LoadBinary(
+            std::string const     &path,
+            Op                    bin_func,
+            int                   type,
+            std::size_t           threads,
+            Alloc const           &alloc
+)
+{
+    static_assert(std::is_trivially_copyable<Base>::value,
+                  "Only trivially copyable types can be loaded from binary files.");
+
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!in)
+    {
+        throw std::runtime_error("Cannot open leaf file " + path + ".");
+    }
+
+    std::size_t bytes = in.tellg();
+    if (bytes == 0)
+    {
+        throw std::runtime_error("No leaf values in " + path + ".");
+    }
+    if (bytes % sizeof(Base) != 0)
+    {
+        throw std::runtime_error("Size of leaf file " + path + " is not a multiple of the value size.");
+    }
+    in.seekg(0);
+
+    SegmentTree tree(bin_func, alloc);
+    tree.len_ = bytes / sizeof(Base);
+    tree.type_ = type;
+
+    std::vector<Base> chunk(kLoadChunk);
+    std::size_t position = 0, available = 0;
+
+    tree.BuildFromSequence([&]() -> Base
+    {
+        if (position == available)
+        {
+            in.read(reinterpret_cast<char *>(chunk.data()), chunk.size() * sizeof(Base));
+            available = in.gcount() / sizeof(Base);
+            position = 0;
+            if (available == 0)
+            {
+                throw std::runtime_error("Cannot read leaf file " + path + ".");
+            }
+        }
+        return chunk[position++];
+    }, threads);
+
+    return tree;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename NextLeaf>
+void SegmentTree<Base, Op, Alloc>::BuildFromSequence(
+            NextLeaf     next,
+            std::size_t  threads
+)
+{
+    CheckLeaves();
+
+    if (IsRecursive())
+    {
+        // Leaves are reached in order, but one at a time,
+        // so this build is always serial.
+        tree_.resize(RecursiveTreeSize());
+        if (type_ == TREE_VEB)
+            BuildVebSteps();
+        BuildTreeRecursiveFrom(0, len_ - 1, next, 0);
+    }
+    else if (type_ == TREE_ITERATIVE)
+    {
+        capacity_ = len_;
+        tree_.resize(len_ * 2);
+        for (std::size_t i = 0; i < len_; i++)
+            tree_[capacity_ + i] = next();
+        BuildInternalIterative(threads);
+    }
+    else if (type_ == TREE_WIDE)
+    {
+        AllocateWide();
+        for (std::size_t i = 0; i < len_; i++)
+            tree_[i] = next();
+        BuildTreeWide();
+    }
+    else if (type_ == TREE_BLOCKED)
+    {
+        AllocateBlocked();
+        for (std::size_t i = 0; i < len_; i++)
+            tree_[2 * capacity_ + i] = next();
+        BuildTreeBlocked(threads);
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown segment tree type.");
     }
 }
 
 
+template <typename Base, typename Op, typename Alloc>
+template <typename NextLeaf>
+void SegmentTree<Base, Op, Alloc>::BuildTreeRecursiveFrom(
+            std::size_t l_index,
+            std::size_t r_index,
+            NextLeaf    &next,
+            std::size_t tree_index
+)
+{
+    if (l_index == r_index)
+    {
+        tree_[NodePosition(tree_index)] = next();
+        return;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t next_tree_index = LeftChild(tree_index);
+    std::size_t r_tree_index = RightChild(tree_index, l_index, boundary);
+
+    BuildTreeRecursiveFrom(l_index, boundary, next, next_tree_index);
+    BuildTreeRecursiveFrom(boundary + 1, r_index, next, r_tree_index);
+
+    Combine(tree_[NodePosition(tree_index)], tree_[NodePosition(next_tree_index)], tree_[NodePosition(r_tree_index)]);
+}
+
 
-template <typename Base>
-void SegmentTree<Base>::BuildTreeRecursive(
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::BuildTreeRecursive(
             std::size_t             l_index, 
             std::size_t             r_index, 
             std::vector<Base> const &init_values, 
@@ -79,26 +441,27 @@ void SegmentTree<Base>::BuildTreeRecursive(
     {
         // Storing value into leaf node of the tree
         // from corresponding vector index
-        tree_[tree_index] = init_values[l_index];
+        tree_[NodePosition(tree_index)] = init_values[l_index];
         return;
     }
 
     std::size_t boundary = (l_index + r_index) >> 1;
-    std::size_t next_tree_index = (tree_index << 1) + 1;
+    std::size_t next_tree_index = LeftChild(tree_index);
+    std::size_t r_tree_index = RightChild(tree_index, l_index, boundary);
     
     // build tree on left branch
     BuildTreeRecursive(l_index, boundary, init_values, next_tree_index);
     // build tree on right branch
-    BuildTreeRecursive(boundary + 1, r_index, init_values, next_tree_index + 1);
+    BuildTreeRecursive(boundary + 1, r_index, init_values, r_tree_index);
 
     // storing value of the current tree node,
     // by merging left and right children
-    tree_[tree_index] = bin_func_(tree_[next_tree_index], tree_[next_tree_index + 1]);
+    Combine(tree_[NodePosition(tree_index)], tree_[NodePosition(next_tree_index)], tree_[NodePosition(r_tree_index)]);
 }
 
 
-template <typename Base>
-void SegmentTree<Base>::BuildTreeRecursive(
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::BuildTreeRecursive(
             std::size_t l_index, 
             std::size_t r_index, 
             Base const  &init_value, 
@@ -110,113 +473,234 @@ void SegmentTree<Base>::BuildTreeRecursive(
     {
         // Storing value into leaf node of the tree
         // from default leaf node value 
-        tree_[tree_index] = init_value;
+        tree_[NodePosition(tree_index)] = init_value;
         return;
     }
 
     std::size_t boundary = (l_index + r_index) >> 1;
-    std::size_t next_tree_index = (tree_index << 1) + 1;
+    std::size_t next_tree_index = LeftChild(tree_index);
+    std::size_t r_tree_index = RightChild(tree_index, l_index, boundary);
     
     // build tree on left branch
     BuildTreeRecursive(l_index, boundary, init_value, next_tree_index);
     // build tree on right branch
-    BuildTreeRecursive(boundary + 1, r_index, init_value, next_tree_index + 1);
+    BuildTreeRecursive(boundary + 1, r_index, init_value, r_tree_index);
 
     // storing value of the current tree node,
     // by merging left and right children
-    tree_[tree_index] = bin_func_(tree_[next_tree_index], tree_[next_tree_index + 1]);
+    Combine(tree_[NodePosition(tree_index)], tree_[NodePosition(next_tree_index)], tree_[NodePosition(r_tree_index)]);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Source>
+void SegmentTree<Base, Op, Alloc>::BuildTreeRecursiveParallel(
+            std::size_t     l_index,
+            std::size_t     r_index,
+            Source const    &init,
+            std::size_t     tree_index,
+            std::size_t     threads
+)
+{
+    if (threads < 2 || r_index - l_index < 2 * kParallelGrain)
+    {
+        // Small enough (or a single thread left) to be built serially
+        BuildTreeRecursive(l_index, r_index, init, tree_index);
+        return;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t next_tree_index = LeftChild(tree_index);
+    std::size_t r_tree_index = RightChild(tree_index, l_index, boundary);
+
+    // The two subtrees occupy disjoint nodes, so the left one is
+    // built by a new thread while this one builds the right one.
+    std::size_t l_threads = threads >> 1;
+    std::thread left(&SegmentTree::BuildTreeRecursiveParallel<Source>, this,
+                     l_index, boundary, std::cref(init), next_tree_index, l_threads);
+    BuildTreeRecursiveParallel(boundary + 1, r_index, init, r_tree_index, threads - l_threads);
+    left.join();
+
+    Combine(tree_[NodePosition(tree_index)], tree_[NodePosition(next_tree_index)], tree_[NodePosition(r_tree_index)]);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::BuildTreeIterative(
+            std::vector<Base> const &init_values,
+            std::size_t             threads
+)
+{
+    ParallelFor(0, len_, threads, [&](std::size_t first, std::size_t last)
+    {
+        for(size_t i = first; i < last; i++)
+        {
+            // storing the leaf values into the tree
+            // from initializing vector. Stored into the
+            // last nLeaves indices
+            tree_[capacity_ + i] = init_values[i];
+        }
+    });
+    BuildInternalIterative(threads);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::BuildTreeIterative(
+            Base const  &init_value,
+            std::size_t threads
+)
+{
+    ParallelFor(0, len_, threads, [&](std::size_t first, std::size_t last)
+    {
+        for(size_t i = first; i < last; i++)
+        {
+            // storing the leaf values into the tree
+            // with the given default value. Stored into the
+            // last nLeaves indices
+            tree_[capacity_ + i] = init_value;
+        }
+    });
+    BuildInternalIterative(threads);
 }
 
 
-template <typename Base>
-void SegmentTree<Base>::BuildTreeIterative(
-            std::vector<Base> const &init_values
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::BuildInternalIterative(
+            std::size_t threads
 )
 {
-    for(size_t i = 0; i < len_; i++)
+    // Nodes [lo, hi) with hi <= 2 * lo only have children in [hi, 2 * hi),
+    // which are leaves or were computed in an earlier pass, so each pass
+    // is one independent loop over contiguous pairs of children. It can
+    // be split across threads, and each chunk handed to the SIMD kernel.
+    // Passes shrink by half, so the top of the tree ends up serial.
+    std::size_t hi = capacity_;
+
+    while (hi > 1)
     {
-        // storing the leaf values into the tree
-        // from initializing vector. Stored into the
-        // last nLeaves indices
-        tree_[len_ + i] = init_values[i];
+        std::size_t lo = (hi + 1) >> 1;
+        ParallelFor(lo, hi, threads, [this](std::size_t first, std::size_t last)
+        {
+            BuildPassIterative(first, last);
+        });
+        hi = lo;
     }
-    for(size_t i = len_ - 1; i > 0; i--)
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::BuildPassIterative(
+            std::size_t first,
+            std::size_t last
+)
+{
+    std::size_t i = first + SimdKernel<Base, Op>::PairReduce(tree_, first, first << 1, last - first);
+
+    for (; i < last; i++)
     {
-        // getting the value of every tree node
-        // in a reverse order by merging the two children
-        // which have been calculated earlier
-        tree_[i] = bin_func_(tree_[i << 1], tree_[(i << 1) | 1]);
+        // getting the value of every remaining tree node
+        // by merging the two children
+        Combine(tree_[i], tree_[i << 1], tree_[(i << 1) | 1]);
     }
 }
 
 
-template <typename Base>
-void SegmentTree<Base>::BuildTreeIterative(
-            Base const &init_value
+template <typename Base, typename Op, typename Alloc>
+template <typename Body>
+void SegmentTree<Base, Op, Alloc>::ParallelFor(
+            std::size_t first,
+            std::size_t last,
+            std::size_t threads,
+            Body        body
 )
 {
-    for(size_t i = 0; i < len_; i++)
+    std::size_t chunks = std::min(threads, (last - first) / kParallelGrain);
+
+    if (chunks < 2)
     {
-        // storing the leaf values into the tree
-        // with the given default value. Stored into the
-        // last nLeaves indices
-        tree_[len_ + i] = init_value;
+        body(first, last);
+        return;
     }
-    for(size_t i = len_ - 1; i > 0; i--)
+
+    std::vector<std::thread> workers;
+    std::size_t chunk_size = (last - first) / chunks;
+
+    // The first chunks go to new threads, and the last one, which
+    // takes the remainder, to the calling thread.
+    for (std::size_t c = 0; c + 1 < chunks; c++)
     {
-        // getting the value of every tree node
-        // in a reverse order by merging the two children
-        // which have been calculated earlier
-        tree_[i] = bin_func_(tree_[i << 1], tree_[(i << 1) | 1]);
+        std::size_t begin = first + c * chunk_size;
+        workers.push_back(std::thread(body, begin, begin + chunk_size));
     }
+    body(first + (chunks - 1) * chunk_size, last);
+
+    for (std::size_t c = 0; c < workers.size(); c++)
+        workers[c].join();
 }
 
 
-template <typename Base>
-Base SegmentTree<Base>::QueryRecursive(
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::QueryRecursive(
         std::size_t l_qbound, 
         std::size_t r_qbound, 
         std::size_t l_index, 
         std::size_t r_index, 
-        std::size_t tree_index
+        std::size_t tree_index,
+        std::size_t *nodes,
+        std::size_t &count
 )
 {
     if (l_qbound <= l_index && r_index <= r_qbound)
     {
         // The current subtree of the segment tree
         // appears completely inside the range of the query. So the total
-        // value stored at the root node of the subtree is returned.
-        return tree_[tree_index];
+        // value stored at the root node of the subtree is part of the answer.
+        nodes[count++] = NodePosition(tree_index);
+        return;
     }
 
     std::size_t boundary = (l_index + r_index) >> 1;
-    std::size_t next_tree_index = (tree_index << 1) + 1;
+    std::size_t next_tree_index = LeftChild(tree_index);
+    std::size_t r_tree_index = RightChild(tree_index, l_index, boundary);
 
     if (r_qbound <= boundary)
     {
         // The current query range lies completely in the left subtree, so
-        // the query is returned from the left subtree.
-        return QueryRecursive(l_qbound, r_qbound, l_index, boundary, next_tree_index);
+        // the query is answered from the left subtree.
+        QueryRecursive(l_qbound, r_qbound, l_index, boundary, next_tree_index, nodes, count);
     }
     else if (l_qbound > boundary)
     {
         // The current query range lies completely in the right subtree, so
-        // the query is returned from the right subtree.
-        return QueryRecursive(l_qbound, r_qbound, boundary + 1, r_index, next_tree_index + 1);
+        // the query is answered from the right subtree.
+        QueryRecursive(l_qbound, r_qbound, boundary + 1, r_index, r_tree_index, nodes, count);
     }
     else
     {
         // The query range intersects both children of the current root node,
-        // so the query is sent across to both sub-trees and the result is combined.
-        Base l_query = QueryRecursive(l_qbound, boundary, l_index, boundary, next_tree_index);
-        Base r_query = QueryRecursive(boundary + 1, r_qbound, boundary + 1, r_index, next_tree_index + 1);
-        return bin_func_(l_query, r_query);
+        // so the query is sent across to both sub-trees, left first.
+        QueryRecursive(l_qbound, boundary, l_index, boundary, next_tree_index, nodes, count);
+        QueryRecursive(boundary + 1, r_qbound, boundary + 1, r_index, r_tree_index, nodes, count);
     }
 }
 
 
-template <typename Base>
-Base SegmentTree<Base>::QueryIterative(
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::FoldNodes(
+            std::size_t const   *nodes,
+            std::size_t         count,
+            Base                &result
+)
+{
+    result = tree_[nodes[0]];
+    for (std::size_t k = 1; k < count; k++)
+        Accumulate(result, tree_[nodes[k]]);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+Base SegmentTree<Base, Op, Alloc>::QueryIterative(
             std::size_t &l_qbound, 
             std::size_t &r_qbound
 )
@@ -224,12 +708,39 @@ Base SegmentTree<Base>::QueryIterative(
     // setting OPEN right bound
     r_qbound += 1;
 
-    // User Base type has to be initialized with default value
-    // in the default constructor for usage in iterative code.
-    Base l_query{};
-    Base r_query{};
+    Base run;
+    if (r_qbound - l_qbound <= kSimdRun
+        && SimdKernel<Base, Op>::Reduce(tree_, l_qbound + capacity_, r_qbound - l_qbound, run))
+    {
+        // A short range is cheaper to fold straight from its
+        // contiguous leaves than to climb the tree for.
+        return run;
+    }
+
+    // The result starts from the identity of the operation, which
+    // is `Base{}` unless the Op policy declares its own.
+    Base l_query = Identity();
+    bool seeded = true;
+    QueryNodesIterative(l_qbound + capacity_, r_qbound + capacity_, l_query, seeded);
+
+    // returning the query solution
+    return l_query;
+}
 
-    std::size_t l_ind = l_qbound + len_, r_ind = r_qbound + len_;
+
+template <typename Base, typename Op, typename Alloc>
+inline void SegmentTree<Base, Op, Alloc>::QueryNodesIterative(
+            std::size_t l_ind,
+            std::size_t r_ind,
+            Base        &l_query,
+            bool        &seeded
+)
+{
+    // Nodes on the right side are met from right to left, so they are
+    // kept, at most one per level, and added after the left side. Every
+    // node is then accumulated into l_query, never prepended to a value.
+    std::size_t r_nodes[kMaxDepth];
+    std::size_t r_count = 0;
 
     while (l_ind < r_ind)
     {
@@ -237,7 +748,7 @@ Base SegmentTree<Base>::QueryIterative(
         {
             // l_ind is an odd index so its subtree is included
             // in the range.
-            l_query = bin_func_(l_query, tree_[l_ind]);
+            AccumulateSeeded(l_query, seeded, tree_[l_ind]);
             l_ind += 1;
         }
         if (r_ind & 1)
@@ -245,7 +756,7 @@ Base SegmentTree<Base>::QueryIterative(
             // r_ind (open end) is odd, so its subtree is not
             // included, however, r_ind - 1 subtree is.
             r_ind -= 1;
-            r_query = bin_func_(tree_[r_ind], r_query);
+            r_nodes[r_count++] = r_ind;
         }
         
         // Moving l_ind, r_ind to their respective
@@ -254,14 +765,120 @@ Base SegmentTree<Base>::QueryIterative(
         r_ind >>= 1;
     }
 
-    // returning the query solution
-    return bin_func_(l_query, r_query);
+    while (r_count > 0)
+        AccumulateSeeded(l_query, seeded, tree_[r_nodes[--r_count]]);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+Base SegmentTree<Base, Op, Alloc>::QueryBlocked(
+            std::size_t l_qbound,
+            std::size_t r_qbound
+)
+{
+    std::size_t leaves = 2 * capacity_;
+
+    // Whole blocks of the range are [l_block, r_block), with an OPEN
+    // right bound. A range without one spans at most two blocks, and
+    // is folded straight from its leaves.
+    std::size_t l_block = (l_qbound + kBlockSize - 1) / kBlockSize;
+    std::size_t r_block = (r_qbound + 1) / kBlockSize;
+
+    if (l_block >= r_block)
+        return FoldWide(leaves + l_qbound, leaves + r_qbound + 1);
+
+    // The result starts from the left partial block, or else from
+    // the first block node, rather than from an identity.
+    Base l_query;
+    bool seeded = false;
+
+    if (l_qbound < l_block * kBlockSize)
+    {
+        l_query = FoldWide(leaves + l_qbound, leaves + l_block * kBlockSize);
+        seeded = true;
+    }
+
+    QueryNodesIterative(l_block + capacity_, r_block + capacity_, l_query, seeded);
+
+    if (r_block * kBlockSize <= r_qbound)
+    {
+        Base run = FoldWide(leaves + r_block * kBlockSize, leaves + r_qbound + 1);
+        Accumulate(l_query, run);
+    }
+
+    return l_query;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::QueryBatchIterative(
+            std::vector<std::pair<std::size_t, std::size_t> > const &ranges,
+            std::vector<Base>                                       &results
+)
+{
+    // tree_[0] is never used by the iterative layout, so it is set
+    // to the identity and read in place of nodes outside a range.
+    // Save stores it that way, for read-only mapped trees.
+    if (tree_.Writable())
+        tree_[0] = Identity();
+
+    std::size_t l_ind[kBatchGroup], r_ind[kBatchGroup];
+    std::size_t r_nodes[kBatchGroup][kMaxDepth];
+
+    for (std::size_t first = 0; first < ranges.size(); first += kBatchGroup)
+    {
+        std::size_t count = std::min(kBatchGroup, ranges.size() - first);
+
+        for (std::size_t j = 0; j < count; j++)
+        {
+            // Same bounds as QueryIterative, with an OPEN right bound
+            l_ind[j] = ranges[first + j].first + capacity_;
+            r_ind[j] = ranges[first + j].second + 1 + capacity_;
+            results[first + j] = tree_[0];
+        }
+
+        bool active = true;
+        std::size_t depth = 0;
+
+        for (; active; depth++)
+        {
+            // Every query of the group climbs one level per pass. Both
+            // boundary nodes are always combined, with tree_[0] standing
+            // in for a node outside the range, so the loop has no data
+            // dependent branches and the loads of the whole group can
+            // be in flight together. As in QueryIterative, right side
+            // nodes are kept and added once the left side is done.
+            active = false;
+
+            for (std::size_t j = 0; j < count; j++)
+            {
+                bool live = l_ind[j] < r_ind[j];
+                std::size_t take_l = live & l_ind[j];
+                std::size_t take_r = live & r_ind[j];
+
+                Accumulate(results[first + j], tree_[take_l ? l_ind[j] : 0]);
+                r_nodes[j][depth] = take_r ? r_ind[j] - 1 : 0;
+
+                // Once finished, l_ind stays at or above r_ind
+                l_ind[j] = (l_ind[j] + 1) >> 1;
+                r_ind[j] = r_ind[j] >> 1;
+                active = active || live;
+            }
+        }
+
+        for (std::size_t j = 0; j < count; j++)
+        {
+            for (std::size_t level = depth; level-- > 0; )
+                Accumulate(results[first + j], tree_[r_nodes[j][level]]);
+        }
+    }
 }
 
 
-template <typename Base>
-void SegmentTree<Base>::UpdateRecursive(
-            Base const          &new_value, 
+template <typename Base, typename Op, typename Alloc>
+template <typename Value>
+void SegmentTree<Base, Op, Alloc>::UpdateRecursive(
+            Value               &&new_value, 
             std::size_t const   &final_index, 
             std::size_t         l_index, 
             std::size_t         r_index, 
@@ -272,43 +889,45 @@ void SegmentTree<Base>::UpdateRecursive(
     {
         // Leaf to be updated reached and updated
         // with the new value
-        tree_[tree_index] = new_value;
+        tree_[NodePosition(tree_index)] = std::forward<Value>(new_value);
         return;
     }
 
     std::size_t boundary = (l_index + r_index) >> 1;
-    std::size_t next_tree_index = (tree_index << 1) + 1;
+    std::size_t next_tree_index = LeftChild(tree_index);
+    std::size_t r_tree_index = RightChild(tree_index, l_index, boundary);
 
     if (final_index <= boundary)
     {
         // Recursively updating on the left subtree if
         // leaf exists in that subtree.
-        UpdateRecursive(new_value, final_index, l_index, boundary, next_tree_index);
+        UpdateRecursive(std::forward<Value>(new_value), final_index, l_index, boundary, next_tree_index);
     }
     else
     {
         // Recursively updating on the right subtree if
         // leaf exists in that subtree.
-        UpdateRecursive(new_value, final_index, boundary + 1, r_index, next_tree_index + 1);
+        UpdateRecursive(std::forward<Value>(new_value), final_index, boundary + 1, r_index, r_tree_index);
     }
 
     // Updating ancestors of the leaf value updated
     // with latest values
-    tree_[tree_index] = bin_func_(tree_[next_tree_index], tree_[next_tree_index + 1]);
+    Combine(tree_[NodePosition(tree_index)], tree_[NodePosition(next_tree_index)], tree_[NodePosition(r_tree_index)]);
 }
 
 
-template <typename Base>
-void SegmentTree<Base>::UpdateIterative(
-            Base const &new_value, 
+template <typename Base, typename Op, typename Alloc>
+template <typename Value>
+void SegmentTree<Base, Op, Alloc>::UpdateIterative(
+            Value &&new_value, 
             std::size_t const &index
 )
 {
 
-    std::size_t i = index + len_;
+    std::size_t i = index + capacity_;
 
     // Updating leaf node of tree with new value
-    tree_[i] = new_value;
+    tree_[i] = std::forward<Value>(new_value);
 
     i >>= 1;
 
@@ -320,7 +939,7 @@ void SegmentTree<Base>::UpdateIterative(
         // if i is even, i^1 is odd and similar if i is odd
         // updating parent of current node (i) by merging
         // siblings stored at i<<1 and (i<<1)^1 indices in tree_ vector.
-        tree_[i] = bin_func_(tree_[i<<1], tree_[(i<<1) ^ 1]);
+        Combine(tree_[i], tree_[i<<1], tree_[(i<<1) ^ 1]);
 
         // setting i to parent of current node by diving index by 2
         i >>= 1;
@@ -328,72 +947,1500 @@ void SegmentTree<Base>::UpdateIterative(
 }
 
 
-template <typename Base>
-Base SegmentTree<Base>::Query(
-            std::size_t l_qbound, 
-            std::size_t r_qbound
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::AllocateWide()
+{
+    // tree_ holds three sections of `total` nodes: the node values,
+    // then for each node the prefix and the suffix aggregate within
+    // its group of siblings. Padding takes the identity, so it never
+    // changes a node.
+    wide_stride_ = WideLayout(len_, wide_offset_);
+    tree_.assign(3 * wide_stride_, Identity());
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t SegmentTree<Base, Op, Alloc>::WideLayout(
+            std::size_t                 len,
+            std::vector<std::size_t>    &offsets
 )
 {
-    if (l_qbound < 0 || l_qbound >= len_ || r_qbound < 0 || r_qbound >= len_)
-    {
-        // query bounds moving out of segment tree range
-        throw std::out_of_range("The indices must be within the range of the segment tree.");
-    }
-    if (l_qbound > r_qbound)
+    // Level 0 holds the leaves from index 0. Every level is padded to
+    // a multiple of kWideFanout, so that each node of the level above
+    // has exactly kWideFanout children. The last level is the root.
+    std::size_t total = 0, count = len;
+
+    offsets.clear();
+    while (count > 1)
     {
-        // query left bound greater than query right bound
-        throw std::out_of_range("The left index must be smaller than the right index.");
+        std::size_t padded = (count + kWideFanout - 1) / kWideFanout * kWideFanout;
+        offsets.push_back(total);
+        total += padded;
+        count = padded / kWideFanout;
     }
+    offsets.push_back(total);
 
-    if (type_ == true)
-        // Querying recursively
-        return QueryRecursive(l_qbound, r_qbound, 0, len_ - 1, 0);
-    else
-        // Querying iteratively
-        return QueryIterative(l_qbound, r_qbound);
+    return total + 1;
 }
 
-template <typename Base>
-void SegmentTree<Base>::Update(
-            Base const &new_value, 
-            std::size_t const &index
-)
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::BuildTreeWide()
 {
-    if (index < 0 || index > len_)
+    for (std::size_t level = 0; level + 1 < wide_offset_.size(); level++)
     {
-        // update node out of segment tree range
-        throw std::out_of_range("The index must be within the range of the segment tree.");
+        std::size_t groups = (wide_offset_[level + 1] - wide_offset_[level]) / kWideFanout;
+        for (std::size_t group = 0; group < groups; group++)
+            RecomputeWide(level, group, 0, kWideFanout - 1);
     }
-
-    if (type_ == true)
-        // Recursive updating
-        UpdateRecursive(new_value, index, 0, len_ - 1, 0);
-    else
-        // Iterative updating
-        UpdateIterative(new_value, index);
 }
 
 
-template <typename Base>
-size_t SegmentTree<Base>::GetTreeSize(
-            size_t const &len
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::RecomputeWide(
+            std::size_t level,
+            std::size_t group,
+            std::size_t first_child,
+            std::size_t last_child
 )
 {
-    if (len == 0)
+    std::size_t begin = wide_offset_[level] + group * kWideFanout;
+    std::size_t prefix = begin + wide_stride_, suffix = begin + 2 * wide_stride_;
+
+    // Prefixes before first_child and suffixes after last_child
+    // do not depend on the changed children.
+    if (first_child == 0)
+    {
+        tree_[prefix] = tree_[begin];
+        first_child = 1;
+    }
+    for (std::size_t c = first_child; c < kWideFanout; c++)
+        Combine(tree_[prefix + c], tree_[prefix + c - 1], tree_[begin + c]);
+
+    if (last_child == kWideFanout - 1)
+    {
+        tree_[suffix + last_child] = tree_[begin + last_child];
+        last_child -= 1;
+    }
+    for (std::size_t c = last_child + 1; c-- > 0; )
+        Combine(tree_[suffix + c], tree_[begin + c], tree_[suffix + c + 1]);
+
+    // The parent is the prefix of the whole group
+    tree_[wide_offset_[level + 1] + group] = tree_[prefix + kWideFanout - 1];
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+Base SegmentTree<Base, Op, Alloc>::FoldWide(
+            std::size_t first,
+            std::size_t last
+)
+{
+    Base result;
+    if (SimdKernel<Base, Op>::Reduce(tree_, first, last - first, result))
+        return result;
+
+    result = tree_[first];
+    for (std::size_t i = first + 1; i < last; i++)
+        Accumulate(result, tree_[i]);
+
+    return result;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+Base SegmentTree<Base, Op, Alloc>::QueryWide(
+            std::size_t l_qbound,
+            std::size_t r_qbound
+)
+{
+    // The result starts from the first node met, not an identity,
+    // which a lambda cannot declare.
+    Base l_query;
+    bool seeded = false;
+
+    // Right side prefixes are kept and added last, as in QueryIterative
+    std::size_t r_nodes[kMaxDepth];
+    std::size_t r_count = 0;
+
+    // [lo, hi) are positions on the current level, with an OPEN right bound
+    std::size_t lo = l_qbound, hi = r_qbound + 1;
+
+    for (std::size_t level = 0; lo < hi; level++)
+    {
+        std::size_t offset = wide_offset_[level];
+
+        if (lo / kWideFanout == (hi - 1) / kWideFanout)
+        {
+            // Remaining range within one group of siblings. A prefix or
+            // a suffix answers it if it touches an end of the group,
+            // else the few nodes are combined directly.
+            // A single node, such as the root, is read directly.
+            if (hi - lo == 1)
+                AccumulateSeeded(l_query, seeded, tree_[offset + lo]);
+            else if (lo % kWideFanout == 0)
+                AccumulateSeeded(l_query, seeded, tree_[offset + hi - 1 + wide_stride_]);
+            else if (hi % kWideFanout == 0)
+                AccumulateSeeded(l_query, seeded, tree_[offset + lo + 2 * wide_stride_]);
+            else
+            {
+                Base run = FoldWide(offset + lo, offset + hi);
+                AccumulateSeeded(l_query, seeded, run);
+            }
+            break;
+        }
+
+        if (lo % kWideFanout != 0)
+        {
+            // Left partial group: suffix of its siblings from lo
+            AccumulateSeeded(l_query, seeded, tree_[offset + lo + 2 * wide_stride_]);
+            lo = (lo / kWideFanout + 1) * kWideFanout;
+        }
+        if (hi % kWideFanout != 0)
+        {
+            // Right partial group: prefix of its siblings up to hi - 1
+            r_nodes[r_count++] = offset + hi - 1 + wide_stride_;
+            hi = hi / kWideFanout * kWideFanout;
+        }
+
+        // What is left is made of whole groups of siblings,
+        // which are the nodes [lo, hi) of the level above.
+        lo /= kWideFanout;
+        hi /= kWideFanout;
+    }
+
+    while (r_count > 0)
+        AccumulateSeeded(l_query, seeded, tree_[r_nodes[--r_count]]);
+
+    return l_query;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Value>
+void SegmentTree<Base, Op, Alloc>::UpdateWide(
+            Value               &&new_value,
+            std::size_t const   &index
+)
+{
+    std::size_t i = index;
+
+    // Updating leaf node of tree with new value
+    tree_[i] = std::forward<Value>(new_value);
+
+    for (std::size_t level = 0; level + 1 < wide_offset_.size(); level++)
+    {
+        // Refreshing the aggregates of the siblings of i, which
+        // also recomputes the parent of i
+        RecomputeWide(level, i / kWideFanout, i % kWideFanout, i % kWideFanout);
+        i /= kWideFanout;
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::AllocateBlocked()
+{
+    capacity_ = (len_ + kBlockSize - 1) / kBlockSize;
+    tree_.resize(2 * capacity_ + len_);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::BuildTreeBlocked(
+            std::size_t threads
+)
+{
+    ParallelFor(0, capacity_, threads, [this](std::size_t first, std::size_t last)
+    {
+        for (std::size_t block = first; block < last; block++)
+            RecomputeBlock(block);
+    });
+
+    // The block aggregates are the leaves of an iterative tree
+    BuildInternalIterative(threads);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::RecomputeBlock(
+            std::size_t block
+)
+{
+    std::size_t first = 2 * capacity_ + block * kBlockSize;
+    std::size_t last = 2 * capacity_ + std::min(len_, (block + 1) * kBlockSize);
+
+    tree_[capacity_ + block] = FoldWide(first, last);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Value>
+void SegmentTree<Base, Op, Alloc>::UpdateBlocked(
+            Value               &&new_value,
+            std::size_t const   &index
+)
+{
+    // Updating leaf node of tree with new value
+    tree_[2 * capacity_ + index] = std::forward<Value>(new_value);
+
+    std::size_t i = index / kBlockSize;
+    RecomputeBlock(i);
+
+    // Then the ancestors of its block, as in UpdateIterative
+    for (i = (i + capacity_) >> 1; i != 0; i >>= 1)
+        Combine(tree_[i], tree_[i << 1], tree_[(i << 1) | 1]);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+Base SegmentTree<Base, Op, Alloc>::Query(
+            std::size_t l_qbound, 
+            std::size_t r_qbound
+)
+{
+    if (l_qbound < 0 || l_qbound >= len_ || r_qbound < 0 || r_qbound >= len_)
+    {
+        // query bounds moving out of segment tree range
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+    if (l_qbound > r_qbound)
+    {
+        // query left bound greater than query right bound
+        throw std::out_of_range("The left index must be smaller than the right index.");
+    }
+
+    if (IsRecursive())
+    {
+        // Querying recursively, for the nodes covering the range,
+        // which are then combined from left to right
+        std::size_t nodes[2 * kMaxDepth], count = 0;
+        QueryRecursive(l_qbound, r_qbound, 0, len_ - 1, 0, nodes, count);
+
+        Base result;
+        FoldNodes(nodes, count, result);
+        return result;
+    }
+    else if (type_ == TREE_WIDE)
+        // Querying the wide nodes level by level
+        return QueryWide(l_qbound, r_qbound);
+    else if (type_ == TREE_BLOCKED)
+        // Querying the edge blocks leaf by leaf, and the block tree
+        return QueryBlocked(l_qbound, r_qbound);
+    else
+        // Querying iteratively
+        return QueryIterative(l_qbound, r_qbound);
+}
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::QueryBatch(
+            std::vector<std::pair<std::size_t, std::size_t> > const &ranges,
+            std::vector<Base>                                       &results
+)
+{
+    for (std::size_t q = 0; q < ranges.size(); q++)
+    {
+        // The whole batch is validated before anything is computed
+        if (ranges[q].first >= len_ || ranges[q].second >= len_)
+        {
+            throw std::out_of_range("The indices must be within the range of the segment tree.");
+        }
+        if (ranges[q].first > ranges[q].second)
+        {
+            throw std::out_of_range("The left index must be smaller than the right index.");
+        }
+    }
+
+    results.resize(ranges.size());
+
+    if (IsRecursive())
+    {
+        std::size_t nodes[2 * kMaxDepth];
+        for (std::size_t q = 0; q < ranges.size(); q++)
+        {
+            std::size_t count = 0;
+            QueryRecursive(ranges[q].first, ranges[q].second, 0, len_ - 1, 0, nodes, count);
+            FoldNodes(nodes, count, results[q]);
+        }
+    }
+    else if (type_ == TREE_WIDE)
+    {
+        // Queries on the wide tree already read contiguous runs, they
+        // are answered one after the other.
+        for (std::size_t q = 0; q < ranges.size(); q++)
+            results[q] = QueryWide(ranges[q].first, ranges[q].second);
+    }
+    else if (type_ == TREE_BLOCKED)
+    {
+        // Most of the work of a blocked query is in the contiguous
+        // leaves of its end blocks, so they are also answered in turn.
+        for (std::size_t q = 0; q < ranges.size(); q++)
+            results[q] = QueryBlocked(ranges[q].first, ranges[q].second);
+    }
+    else
+    {
+        QueryBatchIterative(ranges, results);
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindFirst(
+            std::size_t l_index,
+            Pred        pred
+)
+{
+    if (l_index >= len_)
+    {
+        // search bound moving out of segment tree range
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+
+    if (IsRecursive())
+    {
+        Base acc;
+        bool empty = true;
+        return FindFirstRecursive(l_index, pred, 0, len_ - 1, 0, acc, empty);
+    }
+    else if (type_ == TREE_WIDE)
+        return FindFirstWide(l_index, pred);
+    else if (type_ == TREE_BLOCKED)
+        return FindFirstBlocked(l_index, pred);
+    else
+        return FindFirstIterative(l_index, pred);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindLast(
+            std::size_t r_index,
+            Pred        pred
+)
+{
+    if (r_index >= len_)
+    {
+        // search bound moving out of segment tree range
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+
+    if (IsRecursive())
+    {
+        Base acc;
+        bool empty = true;
+        return FindLastRecursive(r_index, pred, 0, len_ - 1, 0, acc, empty);
+    }
+    else if (type_ == TREE_WIDE)
+        return FindLastWide(r_index, pred);
+    else if (type_ == TREE_BLOCKED)
+        return FindLastBlocked(r_index, pred);
+    else
+        return FindLastIterative(r_index, pred);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t SegmentTree<Base, Op, Alloc>::PrefixLowerBound(
+            Base const &value
+)
+{
+    return FindFirst(0, [&value](Base const &prefix) { return !(prefix < value); });
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindFirstRecursive(
+            std::size_t l_bound,
+            Pred        &pred,
+            std::size_t l_index,
+            std::size_t r_index,
+            std::size_t tree_index,
+            Base        &acc,
+            bool        &empty
+)
+{
+    if (r_index < l_bound)
+    {
+        // The subtree lies completely before the searched ranges
+        return len_;
+    }
+
+    if (l_bound <= l_index)
+    {
+        // The subtree lies completely inside the searched ranges. If
+        // pred stays false with it, it is skipped as a whole.
+        Base probe;
+        if (empty)
+            probe = tree_[NodePosition(tree_index)];
+        else
+            Combine(probe, acc, tree_[NodePosition(tree_index)]);
+
+        if (!pred(probe))
+        {
+            std::swap(acc, probe);
+            empty = false;
+            return len_;
+        }
+        if (l_index == r_index)
+            return l_index;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t next_tree_index = LeftChild(tree_index);
+    std::size_t r_tree_index = RightChild(tree_index, l_index, boundary);
+
+    std::size_t found = FindFirstRecursive(l_bound, pred, l_index, boundary, next_tree_index, acc, empty);
+    if (found != len_)
+        return found;
+
+    return FindFirstRecursive(l_bound, pred, boundary + 1, r_index, r_tree_index, acc, empty);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindLastRecursive(
+            std::size_t r_bound,
+            Pred        &pred,
+            std::size_t l_index,
+            std::size_t r_index,
+            std::size_t tree_index,
+            Base        &acc,
+            bool        &empty
+)
+{
+    if (l_index > r_bound)
+    {
+        // The subtree lies completely after the searched ranges
+        return len_;
+    }
+
+    if (r_index <= r_bound)
+    {
+        // The subtree lies completely inside the searched ranges. If
+        // pred stays false with it, it is skipped as a whole.
+        Base probe;
+        if (empty)
+            probe = tree_[NodePosition(tree_index)];
+        else
+            Combine(probe, tree_[NodePosition(tree_index)], acc);
+
+        if (!pred(probe))
+        {
+            std::swap(acc, probe);
+            empty = false;
+            return len_;
+        }
+        if (l_index == r_index)
+            return l_index;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t next_tree_index = LeftChild(tree_index);
+    std::size_t r_tree_index = RightChild(tree_index, l_index, boundary);
+
+    std::size_t found = FindLastRecursive(r_bound, pred, boundary + 1, r_index, r_tree_index, acc, empty);
+    if (found != len_)
+        return found;
+
+    return FindLastRecursive(r_bound, pred, l_index, boundary, next_tree_index, acc, empty);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindFirstIterative(
+            std::size_t l_bound,
+            Pred        &pred
+)
+{
+    Base acc = Identity();
+    std::size_t i = FindFirstNodes(l_bound + capacity_, len_ + capacity_, pred, acc);
+
+    return i == 0 ? len_ : i - capacity_;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindFirstNodes(
+            std::size_t l_ind,
+            std::size_t r_ind,
+            Pred        &pred,
+            Base        &acc
+)
+{
+    // Nodes making up [l_ind, r_ind), as in QueryIterative: those of
+    // the left side in order, then those of the right side reversed.
+    std::size_t nodes[2 * kMaxDepth], r_nodes[kMaxDepth];
+    std::size_t count = 0, r_count = 0;
+
+    for (; l_ind < r_ind; l_ind >>= 1, r_ind >>= 1)
+    {
+        if (l_ind & 1)
+            nodes[count++] = l_ind++;
+        if (r_ind & 1)
+            r_nodes[r_count++] = --r_ind;
+    }
+    while (r_count > 0)
+        nodes[count++] = r_nodes[--r_count];
+
+    Base probe;
+
+    for (std::size_t k = 0; k < count; k++)
+    {
+        std::size_t i = nodes[k];
+
+        Combine(probe, acc, tree_[i]);
+        if (!pred(probe))
+        {
+            std::swap(acc, probe);
+            continue;
+        }
+
+        // pred turns true inside node i. Every node below it lies in
+        // the range, so it is descended to a leaf, going right only
+        // when the left child keeps pred false.
+        while (i < capacity_)
+        {
+            i <<= 1;
+            Combine(probe, acc, tree_[i]);
+            if (!pred(probe))
+            {
+                std::swap(acc, probe);
+                i |= 1;
+            }
+        }
+        return i;
+    }
+
+    return 0;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindLastIterative(
+            std::size_t r_bound,
+            Pred        &pred
+)
+{
+    Base acc = Identity();
+    std::size_t i = FindLastNodes(capacity_, r_bound + 1 + capacity_, pred, acc);
+
+    return i == 0 ? len_ : i - capacity_;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindLastNodes(
+            std::size_t l_ind,
+            std::size_t r_ind,
+            Pred        &pred,
+            Base        &acc
+)
+{
+    // Nodes making up [l_ind, r_ind) from right to left: those of the
+    // right side in order, then those of the left side reversed.
+    std::size_t nodes[2 * kMaxDepth], l_nodes[kMaxDepth];
+    std::size_t count = 0, l_count = 0;
+
+    for (; l_ind < r_ind; l_ind >>= 1, r_ind >>= 1)
+    {
+        if (l_ind & 1)
+            l_nodes[l_count++] = l_ind++;
+        if (r_ind & 1)
+            nodes[count++] = --r_ind;
+    }
+    while (l_count > 0)
+        nodes[count++] = l_nodes[--l_count];
+
+    Base probe;
+
+    for (std::size_t k = 0; k < count; k++)
+    {
+        std::size_t i = nodes[k];
+
+        Combine(probe, tree_[i], acc);
+        if (!pred(probe))
+        {
+            std::swap(acc, probe);
+            continue;
+        }
+
+        // Descending as in FindFirstIterative, right child first
+        while (i < capacity_)
+        {
+            i = (i << 1) | 1;
+            Combine(probe, tree_[i], acc);
+            if (!pred(probe))
+            {
+                std::swap(acc, probe);
+                i ^= 1;
+            }
+        }
+        return i;
+    }
+
+    return 0;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindFirstBlocked(
+            std::size_t l_bound,
+            Pred        &pred
+)
+{
+    std::size_t leaves = 2 * capacity_;
+    std::size_t block = l_bound / kBlockSize;
+    Base acc = Identity(), probe;
+
+    if (l_bound % kBlockSize != 0)
+    {
+        // The partial block the range starts in, leaf by leaf
+        std::size_t last = std::min(len_, (block + 1) * kBlockSize);
+        for (std::size_t i = l_bound; i < last; i++)
+        {
+            Combine(probe, acc, tree_[leaves + i]);
+            if (pred(probe))
+                return i;
+            std::swap(acc, probe);
+        }
+        block += 1;
+    }
+
+    std::size_t node = FindFirstNodes(block + capacity_, 2 * capacity_, pred, acc);
+    if (node == 0)
+        return len_;
+
+    // pred turns true inside this block, at one of its leaves
+    block = node - capacity_;
+    std::size_t last = std::min(len_, (block + 1) * kBlockSize);
+    for (std::size_t i = block * kBlockSize; i < last; i++)
+    {
+        Combine(probe, acc, tree_[leaves + i]);
+        if (pred(probe))
+            return i;
+        std::swap(acc, probe);
+    }
+
+    return len_;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindLastBlocked(
+            std::size_t r_bound,
+            Pred        &pred
+)
+{
+    std::size_t leaves = 2 * capacity_;
+    std::size_t block = r_bound / kBlockSize;
+    Base acc = Identity(), probe;
+
+    if (r_bound + 1 != std::min(len_, (block + 1) * kBlockSize))
+    {
+        // The partial block the range ends in, leaf by leaf
+        for (std::size_t i = r_bound + 1; i-- > block * kBlockSize; )
+        {
+            Combine(probe, tree_[leaves + i], acc);
+            if (pred(probe))
+                return i;
+            std::swap(acc, probe);
+        }
+    }
+    else
+    {
+        block += 1;
+    }
+
+    std::size_t node = FindLastNodes(capacity_, block + capacity_, pred, acc);
+    if (node == 0)
+        return len_;
+
+    block = node - capacity_;
+    std::size_t last = std::min(len_, (block + 1) * kBlockSize);
+    for (std::size_t i = last; i-- > block * kBlockSize; )
+    {
+        Combine(probe, tree_[leaves + i], acc);
+        if (pred(probe))
+            return i;
+        std::swap(acc, probe);
+    }
+
+    return len_;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindFirstWide(
+            std::size_t l_bound,
+            Pred        &pred
+)
+{
+    Base acc = Identity(), probe;
+    std::size_t level = 0, p = l_bound, top = wide_offset_.size() - 1;
+
+    while (level < top)
+    {
+        if (p >= wide_offset_[level + 1] - wide_offset_[level])
+            return len_;
+
+        // The siblings of p from p on, through their suffix aggregate
+        Combine(probe, acc, tree_[wide_offset_[level] + p + 2 * wide_stride_]);
+        if (pred(probe))
+            break;
+
+        // Skipped, so the search goes on from the next group, which
+        // is the node after the parent of p on the level above.
+        std::swap(acc, probe);
+        p = p / kWideFanout + 1;
+        level++;
+    }
+
+    if (level == top)
+    {
+        // Past the root, every leaf from l_bound on was skipped. The
+        // root is only reached at p == 0 when it is the single leaf.
+        if (p != 0)
+            return len_;
+        Combine(probe, acc, tree_[wide_offset_[level]]);
+        return pred(probe) ? 0 : len_;
+    }
+
+    // pred turns true at a node from p on, within its group of
+    // siblings. That node is found, then its children, down to the
+    // leaves.
+    while (true)
+    {
+        Combine(probe, acc, tree_[wide_offset_[level] + p]);
+        if (pred(probe))
+        {
+            if (level == 0)
+                return p;
+            level--;
+            p *= kWideFanout;
+        }
+        else
+        {
+            std::swap(acc, probe);
+            p++;
+        }
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Pred>
+std::size_t SegmentTree<Base, Op, Alloc>::FindLastWide(
+            std::size_t r_bound,
+            Pred        &pred
+)
+{
+    Base acc = Identity(), probe;
+    std::size_t level = 0, p = r_bound, top = wide_offset_.size() - 1;
+
+    while (level < top)
+    {
+        // The siblings of p up to p, through their prefix aggregate
+        Combine(probe, tree_[wide_offset_[level] + p + wide_stride_], acc);
+        if (pred(probe))
+            break;
+
+        // Skipped, so the search goes on from the previous group, if
+        // there is one, which is the node before the parent of p.
+        std::swap(acc, probe);
+        if (p < kWideFanout)
+            return len_;
+        p = p / kWideFanout - 1;
+        level++;
+    }
+
+    if (level == top)
+    {
+        // Only reached when the root is the single leaf
+        Combine(probe, tree_[wide_offset_[level]], acc);
+        return pred(probe) ? 0 : len_;
+    }
+
+    // As in FindFirstWide, from the right
+    while (true)
+    {
+        Combine(probe, tree_[wide_offset_[level] + p], acc);
+        if (pred(probe))
+        {
+            if (level == 0)
+                return p;
+            level--;
+            p = p * kWideFanout + kWideFanout - 1;
+        }
+        else
+        {
+            std::swap(acc, probe);
+            p--;
+        }
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::Update(
+            Base const &new_value, 
+            std::size_t const &index
+)
+{
+    UpdateValue(new_value, index);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::Update(
+            Base &&new_value, 
+            std::size_t const &index
+)
+{
+    UpdateValue(std::move(new_value), index);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Value>
+void SegmentTree<Base, Op, Alloc>::UpdateValue(
+            Value &&new_value, 
+            std::size_t const &index
+)
+{
+    if (index >= len_)
+    {
+        // update node out of segment tree range
+        throw std::out_of_range("The index must be within the range of the segment tree.");
+    }
+    CheckWritable();
+
+    if (IsRecursive())
+        // Recursive updating
+        UpdateRecursive(std::forward<Value>(new_value), index, 0, len_ - 1, 0);
+    else if (type_ == TREE_WIDE)
+        // Updating the wide nodes on the path to the root
+        UpdateWide(std::forward<Value>(new_value), index);
+    else if (type_ == TREE_BLOCKED)
+        // Updating the block of the leaf and the path to the root
+        UpdateBlocked(std::forward<Value>(new_value), index);
+    else
+        // Iterative updating
+        UpdateIterative(std::forward<Value>(new_value), index);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::UpdateBatchRecursive(
+            std::vector<std::size_t> const  &indices,
+            std::vector<Base> const         &values,
+            std::vector<std::size_t> const  &order,
+            std::size_t                     lo,
+            std::size_t                     hi,
+            std::size_t                     l_index,
+            std::size_t                     r_index,
+            std::size_t                     tree_index
+)
+{
+    if (l_index == r_index)
+    {
+        // All of [lo, hi) write this leaf. The order is stable, so
+        // the last one is the latest value given.
+        tree_[NodePosition(tree_index)] = values[order[hi - 1]];
+        return;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t next_tree_index = LeftChild(tree_index);
+    std::size_t r_tree_index = RightChild(tree_index, l_index, boundary);
+
+    // First position of order whose leaf lies in the right subtree
+    std::size_t mid = lo;
+    while (mid < hi && indices[order[mid]] <= boundary)
+        mid++;
+
+    if (lo < mid)
+        UpdateBatchRecursive(indices, values, order, lo, mid, l_index, boundary, next_tree_index);
+    if (mid < hi)
+        UpdateBatchRecursive(indices, values, order, mid, hi, boundary + 1, r_index, r_tree_index);
+
+    // Recomputed once, after both subtrees are up to date
+    Combine(tree_[NodePosition(tree_index)], tree_[NodePosition(next_tree_index)], tree_[NodePosition(r_tree_index)]);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename ForwardIt>
+void SegmentTree<Base, Op, Alloc>::AssignRecursive(
+            std::size_t first_index,
+            std::size_t last_index,
+            ForwardIt   &it,
+            std::size_t l_index,
+            std::size_t r_index,
+            std::size_t tree_index
+)
+{
+    if (l_index == r_index)
+    {
+        // Leaves are reached from left to right, so they are
+        // written in the order of the input.
+        tree_[NodePosition(tree_index)] = *it;
+        ++it;
+        return;
+    }
+
+    std::size_t boundary = (l_index + r_index) >> 1;
+    std::size_t next_tree_index = LeftChild(tree_index);
+    std::size_t r_tree_index = RightChild(tree_index, l_index, boundary);
+
+    if (first_index <= boundary)
+        AssignRecursive(first_index, last_index, it, l_index, boundary, next_tree_index);
+    if (last_index > boundary)
+        AssignRecursive(first_index, last_index, it, boundary + 1, r_index, r_tree_index);
+
+    Combine(tree_[NodePosition(tree_index)], tree_[NodePosition(next_tree_index)], tree_[NodePosition(r_tree_index)]);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::RecomputeIterative(
+            std::vector<std::size_t> &dirty
+)
+{
+    while (!dirty.empty())
+    {
+        std::size_t next = 0;
+
+        for (std::size_t k = 0; k < dirty.size(); k++)
+        {
+            std::size_t i = dirty[k];
+
+            Combine(tree_[i], tree_[i << 1], tree_[(i << 1) | 1]);
+
+            // Parents of a sorted level are sorted too, so repeated
+            // parents are neighbours and only kept once. The root has
+            // no parent.
+            std::size_t parent = i >> 1;
+            if (parent != 0 && (next == 0 || dirty[next - 1] != parent))
+                dirty[next++] = parent;
+        }
+
+        // When len_ is not a power of two, leaves sit at two depths and
+        // a node can come up again in a later round. It is then simply
+        // recomputed after its last child, which keeps it correct.
+        dirty.resize(next);
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::UpdateBatch(
+            std::vector<std::size_t> const  &indices,
+            std::vector<Base> const         &values
+)
+{
+    CheckWritable();
+
+    if (indices.size() != values.size())
+    {
+        throw std::invalid_argument("Every index must have exactly one value.");
+    }
+    for (std::size_t k = 0; k < indices.size(); k++)
+    {
+        // The whole batch is validated before anything is written
+        if (indices[k] >= len_)
+        {
+            throw std::out_of_range("The index must be within the range of the segment tree.");
+        }
+    }
+    if (indices.empty())
+        return;
+
+    if (IsRecursive())
+    {
+        std::vector<std::size_t> order(indices.size());
+        for (std::size_t k = 0; k < order.size(); k++)
+            order[k] = k;
+
+        std::stable_sort(order.begin(), order.end(),
+                         [&indices](std::size_t a, std::size_t b) { return indices[a] < indices[b]; });
+
+        UpdateBatchRecursive(indices, values, order, 0, order.size(), 0, len_ - 1, 0);
+    }
+    else if (type_ == TREE_WIDE)
+    {
+        std::vector<std::size_t> dirty;
+        dirty.reserve(indices.size());
+
+        for (std::size_t k = 0; k < indices.size(); k++)
+        {
+            // Written in input order, so the last value of a
+            // repeated index wins.
+            tree_[indices[k]] = values[k];
+            dirty.push_back(indices[k]);
+        }
+
+        std::sort(dirty.begin(), dirty.end());
+
+        for (std::size_t level = 0; level + 1 < wide_offset_.size(); level++)
+        {
+            // Groups of a sorted level are sorted too, so repeated
+            // groups are neighbours and only recomputed once.
+            std::size_t next = 0;
+
+            for (std::size_t k = 0; k < dirty.size(); k++)
+            {
+                std::size_t group = dirty[k] / kWideFanout;
+                if (next == 0 || dirty[next - 1] != group)
+                {
+                    RecomputeWide(level, group, 0, kWideFanout - 1);
+                    dirty[next++] = group;
+                }
+            }
+
+            dirty.resize(next);
+        }
+    }
+    else if (type_ == TREE_BLOCKED)
+    {
+        std::vector<std::size_t> dirty;
+        dirty.reserve(indices.size());
+
+        for (std::size_t k = 0; k < indices.size(); k++)
+        {
+            // Written in input order, so the last value of a
+            // repeated index wins.
+            tree_[2 * capacity_ + indices[k]] = values[k];
+            dirty.push_back(indices[k] / kBlockSize);
+        }
+
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+        // Each block written is folded once, then the parents of the
+        // blocks are recomputed as on the iterative tree.
+        std::size_t next = 0;
+        for (std::size_t k = 0; k < dirty.size(); k++)
+        {
+            RecomputeBlock(dirty[k]);
+
+            std::size_t parent = (dirty[k] + capacity_) >> 1;
+            if (parent != 0 && (next == 0 || dirty[next - 1] != parent))
+                dirty[next++] = parent;
+        }
+        dirty.resize(next);
+
+        RecomputeIterative(dirty);
+    }
+    else
+    {
+        for (std::size_t k = 0; k < indices.size(); k++)
+        {
+            // Written in input order, so the last value of a
+            // repeated index wins.
+            tree_[indices[k] + capacity_] = values[k];
+        }
+
+        if (indices.size() * 16 >= capacity_)
+        {
+            // Large batch: dirty internal nodes are flagged and swept
+            // in decreasing index order. Children always have larger
+            // indices than their parent, so each node is recomputed
+            // exactly once, after all of its children.
+            std::vector<char> dirty(capacity_, 0);
+
+            for (std::size_t k = 0; k < indices.size(); k++)
+                dirty[(indices[k] + capacity_) >> 1] = 1;
+
+            for (std::size_t i = capacity_ - 1; i > 0; i--)
+            {
+                if (dirty[i])
+                {
+                    Combine(tree_[i], tree_[i << 1], tree_[(i << 1) | 1]);
+                    dirty[i >> 1] = 1;
+                }
+            }
+        }
+        else
+        {
+            // Small batch: sorting the parents is cheaper than a
+            // sweep over all len_ internal nodes.
+            std::vector<std::size_t> dirty;
+            dirty.reserve(indices.size());
+
+            for (std::size_t k = 0; k < indices.size(); k++)
+            {
+                if (((indices[k] + capacity_) >> 1) != 0)
+                    dirty.push_back((indices[k] + capacity_) >> 1);
+            }
+
+            std::sort(dirty.begin(), dirty.end());
+            dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+            RecomputeIterative(dirty);
+        }
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename ForwardIt>
+void SegmentTree<Base, Op, Alloc>::Assign(
+            std::size_t first_index,
+            ForwardIt   begin,
+            ForwardIt   end
+)
+{
+    CheckWritable();
+
+    std::size_t count = std::distance(begin, end);
+
+    if (first_index > len_ || count > len_ - first_index)
+    {
+        // run moving out of segment tree range
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+    if (count == 0)
+        return;
+
+    std::size_t last_index = first_index + count - 1;
+
+    if (IsRecursive())
+    {
+        AssignRecursive(first_index, last_index, begin, 0, len_ - 1, 0);
+    }
+    else if (type_ == TREE_WIDE)
+    {
+        for (std::size_t i = first_index; begin != end; ++begin, ++i)
+            tree_[i] = *begin;
+
+        // Groups holding the run form one contiguous run per level
+        for (std::size_t level = 0; level + 1 < wide_offset_.size(); level++)
+        {
+            first_index /= kWideFanout;
+            last_index /= kWideFanout;
+            for (std::size_t group = first_index; group <= last_index; group++)
+                RecomputeWide(level, group, 0, kWideFanout - 1);
+        }
+    }
+    else
+    {
+        if (type_ == TREE_BLOCKED)
+        {
+            for (std::size_t i = 2 * capacity_ + first_index; begin != end; ++begin, ++i)
+                tree_[i] = *begin;
+
+            // The blocks holding the run are folded again, and the
+            // rest is the iterative tree with the blocks as leaves.
+            first_index /= kBlockSize;
+            last_index /= kBlockSize;
+            for (std::size_t block = first_index; block <= last_index; block++)
+                RecomputeBlock(block);
+        }
+        else
+        {
+            for (std::size_t i = first_index + capacity_; begin != end; ++begin, ++i)
+                tree_[i] = *begin;
+        }
+
+        // The parents of a contiguous run of nodes are a contiguous
+        // run again, so each round recomputes one range of a level.
+        std::size_t lo = (first_index + capacity_) >> 1, hi = (last_index + capacity_) >> 1;
+
+        while (hi != 0)
+        {
+            for (std::size_t i = std::max<std::size_t>(lo, 1); i <= hi; i++)
+                Combine(tree_[i], tree_[i << 1], tree_[(i << 1) | 1]);
+
+            lo >>= 1;
+            hi >>= 1;
+        }
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::PushBack(
+            Base const &new_value
+)
+{
+    PushBackValue(new_value);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::PushBack(
+            Base &&new_value
+)
+{
+    PushBackValue(std::move(new_value));
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+template <typename Value>
+void SegmentTree<Base, Op, Alloc>::PushBackValue(
+            Value &&new_value
+)
+{
+    CheckWritable();
+
+    if (type_ != TREE_ITERATIVE)
+    {
+        throw std::logic_error("Only iterative segment trees can grow.");
+    }
+
+    if (len_ == capacity_)
+        Grow();
+
+    // The new leaf replaces an identity padding leaf, so only its
+    // ancestors change, as in UpdateIterative.
+    std::size_t i = capacity_ + len_;
+    tree_[i] = std::forward<Value>(new_value);
+    len_ += 1;
+
+    for (i >>= 1; i != 0; i >>= 1)
+        Combine(tree_[i], tree_[i << 1], tree_[(i << 1) | 1]);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::Grow()
+{
+    std::size_t capacity = 1;
+    while (capacity <= len_)
+        capacity <<= 1;
+
+    TreeStorage<Base, Alloc> grown(tree_.get_allocator());
+    grown.assign(2 * capacity, Identity());
+
+    if (capacity_ != 0 && (capacity_ & (capacity_ - 1)) == 0)
+    {
+        // The old tree becomes the left subtree of the new root. Its
+        // level starting at index `first` moves to start at 2 * first,
+        // and the right subtree covers identity leaves only.
+        for (std::size_t first = 1; first <= capacity_; first <<= 1)
+        {
+            for (std::size_t i = first; i < 2 * first; i++)
+                grown[i + first] = std::move(tree_[i]);
+        }
+
+        tree_.swap(grown);
+        capacity_ = capacity;
+        Combine(tree_[1], tree_[2], tree_[3]);
+    }
+    else
+    {
+        // The leaves of a tree of any other length wrap around its
+        // levels, so it is built again once, on the power of two.
+        for (std::size_t i = 0; i < len_; i++)
+            grown[capacity + i] = std::move(tree_[capacity_ + i]);
+
+        tree_.swap(grown);
+        capacity_ = capacity;
+        BuildInternalIterative(1);
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t SegmentTree<Base, Op, Alloc>::Size() const
+{
+    return len_;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t SegmentTree<Base, Op, Alloc>::GetTreeSize(
+            std::size_t const &len
+)
+{
+    if (len == 0)
     {
         // No leaves imply no nodes in the segment tree
         return 0;
     }
 
     // Returns >= minimum number of nodes required
-    // for storing segment tree with `len` leaves
-    return 2 * std::pow(2, std::ceil(std::log2(len))) - 1;
+    // for storing segment tree with `len` leaves: a full
+    // tree over the next power of two, in exact integers
+    std::size_t leaves = 1;
+    while (leaves < len)
+        leaves <<= 1;
+
+    return 2 * leaves - 1;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+std::size_t SegmentTree<Base, Op, Alloc>::RecursiveTreeSize() const
+{
+    // The compact layout has exactly one node per subtree
+    if (type_ == TREE_COMPACT)
+        return len_ == 0 ? 0 : 2 * len_ - 1;
+
+    return GetTreeSize(len_);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+inline bool SegmentTree<Base, Op, Alloc>::IsRecursive() const
+{
+    return type_ == TREE_RECURSIVE || type_ == TREE_COMPACT || type_ == TREE_VEB;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+inline std::size_t SegmentTree<Base, Op, Alloc>::LeftChild(
+            std::size_t tree_index
+) const
+{
+    return type_ == TREE_COMPACT ? tree_index + 1 : (tree_index << 1) + 1;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+inline std::size_t SegmentTree<Base, Op, Alloc>::RightChild(
+            std::size_t tree_index,
+            std::size_t l_index,
+            std::size_t boundary
+) const
+{
+    // In the compact layout the left subtree, of boundary - l_index + 1
+    // leaves, takes twice as many nodes less one, right after tree_index.
+    return type_ == TREE_COMPACT ? tree_index + 2 * (boundary - l_index + 1) : (tree_index << 1) + 2;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+inline std::size_t SegmentTree<Base, Op, Alloc>::NodePosition(
+            std::size_t tree_index
+) const
+{
+    if (type_ != TREE_VEB)
+        return tree_index;
+
+    // The heap index, from 1, is a leading one at the depth of the
+    // node followed by the path to it from the root.
+    std::size_t heap = tree_index + 1;
+    std::size_t depth = 63 - __builtin_clzll(heap);
+    std::size_t path = heap ^ (std::size_t(1) << depth);
+    std::size_t position = 0;
+
+    // Every depth has the same number of steps, padded with empty
+    // ones, so that the loop does not depend on the depth.
+    VebStep const *step = veb_steps_.data() + depth * veb_step_count_;
+    for (std::size_t k = 0; k < veb_step_count_; k++)
+        position += step[k].base + ((path >> step[k].shift) & step[k].mask) * step[k].size;
+
+    return position;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::BuildVebSteps()
+{
+    std::size_t levels = 0;
+    for (std::size_t size = GetTreeSize(len_); size > 0; size >>= 1)
+        levels++;
+
+    std::vector<std::vector<VebStep> > steps(levels);
+    veb_step_count_ = 0;
+
+    for (std::size_t depth = 0; depth < levels; depth++)
+    {
+        // A tree of h levels stores its top h / 2 levels first, then
+        // the subtrees of the remaining levels, one after the other.
+        // The steps only depend on the depth, never on the path.
+        std::size_t h = levels, rel = depth;
+
+        while (h > 1)
+        {
+            std::size_t top = h / 2, bottom = h - top;
+
+            if (rel >= top)
+            {
+                VebStep step = {rel - top, (std::size_t(1) << top) - 1,
+                                (std::size_t(1) << top) - 1, (std::size_t(1) << bottom) - 1};
+                steps[depth].push_back(step);
+                rel -= top;
+                h = bottom;
+            }
+            else
+            {
+                h = top;
+            }
+        }
+
+        veb_step_count_ = std::max(veb_step_count_, steps[depth].size());
+    }
+
+    VebStep empty = {0, 0, 0, 0};
+    veb_steps_.assign(levels * veb_step_count_, empty);
+    for (std::size_t depth = 0; depth < levels; depth++)
+        std::copy(steps[depth].begin(), steps[depth].end(), veb_steps_.begin() + depth * veb_step_count_);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::Combine(
+            Base    &out,
+            Base    &a,
+            Base    &b
+)
+{
+    MonoidCombine<Base, Op>::Combine(bin_func_, out, a, b);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::Accumulate(
+            Base    &acc,
+            Base    &rhs
+)
+{
+    MonoidCombine<Base, Op>::Accumulate(bin_func_, acc, rhs);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+inline void SegmentTree<Base, Op, Alloc>::AccumulateSeeded(
+            Base    &acc,
+            bool    &seeded,
+            Base    &rhs
+)
+{
+    if (seeded)
+    {
+        Accumulate(acc, rhs);
+    }
+    else
+    {
+        acc = rhs;
+        seeded = true;
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+Base SegmentTree<Base, Op, Alloc>::Identity()
+{
+    return MonoidIdentity<Base, Op>::Get();
 }
 
 
-template <typename Base>
-void SegmentTree<Base>::UpdateFunction(
-            std::function<Base(Base&, Base&)> bin_func
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::UpdateFunction(
+            Op bin_func
 )
 {
     // Updating current segment tree operation /
@@ -402,8 +2449,259 @@ void SegmentTree<Base>::UpdateFunction(
 }
 
 
-template <typename Base>
-void SegmentTree<Base>::DebugPrint()
+template <typename Base, typename Op, typename Alloc>
+SegmentTree<Base, Op, Alloc>::SegmentTree(
+            Op          bin_func,
+            Alloc const &alloc
+)
+    : tree_(alloc)
+    , bin_func_(bin_func)
+    , len_(0)
+    , capacity_(0)
+    , type_(TREE_ITERATIVE)
+    , wide_stride_(0)
+    , veb_step_count_(0)
+{
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::CheckLeaves()
+{
+    // Only the iterative layout has a shape for no leaves, which
+    // PushBack can then grow.
+    if (len_ == 0 && type_ != TREE_ITERATIVE)
+    {
+        throw std::invalid_argument("Only an iterative segment tree can be built without leaves.");
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::CheckWritable()
+{
+    if (!tree_.Writable())
+    {
+        throw std::logic_error("The segment tree was opened read-only.");
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::Save(
+            std::string const &path
+)
+{
+    static_assert(std::is_trivially_copyable<Base>::value,
+                  "Only trees of trivially copyable types can be saved.");
+
+    // The iterative tree_[0] holds the identity, read by QueryBatch
+    if (type_ == TREE_ITERATIVE && tree_.size() > 0 && tree_.Writable())
+        tree_[0] = Identity();
+
+    std::vector<std::uint64_t> meta;
+    if (type_ == TREE_WIDE)
+    {
+        meta.push_back(wide_stride_);
+        meta.insert(meta.end(), wide_offset_.begin(), wide_offset_.end());
+    }
+
+    FileHeader header = {{'S', 'E', 'G', 'T', 'R', 'E', 'E', '\0'}, kFileVersion,
+                         (std::uint32_t)type_, len_, sizeof(Base), tree_.size(), meta.size(), 0, 0};
+
+    // Nodes start on a page boundary, after the header and layout words
+    std::size_t meta_end = sizeof(FileHeader) + meta.size() * sizeof(std::uint64_t);
+    header.data_offset = (meta_end + 4095) / 4096 * 4096;
+    header.checksum = FileChecksum(header, meta, tree_.data());
+
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    std::vector<char> padding(header.data_offset - meta_end, 0);
+
+    out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    out.write(reinterpret_cast<char const *>(meta.data()), meta.size() * sizeof(std::uint64_t));
+    out.write(padding.data(), padding.size());
+    out.write(reinterpret_cast<char const *>(tree_.data()), tree_.size() * sizeof(Base));
+    out.close();
+
+    if (!out)
+    {
+        throw std::runtime_error("Cannot write segment tree file " + path + ".");
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+SegmentTree<Base, Op, Alloc> SegmentTree<Base, Op, Alloc>::Open(
+            std::string const   &path,
+            Op                  bin_func,
+            int                 mode,
+            bool                verify,
+            Alloc const         &alloc
+)
+{
+    static_assert(std::is_trivially_copyable<Base>::value,
+                  "Only trees of trivially copyable types can be opened.");
+
+    std::ifstream in(path.c_str(), std::ios::binary);
+    FileHeader header;
+
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+    {
+        throw std::runtime_error("Cannot read segment tree file " + path + ".");
+    }
+    if (std::string(header.magic, 7) != "SEGTREE" || header.version != kFileVersion)
+    {
+        throw std::runtime_error(path + " is not a segment tree file of this version.");
+    }
+    if (header.base_size != sizeof(Base))
+    {
+        throw std::runtime_error(path + " was saved with another node type.");
+    }
+
+    // A wide tree has a layout word per level and the stride, so a
+    // larger count can only come from a corrupted header.
+    if (header.meta_count > kMaxDepth)
+    {
+        throw std::runtime_error("Segment tree file " + path + " has an invalid header.");
+    }
+
+    std::vector<std::uint64_t> meta(header.meta_count);
+    if (!in.read(reinterpret_cast<char *>(meta.data()), meta.size() * sizeof(std::uint64_t)))
+    {
+        throw std::runtime_error("Segment tree file " + path + " is truncated.");
+    }
+
+    CheckHeader(header, meta, path);
+
+    SegmentTree tree(bin_func, alloc);
+    tree.len_ = header.len;
+    tree.capacity_ = header.node_count / 2;
+    tree.type_ = header.type;
+    if (tree.type_ == TREE_BLOCKED)
+        tree.capacity_ = (header.node_count - header.len) / 2;
+    if (tree.type_ == TREE_VEB)
+        tree.BuildVebSteps();
+    if (tree.type_ == TREE_WIDE)
+    {
+        tree.wide_stride_ = meta[0];
+        tree.wide_offset_.assign(meta.begin() + 1, meta.end());
+    }
+
+    tree.tree_.Map(path, header.data_offset, header.node_count, mode == MAP_COPY_ON_WRITE);
+
+    if (verify && FileChecksum(header, meta, tree.tree_.data()) != header.checksum)
+    {
+        throw std::runtime_error("Checksum mismatch in segment tree file " + path + ".");
+    }
+
+    return tree;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::CheckHeader(
+            FileHeader const                    &header,
+            std::vector<std::uint64_t> const    &meta,
+            std::string const                   &path
+)
+{
+    std::string const invalid = "Segment tree file " + path + " has an invalid header.";
+
+    if (header.type > TREE_VEB)
+    {
+        throw std::runtime_error("Segment tree file " + path + " has an unknown tree type.");
+    }
+
+    // The nodes start on the first page after the layout words, and
+    // every layout holds at least one node per leaf.
+    std::size_t meta_end = sizeof(FileHeader) + meta.size() * sizeof(std::uint64_t);
+    if (header.data_offset != (meta_end + 4095) / 4096 * 4096
+        || header.node_count > (std::uint64_t(-1) - header.data_offset) / sizeof(Base)
+        || header.len > header.node_count)
+    {
+        throw std::runtime_error(invalid);
+    }
+
+    std::size_t len = header.len, nodes = header.node_count;
+    bool valid = meta.empty() && len > 0;
+
+    if (header.type == TREE_ITERATIVE)
+    {
+        // 2 * len nodes, or a power of two capacity once grown by
+        // PushBack, which also allows an empty tree.
+        std::size_t capacity = nodes / 2;
+        valid = meta.empty() && nodes % 2 == 0 && capacity >= len
+             && (capacity == len || (capacity & (capacity - 1)) == 0);
+    }
+    else if (header.type == TREE_RECURSIVE || header.type == TREE_VEB)
+        valid = valid && nodes == GetTreeSize(len);
+    else if (header.type == TREE_COMPACT)
+        valid = valid && nodes == 2 * len - 1;
+    else if (header.type == TREE_BLOCKED)
+        valid = valid && nodes == 2 * ((len + kBlockSize - 1) / kBlockSize) + len;
+    else if (header.type == TREE_WIDE)
+    {
+        // The stride, then the offset of every level
+        std::vector<std::size_t> offsets;
+        std::size_t stride = WideLayout(len, offsets);
+
+        valid = len > 0 && meta.size() == offsets.size() + 1 && meta[0] == stride
+             && nodes == 3 * stride && std::equal(offsets.begin(), offsets.end(), meta.begin() + 1);
+    }
+
+    if (!valid)
+    {
+        throw std::runtime_error(invalid);
+    }
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+std::uint64_t SegmentTree<Base, Op, Alloc>::FileChecksum(
+            FileHeader                          header,
+            std::vector<std::uint64_t> const    &meta,
+            Base const                          *nodes
+)
+{
+    header.checksum = 0;
+
+    std::uint64_t hash = Checksum(&header, sizeof(header), 14695981039346656037ULL);
+    hash = Checksum(meta.data(), meta.size() * sizeof(std::uint64_t), hash);
+    return Checksum(nodes, header.node_count * sizeof(Base), hash);
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+std::uint64_t SegmentTree<Base, Op, Alloc>::Checksum(
+            void const    *bytes,
+            std::size_t   size,
+            std::uint64_t hash
+)
+{
+    unsigned char const *p = static_cast<unsigned char const *>(bytes);
+    std::size_t i = 0;
+
+    // Hashed a word at a time, so that saving costs about as much
+    // as writing the file
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+    {
+        std::uint64_t word;
+        std::memcpy(&word, p + i, sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ULL;
+    }
+    for (; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+template <typename Base, typename Op, typename Alloc>
+void SegmentTree<Base, Op, Alloc>::DebugPrint()
 {
     int limit = GetTreeSize(len_);
     //int limit = 2*len_;
@@ -0,0 +1,250 @@
+#ifndef _SEGMENTTREE2D_CPP_
+#define _SEGMENTTREE2D_CPP_
+
+#include <stdexcept>
+#include <utility>
+
+#include "segtree2d.h"
+
+
+template <typename Base, typename Op>
+SegmentTree2D<Base, Op>::SegmentTree2D(
+            std::vector<std::vector<Base> > const   &init_values,
+            Op                                      bin_func
+)
+    : bin_func_(bin_func)
+    , rows_(init_values.size())
+    , cols_(init_values.empty() ? 0 : init_values[0].size())
+{
+    if (rows_ == 0 || cols_ == 0)
+    {
+        throw std::invalid_argument("A two dimensional segment tree needs at least one cell.");
+    }
+
+    tree_.resize(4 * rows_ * cols_);
+
+    for (std::size_t x = 0; x < rows_; x++)
+    {
+        if (init_values[x].size() != cols_)
+        {
+            throw std::invalid_argument("All the rows of the grid must have the same length.");
+        }
+        for (std::size_t y = 0; y < cols_; y++)
+            tree_[Node(x + rows_, y + cols_)] = init_values[x][y];
+    }
+
+    Build();
+}
+
+
+template <typename Base, typename Op>
+SegmentTree2D<Base, Op>::SegmentTree2D(
+            Base const      &init_value,
+            std::size_t     rows,
+            std::size_t     cols,
+            Op              bin_func
+)
+    : bin_func_(bin_func)
+    , rows_(rows)
+    , cols_(cols)
+{
+    if (rows_ == 0 || cols_ == 0)
+    {
+        throw std::invalid_argument("A two dimensional segment tree needs at least one cell.");
+    }
+
+    tree_.resize(4 * rows_ * cols_);
+
+    for (std::size_t x = 0; x < rows_; x++)
+        for (std::size_t y = 0; y < cols_; y++)
+            tree_[Node(x + rows_, y + cols_)] = init_value;
+
+    Build();
+}
+
+
+template <typename Base, typename Op>
+void SegmentTree2D<Base, Op>::Build()
+{
+    // Column trees of the leaf rows, as in the iterative 1D build
+    for (std::size_t x = rows_; x < 2 * rows_; x++)
+        for (std::size_t y = cols_ - 1; y > 0; y--)
+            Combine(tree_[Node(x, y)], tree_[Node(x, y << 1)], tree_[Node(x, y << 1 | 1)]);
+
+    // Every node of a row node combines the same node of its two
+    // children, leaves and internal column nodes alike.
+    for (std::size_t x = rows_ - 1; x > 0; x--)
+        for (std::size_t y = 1; y < 2 * cols_; y++)
+            Combine(tree_[Node(x, y)], tree_[Node(x << 1, y)], tree_[Node(x << 1 | 1, y)]);
+}
+
+
+template <typename Base, typename Op>
+Base SegmentTree2D<Base, Op>::Query(
+            std::size_t x1,
+            std::size_t y1,
+            std::size_t x2,
+            std::size_t y2
+)
+{
+    if (x2 >= rows_ || y2 >= cols_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+    if (x1 > x2 || y1 > y2)
+    {
+        throw std::out_of_range("The left index must be smaller than the right index.");
+    }
+
+    // The result starts from the first node met rather than from an
+    // identity, which a lambda cannot declare.
+    Base result;
+    bool seeded = false;
+
+    // The same climb as SegmentTree::QueryIterative, over the row
+    // nodes, with every row node met answering the column range.
+    std::size_t l_ind = x1 + rows_, r_ind = x2 + 1 + rows_;
+
+    while (l_ind < r_ind)
+    {
+        if (l_ind & 1)
+            QueryRow(l_ind++, y1, y2 + 1, result, seeded);
+        if (r_ind & 1)
+            QueryRow(--r_ind, y1, y2 + 1, result, seeded);
+
+        l_ind >>= 1;
+        r_ind >>= 1;
+    }
+
+    return result;
+}
+
+
+template <typename Base, typename Op>
+void SegmentTree2D<Base, Op>::QueryRow(
+            std::size_t x,
+            std::size_t l_qbound,
+            std::size_t r_qbound,
+            Base        &result,
+            bool        &seeded
+)
+{
+    std::size_t l_ind = l_qbound + cols_, r_ind = r_qbound + cols_;
+
+    while (l_ind < r_ind)
+    {
+        if (l_ind & 1)
+            AccumulateNode(tree_[Node(x, l_ind++)], result, seeded);
+        if (r_ind & 1)
+            AccumulateNode(tree_[Node(x, --r_ind)], result, seeded);
+
+        l_ind >>= 1;
+        r_ind >>= 1;
+    }
+}
+
+
+template <typename Base, typename Op>
+inline void SegmentTree2D<Base, Op>::AccumulateNode(
+            Base        &node,
+            Base        &result,
+            bool        &seeded
+)
+{
+    if (seeded)
+    {
+        MonoidCombine<Base, Op>::Accumulate(bin_func_, result, node);
+    }
+    else
+    {
+        result = node;
+        seeded = true;
+    }
+}
+
+
+template <typename Base, typename Op>
+void SegmentTree2D<Base, Op>::Update(
+            std::size_t x,
+            std::size_t y,
+            Base const  &new_value
+)
+{
+    UpdateValue(x, y, new_value);
+}
+
+
+template <typename Base, typename Op>
+void SegmentTree2D<Base, Op>::Update(
+            std::size_t x,
+            std::size_t y,
+            Base        &&new_value
+)
+{
+    UpdateValue(x, y, std::move(new_value));
+}
+
+
+template <typename Base, typename Op>
+template <typename Value>
+void SegmentTree2D<Base, Op>::UpdateValue(
+            std::size_t x,
+            std::size_t y,
+            Value       &&new_value
+)
+{
+    if (x >= rows_ || y >= cols_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+
+    x += rows_;
+    y += cols_;
+    tree_[Node(x, y)] = std::forward<Value>(new_value);
+
+    // The column tree of the leaf row
+    for (std::size_t c = y >> 1; c > 0; c >>= 1)
+        Combine(tree_[Node(x, c)], tree_[Node(x, c << 1)], tree_[Node(x, c << 1 | 1)]);
+
+    // Then, in every row node above it, the column nodes over y
+    for (std::size_t r = x >> 1; r > 0; r >>= 1)
+        for (std::size_t c = y; c > 0; c >>= 1)
+            Combine(tree_[Node(r, c)], tree_[Node(r << 1, c)], tree_[Node(r << 1 | 1, c)]);
+}
+
+
+template <typename Base, typename Op>
+std::size_t SegmentTree2D<Base, Op>::Rows() const
+{
+    return rows_;
+}
+
+
+template <typename Base, typename Op>
+std::size_t SegmentTree2D<Base, Op>::Cols() const
+{
+    return cols_;
+}
+
+
+template <typename Base, typename Op>
+inline std::size_t SegmentTree2D<Base, Op>::Node(
+            std::size_t x,
+            std::size_t y
+) const
+{
+    return x * 2 * cols_ + y;
+}
+
+
+template <typename Base, typename Op>
+inline void SegmentTree2D<Base, Op>::Combine(
+            Base    &out,
+            Base    &a,
+            Base    &b
+)
+{
+    MonoidCombine<Base, Op>::Combine(bin_func_, out, a, b);
+}
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef _SHARDEDSEGMENTTREE_CPP_
+#define _SHARDEDSEGMENTTREE_CPP_
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "shardedsegtree.h"
+
+
+template <typename Base, typename Op>
+ShardedSegmentTree<Base, Op>::ShardedSegmentTree(
+            std::vector<Base> const  &init_values,
+            Op                       bin_func,
+            int                      type,
+            std::size_t              shards
+)
+    : bin_func_(bin_func)
+    , len_(init_values.size())
+    , shard_len_(ShardLength(len_, shards))
+    , shard_count_((len_ + shard_len_ - 1) / shard_len_)
+    , states_(shard_count_)
+{
+    for (std::size_t s = 0; s < shard_count_; s++)
+    {
+        typename std::vector<Base>::const_iterator first = init_values.begin() + s * shard_len_;
+        shards_.push_back(SegmentTree<Base, Op>(
+            std::vector<Base>(first, first + ShardSize(s)), bin_func_, type));
+        states_[s].root.Store(shards_[s].Query(0, ShardSize(s) - 1));
+    }
+}
+
+
+template <typename Base, typename Op>
+ShardedSegmentTree<Base, Op>::ShardedSegmentTree(
+            Base const               &init_value,
+            std::size_t const        &len,
+            Op                       bin_func,
+            int                      type,
+            std::size_t              shards
+)
+    : bin_func_(bin_func)
+    , len_(len)
+    , shard_len_(ShardLength(len_, shards))
+    , shard_count_((len_ + shard_len_ - 1) / shard_len_)
+    , states_(shard_count_)
+{
+    for (std::size_t s = 0; s < shard_count_; s++)
+    {
+        shards_.push_back(SegmentTree<Base, Op>(init_value, ShardSize(s), bin_func_, type));
+        states_[s].root.Store(shards_[s].Query(0, ShardSize(s) - 1));
+    }
+}
+
+
+template <typename Base, typename Op>
+Base ShardedSegmentTree<Base, Op>::Query(
+            std::size_t  l_index,
+            std::size_t  r_index
+)
+{
+    if (r_index >= len_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+    if (l_index > r_index)
+    {
+        throw std::out_of_range("The left index must be smaller than the right index.");
+    }
+
+    std::size_t l_shard = l_index / shard_len_, r_shard = r_index / shard_len_;
+    std::size_t l_offset = l_shard * shard_len_, r_offset = r_shard * shard_len_;
+
+    if (l_shard == r_shard)
+    {
+        // The whole range lies inside a single shard
+        std::lock_guard<std::mutex> lock(states_[l_shard].lock);
+        return shards_[l_shard].Query(l_index - l_offset, r_index - l_offset);
+    }
+
+    Base l_query, r_query;
+    {
+        std::lock_guard<std::mutex> lock(states_[l_shard].lock);
+        l_query = shards_[l_shard].Query(l_index - l_offset, ShardSize(l_shard) - 1);
+    }
+    {
+        std::lock_guard<std::mutex> lock(states_[r_shard].lock);
+        r_query = shards_[r_shard].Query(0, r_index - r_offset);
+    }
+
+    // The full shards in between are read from their roots, without
+    // taking their locks.
+    for (std::size_t s = l_shard + 1; s < r_shard; s++)
+    {
+        Base root = states_[s].root.Load();
+        MonoidCombine<Base, Op>::Accumulate(bin_func_, l_query, root);
+    }
+
+    MonoidCombine<Base, Op>::Accumulate(bin_func_, l_query, r_query);
+    return l_query;
+}
+
+
+template <typename Base, typename Op>
+void ShardedSegmentTree<Base, Op>::Update(
+            Base const          &new_value,
+            std::size_t const   &index
+)
+{
+    UpdateValue(new_value, index);
+}
+
+
+template <typename Base, typename Op>
+void ShardedSegmentTree<Base, Op>::Update(
+            Base                &&new_value,
+            std::size_t const   &index
+)
+{
+    UpdateValue(std::move(new_value), index);
+}
+
+
+template <typename Base, typename Op>
+template <typename Value>
+void ShardedSegmentTree<Base, Op>::UpdateValue(
+            Value               &&new_value,
+            std::size_t const   &index
+)
+{
+    if (index >= len_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+
+    std::size_t shard = index / shard_len_;
+
+    std::lock_guard<std::mutex> lock(states_[shard].lock);
+    shards_[shard].Update(std::forward<Value>(new_value), index - shard * shard_len_);
+
+    // Still under the shard lock, so that the roots of a shard are
+    // published in the order of its updates, by one writer at a time.
+    states_[shard].root.Store(shards_[shard].Query(0, ShardSize(shard) - 1));
+}
+
+
+template <typename Base, typename Op>
+std::size_t ShardedSegmentTree<Base, Op>::ShardLength(
+            std::size_t len,
+            std::size_t shards
+)
+{
+    if (len == 0)
+    {
+        throw std::invalid_argument("A sharded segment tree needs at least one leaf.");
+    }
+
+    shards = std::min(std::max<std::size_t>(shards, 1), len);
+    return (len + shards - 1) / shards;
+}
+
+
+template <typename Base, typename Op>
+std::size_t ShardedSegmentTree<Base, Op>::ShardSize(
+            std::size_t shard
+) const
+{
+    return std::min(shard_len_, len_ - shard * shard_len_);
+}
+
+
+template <typename Base, bool Trivial>
+std::size_t const ShardRoot<Base, Trivial>::kWords;
+
+
+template <typename Base, bool Trivial>
+ShardRoot<Base, Trivial>::ShardRoot()
+    : seq_(0)
+{
+    for (std::size_t w = 0; w < kWords; w++)
+        words_[w].store(0, std::memory_order_relaxed);
+}
+
+
+template <typename Base, bool Trivial>
+void ShardRoot<Base, Trivial>::Store(
+            Base const  &value
+)
+{
+    unsigned long buffer[kWords] = {};
+    std::memcpy(buffer, &value, sizeof(Base));
+
+    unsigned seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (std::size_t w = 0; w < kWords; w++)
+        words_[w].store(buffer[w], std::memory_order_relaxed);
+
+    seq_.store(seq + 2, std::memory_order_release);
+}
+
+
+template <typename Base, bool Trivial>
+Base ShardRoot<Base, Trivial>::Load() const
+{
+    unsigned long buffer[kWords];
+    unsigned before, after;
+
+    do
+    {
+        // An odd number means a store is running, so the words are
+        // not read until it ends.
+        do
+        {
+            before = seq_.load(std::memory_order_acquire);
+        } while (before & 1);
+
+        for (std::size_t w = 0; w < kWords; w++)
+            buffer[w] = words_[w].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = seq_.load(std::memory_order_relaxed);
+    } while (before != after);
+
+    Base value;
+    std::memcpy(&value, buffer, sizeof(Base));
+    return value;
+}
+
+
+template <typename Base>
+void ShardRoot<Base, false>::Store(
+            Base const  &value
+)
+{
+    std::atomic_store(&value_, std::shared_ptr<Base const>(new Base(value)));
+}
+
+
+template <typename Base>
+Base ShardRoot<Base, false>::Load() const
+{
+    return *std::atomic_load(&value_);
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef _SLIDINGWINDOWTREE_CPP_
+#define _SLIDINGWINDOWTREE_CPP_
+
+#include <stdexcept>
+#include <utility>
+
+#include "slidingwindowtree.h"
+
+
+template <typename Base, typename Op>
+SlidingWindowTree<Base, Op>::SlidingWindowTree(
+            std::size_t capacity,
+            Op          bin_func
+)
+    : tree_(MonoidIdentity<Base, Op>::Get(), capacity, bin_func, TREE_ITERATIVE)
+    , bin_func_(bin_func)
+    , capacity_(capacity)
+    , head_(0)
+    , size_(0)
+{
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("A sliding window must hold at least one value.");
+    }
+}
+
+
+template <typename Base, typename Op>
+void SlidingWindowTree<Base, Op>::Push(
+            Base const &new_value
+)
+{
+    PushValue(new_value);
+}
+
+
+template <typename Base, typename Op>
+void SlidingWindowTree<Base, Op>::Push(
+            Base &&new_value
+)
+{
+    PushValue(std::move(new_value));
+}
+
+
+template <typename Base, typename Op>
+template <typename Value>
+void SlidingWindowTree<Base, Op>::PushValue(
+            Value &&new_value
+)
+{
+    // The leaf at head_ is free, or holds the oldest value
+    tree_.Update(std::forward<Value>(new_value), head_);
+
+    head_ = head_ + 1 == capacity_ ? 0 : head_ + 1;
+    if (size_ < capacity_)
+        size_ += 1;
+}
+
+
+template <typename Base, typename Op>
+Base SlidingWindowTree<Base, Op>::WindowQuery(
+            std::size_t last_k
+)
+{
+    if (last_k == 0 || last_k > size_)
+    {
+        // window larger than the values held
+        throw std::out_of_range("The window must hold between one and Size() values.");
+    }
+
+    if (last_k <= head_)
+    {
+        // The window ends right before head_ without wrapping
+        return tree_.Query(head_ - last_k, head_ - 1);
+    }
+
+    // The older part of the window lies at the end of the buffer, and
+    // the newer part, if any, at its beginning.
+    Base older = tree_.Query(capacity_ - (last_k - head_), capacity_ - 1);
+    if (head_ == 0)
+        return older;
+
+    Base newer = tree_.Query(0, head_ - 1);
+    MonoidCombine<Base, Op>::Accumulate(bin_func_, older, newer);
+    return older;
+}
+
+
+template <typename Base, typename Op>
+std::size_t SlidingWindowTree<Base, Op>::Size() const
+{
+    return size_;
+}
+
+
+template <typename Base, typename Op>
+std::size_t SlidingWindowTree<Base, Op>::Capacity() const
+{
+    return capacity_;
+}
+
+#endif
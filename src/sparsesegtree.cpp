@@ -0,0 +1,168 @@
+#ifndef _SPARSESEGMENTTREE_CPP_
+#define _SPARSESEGMENTTREE_CPP_
+
+#include <stdexcept>
+
+#include "sparsesegtree.h"
+
+
+template <typename Base, typename Op>
+std::size_t const SparseSegmentTree<Base, Op>::kNone;
+
+
+template <typename Base, typename Op>
+SparseSegmentTree<Base, Op>::SparseSegmentTree(
+            std::uint64_t const   &max_key,
+            Op                    bin_func
+)
+    : bin_func_(bin_func)
+    , identity_(MonoidIdentity<Base, Op>::Get())
+    , max_key_(max_key)
+{
+    NewNode();
+}
+
+
+template <typename Base, typename Op>
+SparseSegmentTree<Base, Op>::SparseSegmentTree(
+            std::uint64_t const   &max_key,
+            Op                    bin_func,
+            Base const            &identity
+)
+    : bin_func_(bin_func)
+    , identity_(identity)
+    , max_key_(max_key)
+{
+    NewNode();
+}
+
+
+template <typename Base, typename Op>
+Base SparseSegmentTree<Base, Op>::Query(
+            std::uint64_t    l_key,
+            std::uint64_t    r_key
+)
+{
+    if (r_key > max_key_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+    if (l_key > r_key)
+    {
+        throw std::out_of_range("The left index must be smaller than the right index.");
+    }
+
+    return QueryRecursive(l_key, r_key, 0, max_key_, 0);
+}
+
+
+template <typename Base, typename Op>
+Base SparseSegmentTree<Base, Op>::QueryRecursive(
+            std::uint64_t   l_qbound,
+            std::uint64_t   r_qbound,
+            std::uint64_t   l_key,
+            std::uint64_t   r_key,
+            std::size_t     node
+)
+{
+    if (node == kNone)
+    {
+        // No key below was ever updated
+        return identity_;
+    }
+    if (l_qbound <= l_key && r_key <= r_qbound)
+    {
+        return nodes_[node].value;
+    }
+
+    // Written so that it cannot overflow for r_key = 2^64 - 1
+    std::uint64_t boundary = l_key + ((r_key - l_key) >> 1);
+
+    if (r_qbound <= boundary)
+        return QueryRecursive(l_qbound, r_qbound, l_key, boundary, nodes_[node].left);
+    if (l_qbound > boundary)
+        return QueryRecursive(l_qbound, r_qbound, boundary + 1, r_key, nodes_[node].right);
+
+    Base l_query = QueryRecursive(l_qbound, boundary, l_key, boundary, nodes_[node].left);
+    Base r_query = QueryRecursive(boundary + 1, r_qbound, boundary + 1, r_key, nodes_[node].right);
+    return bin_func_(l_query, r_query);
+}
+
+
+template <typename Base, typename Op>
+void SparseSegmentTree<Base, Op>::Update(
+            Base const          &new_value,
+            std::uint64_t const &key
+)
+{
+    if (key > max_key_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+
+    // The path has at most 64 nodes above the leaf
+    std::size_t path[64];
+    std::size_t depth = 0;
+    std::size_t node = 0;
+    std::uint64_t l_key = 0, r_key = max_key_;
+
+    while (l_key != r_key)
+    {
+        std::uint64_t boundary = l_key + ((r_key - l_key) >> 1);
+        bool go_left = key <= boundary;
+        std::size_t child = go_left ? nodes_[node].left : nodes_[node].right;
+
+        if (child == kNone)
+        {
+            // First update below this node on that side. The pool may
+            // reallocate, so the node is indexed again afterwards.
+            child = NewNode();
+            if (go_left)
+                nodes_[node].left = child;
+            else
+                nodes_[node].right = child;
+        }
+
+        if (go_left)
+            r_key = boundary;
+        else
+            l_key = boundary + 1;
+
+        path[depth++] = node;
+        node = child;
+    }
+
+    nodes_[node].value = new_value;
+
+    while (depth > 0)
+    {
+        node = path[--depth];
+        std::size_t left = nodes_[node].left, right = nodes_[node].right;
+
+        // A missing child is the identity, so the other one is the value
+        if (left == kNone)
+            nodes_[node].value = nodes_[right].value;
+        else if (right == kNone)
+            nodes_[node].value = nodes_[left].value;
+        else
+            nodes_[node].value = bin_func_(nodes_[left].value, nodes_[right].value);
+    }
+}
+
+
+template <typename Base, typename Op>
+std::size_t SparseSegmentTree<Base, Op>::NodeCount() const
+{
+    return nodes_.size();
+}
+
+
+template <typename Base, typename Op>
+std::size_t SparseSegmentTree<Base, Op>::NewNode()
+{
+    Node node = {identity_, kNone, kNone};
+    nodes_.push_back(node);
+    return nodes_.size() - 1;
+}
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef _SPARSETABLE_CPP_
+#define _SPARSETABLE_CPP_
+
+#include <stdexcept>
+#include <utility>
+
+#include "sparsetable.h"
+
+
+template <typename Base, typename Op>
+SparseTable<Base, Op>::SparseTable(
+            std::vector<Base> const     &init_values,
+            Op                          bin_func
+)
+    : table_(init_values)
+    , bin_func_(bin_func)
+    , len_(init_values.size())
+{
+    Build();
+}
+
+
+template <typename Base, typename Op>
+SparseTable<Base, Op>::SparseTable(
+            std::vector<Base>           &&init_values,
+            Op                          bin_func
+)
+    : table_(std::move(init_values))
+    , bin_func_(bin_func)
+    , len_(table_.size())
+{
+    Build();
+}
+
+
+template <typename Base, typename Op>
+SparseTable<Base, Op>::SparseTable(
+            Base const          &init_value,
+            std::size_t const   &len,
+            Op                  bin_func
+)
+    : table_(len, init_value)
+    , bin_func_(bin_func)
+    , len_(len)
+{
+    Build();
+}
+
+
+template <typename Base, typename Op>
+template <typename InputIt, typename>
+SparseTable<Base, Op>::SparseTable(
+            InputIt     first,
+            InputIt     last,
+            Op          bin_func
+)
+    : table_(first, last)
+    , bin_func_(bin_func)
+    , len_(table_.size())
+{
+    Build();
+}
+
+
+template <typename Base, typename Op>
+void SparseTable<Base, Op>::Build()
+{
+    if (len_ == 0)
+    {
+        throw std::invalid_argument("A sparse table needs at least one leaf.");
+    }
+
+    // Level k has one value for every start of a run of 2^k leaves
+    std::size_t total = 0;
+    for (std::size_t run = 1; run <= len_; run <<= 1)
+    {
+        levels_.push_back(total);
+        total += len_ - run + 1;
+    }
+    table_.resize(total);
+
+    for (std::size_t k = 1; k < levels_.size(); k++)
+    {
+        std::size_t half = std::size_t(1) << (k - 1);
+        Base *below = &table_[levels_[k - 1]];
+        Base *level = &table_[levels_[k]];
+
+        for (std::size_t i = 0; i + 2 * half <= len_; i++)
+            MonoidCombine<Base, Op>::Combine(bin_func_, level[i], below[i], below[i + half]);
+    }
+}
+
+
+template <typename Base, typename Op>
+Base SparseTable<Base, Op>::Query(
+            std::size_t  l_index,
+            std::size_t  r_index
+)
+{
+    if (r_index >= len_)
+    {
+        throw std::out_of_range("The indices must be within the range of the segment tree.");
+    }
+    if (l_index > r_index)
+    {
+        throw std::out_of_range("The left index must be smaller than the right index.");
+    }
+
+    std::size_t k = FloorLog2(r_index - l_index + 1);
+    Base *level = &table_[levels_[k]];
+
+    // The run starting at l_index and the one ending at r_index
+    Base result;
+    MonoidCombine<Base, Op>::Combine(bin_func_, result, level[l_index],
+                                     level[r_index + 1 - (std::size_t(1) << k)]);
+    return result;
+}
+
+
+template <typename Base, typename Op>
+void SparseTable<Base, Op>::Update(
+            Base const          &,
+            std::size_t const   &
+)
+{
+    throw std::logic_error("A sparse table is read-only.");
+}
+
+
+template <typename Base, typename Op>
+std::size_t SparseTable<Base, Op>::Size() const
+{
+    return len_;
+}
+
+
+template <typename Base, typename Op>
+inline std::size_t SparseTable<Base, Op>::FloorLog2(
+            std::size_t x
+)
+{
+    return 63 - __builtin_clzll(x);
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef _TREESTORAGE_CPP_
+#define _TREESTORAGE_CPP_
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "treestorage.h"
+
+
+template <typename Base, typename Alloc>
+TreeStorage<Base, Alloc>::TreeStorage(
+            Alloc const &alloc
+)
+    : owned_(alloc)
+    , data_(NULL)
+    , size_(0)
+    , mapping_(NULL)
+    , mapping_len_(0)
+    , writable_(true)
+{
+}
+
+
+template <typename Base, typename Alloc>
+TreeStorage<Base, Alloc>::TreeStorage(
+            TreeStorage const &other
+)
+    : owned_(other.data_, other.data_ + other.size_, other.get_allocator())
+    , data_(owned_.data())
+    , size_(other.size_)
+    , mapping_(NULL)
+    , mapping_len_(0)
+    , writable_(true)
+{
+}
+
+
+template <typename Base, typename Alloc>
+TreeStorage<Base, Alloc>::TreeStorage(
+            TreeStorage &&other
+)
+    : TreeStorage(other.get_allocator())
+{
+    swap(other);
+}
+
+
+template <typename Base, typename Alloc>
+TreeStorage<Base, Alloc> &TreeStorage<Base, Alloc>::operator=(
+            TreeStorage other
+)
+{
+    swap(other);
+    return *this;
+}
+
+
+template <typename Base, typename Alloc>
+TreeStorage<Base, Alloc>::~TreeStorage()
+{
+    Unmap();
+}
+
+
+template <typename Base, typename Alloc>
+void TreeStorage<Base, Alloc>::resize(
+            std::size_t n
+)
+{
+    if (mapping_ != NULL)
+    {
+        // Keeping the first nodes, as std::vector would
+        std::vector<Base, Alloc> owned(data_, data_ + std::min(n, size_), owned_.get_allocator());
+        Unmap();
+        owned_.swap(owned);
+    }
+
+    owned_.resize(n);
+    data_ = owned_.data();
+    size_ = n;
+}
+
+
+template <typename Base, typename Alloc>
+void TreeStorage<Base, Alloc>::assign(
+            std::size_t n,
+            Base const  &value
+)
+{
+    Unmap();
+    owned_.assign(n, value);
+    data_ = owned_.data();
+    size_ = n;
+}
+
+
+template <typename Base, typename Alloc>
+void TreeStorage<Base, Alloc>::Map(
+            std::string const  &path,
+            std::size_t        offset,
+            std::size_t        count,
+            bool               writable
+)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot open segment tree file " + path + ".");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (std::size_t)info.st_size < offset + count * sizeof(Base))
+    {
+        ::close(fd);
+        throw std::runtime_error("Segment tree file " + path + " is truncated.");
+    }
+
+    // The whole file is mapped, since mmap offsets must be page
+    // aligned. A private mapping never writes back to the file, so
+    // copy-on-write only needs the file to be readable.
+    std::size_t length = info.st_size;
+    void *mapping = mmap(NULL, length, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                         MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Cannot map segment tree file " + path + ".");
+    }
+
+    Unmap();
+    owned_.clear();
+    owned_.shrink_to_fit();
+
+    mapping_ = mapping;
+    mapping_len_ = length;
+    data_ = reinterpret_cast<Base *>(static_cast<char *>(mapping) + offset);
+    size_ = count;
+    writable_ = writable;
+}
+
+
+template <typename Base, typename Alloc>
+void TreeStorage<Base, Alloc>::swap(
+            TreeStorage &other
+)
+{
+    owned_.swap(other.owned_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(mapping_, other.mapping_);
+    std::swap(mapping_len_, other.mapping_len_);
+    std::swap(writable_, other.writable_);
+}
+
+
+template <typename Base, typename Alloc>
+void TreeStorage<Base, Alloc>::Unmap()
+{
+    if (mapping_ == NULL)
+        return;
+
+    munmap(mapping_, mapping_len_);
+    mapping_ = NULL;
+    mapping_len_ = 0;
+    data_ = owned_.data();
+    size_ = owned_.size();
+    writable_ = true;
+}
+
+#endif
@@ -0,0 +1,516 @@
+/**
+ * Benchmark suite of the SegmentTree types, on seeded workloads.
+ *
+ * Every case (a Base type and an operation) is run on every tree type
+ * for every workload. A workload draws the leaves of its operations
+ * uniformly or from a Zipf distribution, asks for short or long
+ * ranges, and mixes queries and updates in a fixed proportion. The
+ * operations are generated once per workload from the seed, so all
+ * tree types, and every run with the same seed, replay the same ones.
+ *
+ * Each (case, type, workload) builds a fresh tree, runs the operations
+ * `warmup` times untimed, then `reps` times, timing each operation. It
+ * reports the median build time, the median over repetitions of the
+ * mean time per operation, operations per second, and the 50th, 90th
+ * and 99th percentiles and maximum of all timed operations. Latencies
+ * include one steady_clock read, whose cost is reported as timer_ns.
+ *
+ * Run `./benchmarks --help` for the options.
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "segtree.h"
+#include "test_types.h"
+
+
+/*
+ *  ---------------------------
+ *  Options and results
+ *  --------------------------
+ */
+
+struct Options
+{
+    std::size_t     leaves;     ///< leaves of every tree
+    std::size_t     ops;        ///< operations per repetition
+    std::size_t     reps;       ///< timed repetitions
+    std::size_t     warmup;     ///< untimed repetitions before them
+    unsigned long   seed;       ///< seed of the leaves and operations
+    std::string     format;     ///< table, csv or json
+    std::string     filter;     ///< only runs whose "case/type/workload" contains it
+};
+
+struct Result
+{
+    std::string     name;       ///< "case/type/workload"
+    double          build_ms;   ///< median build time
+    double          ns_per_op;  ///< median over reps of the mean latency
+    double          ops_per_s;  ///< 1e9 / ns_per_op
+    double          p50_ns;
+    double          p90_ns;
+    double          p99_ns;
+    double          max_ns;
+};
+
+// Checksums of the answers are stored here so that the compiler
+// cannot drop the queries being timed.
+volatile long long sink;
+
+typedef std::chrono::steady_clock Clock;
+
+static double Nanoseconds(Clock::time_point t0, Clock::time_point t1)
+{
+    return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+
+/*
+ *  ---------------------------
+ *  Workloads
+ *  --------------------------
+ */
+
+enum KeyDistribution
+{
+    KEYS_UNIFORM    = 0,
+    KEYS_ZIPF       = 1
+};
+
+enum RangeLength
+{
+    RANGES_SHORT    = 0,    ///< 1 to kShortRange leaves
+    RANGES_LONG     = 1     ///< half of the leaves to all of them
+};
+
+struct Workload
+{
+    char const      *name;
+    int             keys;       ///< a KeyDistribution
+    int             ranges;     ///< a RangeLength
+    int             read_pct;   ///< percentage of operations that are queries
+};
+
+static std::size_t const kShortRange = 16;
+static double const kZipfTheta = 0.99;
+
+static Workload const kWorkloads[] = {
+    {"uniform-short-read",      KEYS_UNIFORM,   RANGES_SHORT,   100},
+    {"uniform-long-read",       KEYS_UNIFORM,   RANGES_LONG,    100},
+    {"uniform-short-mixed",     KEYS_UNIFORM,   RANGES_SHORT,   90},
+    {"uniform-long-mixed",      KEYS_UNIFORM,   RANGES_LONG,    90},
+    {"uniform-short-write",     KEYS_UNIFORM,   RANGES_SHORT,   50},
+    {"uniform-update",          KEYS_UNIFORM,   RANGES_SHORT,   0},
+    {"zipf-short-read",         KEYS_ZIPF,      RANGES_SHORT,   100},
+    {"zipf-long-mixed",         KEYS_ZIPF,      RANGES_LONG,    90},
+    {"zipf-short-write",        KEYS_ZIPF,      RANGES_SHORT,   50},
+    {"zipf-update",             KEYS_ZIPF,      RANGES_SHORT,   0},
+};
+
+/**
+ * Draws leaves from a Zipf distribution of parameter theta, leaf 0
+ * being the most frequent, in O(1) per draw after an O(n) setup (Gray
+ * et al., "Quickly generating billion-record synthetic databases").
+ *
+ */
+class ZipfGenerator
+{
+
+public:
+
+    ZipfGenerator(std::size_t n, double theta)
+        : n_(n)
+        , theta_(theta)
+        , zetan_(0)
+    {
+        for (std::size_t i = 1; i <= n_; i++)
+            zetan_ += 1.0 / std::pow(double(i), theta_);
+
+        double zeta2 = 1.0 + std::pow(0.5, theta_);
+        alpha_ = 1.0 / (1.0 - theta_);
+        eta_ = (1.0 - std::pow(2.0 / n_, 1.0 - theta_)) / (1.0 - zeta2 / zetan_);
+    }
+
+    std::size_t operator()(std::mt19937_64 &rng)
+    {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * zetan_;
+
+        if (uz < 1.0)
+            return 0;
+        if (uz < 1.0 + std::pow(0.5, theta_))
+            return std::min<std::size_t>(1, n_ - 1);
+        return std::min<std::size_t>(n_ * std::pow(eta_ * u - eta_ + 1.0, alpha_), n_ - 1);
+    }
+
+
+private:
+
+    std::size_t     n_;
+    double          theta_;
+    double          zetan_;
+    double          alpha_;
+    double          eta_;
+};
+
+/**
+ * One operation: a query of [l, r], or an update of leaf l to the
+ * value at index r of the workload's update values.
+ *
+ */
+struct Operation
+{
+    bool            query;
+    std::size_t     l;
+    std::size_t     r;
+};
+
+static std::vector<Operation> MakeOperations(
+            Workload const  &workload,
+            Options const   &options,
+            ZipfGenerator   &zipf,
+            std::size_t     workload_index
+)
+{
+    std::mt19937_64 rng(options.seed * 1000003 + workload_index);
+    std::size_t n = options.leaves;
+    std::vector<Operation> ops(options.ops);
+
+    for (std::size_t i = 0; i < ops.size(); i++)
+    {
+        std::size_t key = workload.keys == KEYS_ZIPF ? zipf(rng) : rng() % n;
+        ops[i].query = int(rng() % 100) < workload.read_pct;
+        ops[i].l = key;
+        ops[i].r = i;
+        if (!ops[i].query)
+            continue;
+
+        std::size_t len = workload.ranges == RANGES_SHORT
+                        ? 1 + rng() % std::min(kShortRange, n)
+                        : n - n / 2 + rng() % (n / 2 + 1);
+        ops[i].l = std::min(key, n - len);
+        ops[i].r = ops[i].l + len - 1;
+    }
+
+    return ops;
+}
+
+
+/*
+ *  ---------------------------
+ *  Cases: Base types and operations
+ *  --------------------------
+ */
+
+static long long Checksum(int const &v) { return v; }
+static long long Checksum(long long const &v) { return v; }
+static long long Checksum(Subarray const &v) { return v.best; }
+
+static int MakeInt(std::mt19937_64 &rng) { return int(rng() % 1000); }
+static long long MakeLong(std::mt19937_64 &rng) { return (long long)(rng() % 1000000000); }
+static Subarray MakeSubarray(std::mt19937_64 &rng)
+{
+    return SubarrayLeaf((long long)(rng() % 2001) - 1000);
+}
+
+struct TreeMode
+{
+    char const      *name;
+    int             type;
+};
+
+static TreeMode const kTreeModes[] = {
+    {"iterative",   TREE_ITERATIVE},
+    {"recursive",   TREE_RECURSIVE},
+    {"wide",        TREE_WIDE},
+    {"blocked",     TREE_BLOCKED},
+    {"compact",     TREE_COMPACT},
+    {"veb",         TREE_VEB},
+};
+
+
+/*
+ *  ---------------------------
+ *  Measurement
+ *  --------------------------
+ */
+
+static double Median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    std::size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+static double Percentile(std::vector<double> const &sorted, double p)
+{
+    std::size_t rank = std::size_t(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+// Runs the operations once on st, timing each into latencies if given
+template <typename Base, typename Op>
+static void RunOperations(
+            SegmentTree<Base, Op>           &st,
+            std::vector<Operation> const    &ops,
+            std::vector<Base> const         &values,
+            double                          *latencies
+)
+{
+    long long checksum = 0;
+
+    for (std::size_t i = 0; i < ops.size(); i++)
+    {
+        Clock::time_point t0 = Clock::now();
+        if (ops[i].query)
+            checksum += Checksum(st.Query(ops[i].l, ops[i].r));
+        else
+            st.Update(values[ops[i].r], ops[i].l);
+        Clock::time_point t1 = Clock::now();
+
+        if (latencies != NULL)
+            latencies[i] = Nanoseconds(t0, t1);
+    }
+
+    sink = checksum;
+}
+
+template <typename Base, typename Op>
+static void RunCase(
+            char const              *case_name,
+            Op                      op,
+            Base                    (*make)(std::mt19937_64 &),
+            Options const           &options,
+            ZipfGenerator           &zipf,
+            std::vector<Result>     &results
+)
+{
+    std::mt19937_64 rng(options.seed);
+    std::vector<Base> leaves(options.leaves);
+    for (std::size_t i = 0; i < leaves.size(); i++)
+        leaves[i] = make(rng);
+
+    // One update value per operation, drawn whether it is used or not
+    std::vector<Base> values(options.ops);
+    for (std::size_t i = 0; i < values.size(); i++)
+        values[i] = make(rng);
+
+    std::size_t workload_count = sizeof(kWorkloads) / sizeof(kWorkloads[0]);
+    for (std::size_t w = 0; w < workload_count; w++)
+    {
+        std::vector<Operation> ops;
+
+        for (TreeMode const &tree_type : kTreeModes)
+        {
+            std::string name = std::string(case_name) + "/" + tree_type.name + "/" + kWorkloads[w].name;
+            if (name.find(options.filter) == std::string::npos)
+                continue;
+            if (ops.empty())
+                ops = MakeOperations(kWorkloads[w], options, zipf, w);
+
+            // Every repetition starts from the same leaves
+            std::vector<double> build_ms, rep_ns;
+            std::vector<double> latencies(options.reps * ops.size());
+
+            for (std::size_t rep = 0; rep < options.warmup + options.reps; rep++)
+            {
+                Clock::time_point t0 = Clock::now();
+                SegmentTree<Base, Op> st{leaves, op, tree_type.type};
+                Clock::time_point t1 = Clock::now();
+
+                if (rep < options.warmup)
+                {
+                    RunOperations(st, ops, values, (double *)NULL);
+                    continue;
+                }
+
+                double *rep_latencies = &latencies[(rep - options.warmup) * ops.size()];
+                RunOperations(st, ops, values, rep_latencies);
+
+                double total = 0;
+                for (std::size_t i = 0; i < ops.size(); i++)
+                    total += rep_latencies[i];
+
+                build_ms.push_back(Nanoseconds(t0, t1) / 1e6);
+                rep_ns.push_back(total / ops.size());
+            }
+
+            std::sort(latencies.begin(), latencies.end());
+
+            Result result;
+            result.name = name;
+            result.build_ms = Median(build_ms);
+            result.ns_per_op = Median(rep_ns);
+            result.ops_per_s = 1e9 / result.ns_per_op;
+            result.p50_ns = Percentile(latencies, 50);
+            result.p90_ns = Percentile(latencies, 90);
+            result.p99_ns = Percentile(latencies, 99);
+            result.max_ns = latencies.back();
+            results.push_back(result);
+
+            if (options.format == "table")
+            {
+                std::printf("%-42s %10.3f %10.1f %12.0f %9.0f %9.0f %9.0f %10.0f\n",
+                            result.name.c_str(), result.build_ms, result.ns_per_op, result.ops_per_s,
+                            result.p50_ns, result.p90_ns, result.p99_ns, result.max_ns);
+                std::fflush(stdout);
+            }
+        }
+    }
+}
+
+// Median cost of the pair of clock reads around every operation
+static double TimerOverhead()
+{
+    std::vector<double> samples(10000);
+    for (std::size_t i = 0; i < samples.size(); i++)
+    {
+        Clock::time_point t0 = Clock::now();
+        Clock::time_point t1 = Clock::now();
+        samples[i] = Nanoseconds(t0, t1);
+    }
+    return Median(samples);
+}
+
+
+/*
+ *  ---------------------------
+ *  Output
+ *  --------------------------
+ */
+
+static void PrintCsv(std::vector<Result> const &results, Options const &options)
+{
+    std::printf("case,type,workload,leaves,ops,reps,seed,build_ms,ns_per_op,ops_per_s,p50_ns,p90_ns,p99_ns,max_ns\n");
+    for (Result const &r : results)
+    {
+        // The name already holds case/type/workload
+        std::string fields = r.name;
+        std::replace(fields.begin(), fields.end(), '/', ',');
+        std::printf("%s,%zu,%zu,%zu,%lu,%.3f,%.1f,%.0f,%.0f,%.0f,%.0f,%.0f\n",
+                    fields.c_str(), options.leaves, options.ops, options.reps, options.seed,
+                    r.build_ms, r.ns_per_op, r.ops_per_s, r.p50_ns, r.p90_ns, r.p99_ns, r.max_ns);
+    }
+}
+
+static void PrintJson(std::vector<Result> const &results, Options const &options, double timer_ns)
+{
+    std::printf("{\n  \"leaves\": %zu,\n  \"ops\": %zu,\n  \"reps\": %zu,\n  \"warmup\": %zu,\n"
+                "  \"seed\": %lu,\n  \"timer_ns\": %.1f,\n  \"results\": [",
+                options.leaves, options.ops, options.reps, options.warmup, options.seed, timer_ns);
+
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        Result const &r = results[i];
+        std::string name = r.name;
+        std::size_t first = name.find('/'), second = name.find('/', first + 1);
+
+        std::printf("%s\n    {\"case\": \"%s\", \"type\": \"%s\", \"workload\": \"%s\", "
+                    "\"build_ms\": %.3f, \"ns_per_op\": %.1f, \"ops_per_s\": %.0f, "
+                    "\"p50_ns\": %.0f, \"p90_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f}",
+                    i == 0 ? "" : ",",
+                    name.substr(0, first).c_str(), name.substr(first + 1, second - first - 1).c_str(),
+                    name.substr(second + 1).c_str(), r.build_ms, r.ns_per_op, r.ops_per_s,
+                    r.p50_ns, r.p90_ns, r.p99_ns, r.max_ns);
+    }
+    std::printf("\n  ]\n}\n");
+}
+
+static void PrintUsage()
+{
+    std::cout<<"Usage: benchmarks [options]\n";
+    std::cout<<"  --leaves <n>      Leaves of every tree (default 1048576)\n";
+    std::cout<<"  --ops <n>         Operations per repetition (default 100000)\n";
+    std::cout<<"  --reps <n>        Timed repetitions (default 5)\n";
+    std::cout<<"  --warmup <n>      Untimed repetitions before them (default 1)\n";
+    std::cout<<"  --seed <n>        Seed of the leaves and operations (default 1)\n";
+    std::cout<<"  --format <f>      table, csv or json (default table)\n";
+    std::cout<<"  --filter <s>      Only runs whose case/type/workload contains s\n";
+    std::cout<<"Cases: int-sum, int-sum-function, int64-min, subarray-max\n";
+    std::cout<<"Types: iterative, recursive, wide, blocked, compact, veb\n";
+    std::cout<<"Workloads:";
+    for (Workload const &workload : kWorkloads)
+        std::cout<<' '<<workload.name;
+    std::cout<<'\n';
+}
+
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    options.leaves = 1 << 20;
+    options.ops = 100000;
+    options.reps = 5;
+    options.warmup = 1;
+    options.seed = 1;
+    options.format = "table";
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--leaves" && has_value)
+            options.leaves = std::strtoull(argv[++i], NULL, 10);
+        else if (arg == "--ops" && has_value)
+            options.ops = std::strtoull(argv[++i], NULL, 10);
+        else if (arg == "--reps" && has_value)
+            options.reps = std::strtoull(argv[++i], NULL, 10);
+        else if (arg == "--warmup" && has_value)
+            options.warmup = std::strtoull(argv[++i], NULL, 10);
+        else if (arg == "--seed" && has_value)
+            options.seed = std::strtoul(argv[++i], NULL, 10);
+        else if (arg == "--format" && has_value)
+            options.format = argv[++i];
+        else if (arg == "--filter" && has_value)
+            options.filter = argv[++i];
+        else
+        {
+            PrintUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    if (options.leaves == 0 || options.ops == 0 || options.reps == 0
+        || (options.format != "table" && options.format != "csv" && options.format != "json"))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    double timer_ns = TimerOverhead();
+    ZipfGenerator zipf(options.leaves, kZipfTheta);
+    std::vector<Result> results;
+
+    if (options.format == "table")
+    {
+        std::printf("%zu leaves, %zu operations, %zu reps after %zu warmup, seed %lu, timer %.1f ns\n",
+                    options.leaves, options.ops, options.reps, options.warmup, options.seed, timer_ns);
+        std::printf("%-42s %10s %10s %12s %9s %9s %9s %10s\n",
+                    "case/type/workload", "build_ms", "ns/op", "ops/s", "p50_ns", "p90_ns", "p99_ns", "max_ns");
+    }
+
+    RunCase<int>("int-sum", SumOp<int>{}, MakeInt, options, zipf, results);
+    RunCase<int>("int-sum-function", std::function<int(int&, int&)>([](int &a, int &b){ return a + b; }),
+                 MakeInt, options, zipf, results);
+    RunCase<long long>("int64-min", MinOp<long long>{}, MakeLong, options, zipf, results);
+    RunCase<Subarray>("subarray-max", SubarrayMerge{}, MakeSubarray, options, zipf, results);
+
+    if (options.format == "csv")
+        PrintCsv(results, options);
+    else if (options.format == "json")
+        PrintJson(results, options, timer_ns);
+
+    return 0;
+}
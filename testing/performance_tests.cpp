@@ -1,8 +1,20 @@
 #include <iostream>
 #include <cstring>
 #include <vector>
+#include <utility>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include <sys/time.h>
 #include "segtree.h"
+#include "concurrentsegtree.h"
+#include "shardedsegtree.h"
+#include "segtree2d.h"
+#include "fenwicktree.h"
+#include "sparsetable.h"
+#include "hugepageallocator.h"
+#include "test_types.h"
+#include <mutex>
 
 using namespace std;
 typedef unsigned long long timestamp_t;
@@ -47,6 +59,76 @@ class BruteForce {
         }
 };
 
+// Query answers are stored here so that the compiler
+// cannot drop the queries being timed.
+volatile int sink;
+
+// Heavy Base types for option 7, each with an operation that returns
+// a new value and one that accumulates in place. Subarray is in
+// test_types.h.
+struct Concat {
+    string operator()(string const &a, string const &b) const { return a + b; }
+};
+struct ConcatInPlace {
+    void operator()(string &acc, string const &b) const { acc += b; }
+};
+
+static int Weight(string const &s) { return s.size(); }
+static int Weight(Subarray const &s) { return s.best; }
+
+// Runs the option 7 workload on one tree and prints its time. Updates
+// pass a fresh copy of a value, moved in when `move` is set.
+template <typename Base, typename Op>
+static void TimeHeavy(vector<Base> const &leaves, vector<tuple<int, int, int>> const &ops, int type, bool move)
+{
+    SegmentTree<Base, Op> st{leaves, Op{}, type};
+    timestamp_t t0 = get_timestamp();
+    int ans = 0;
+    for (size_t i = 0; i < ops.size(); i++)
+    {
+        if (get<0>(ops[i]) == 0)
+            ans += Weight(st.Query(get<1>(ops[i]), get<2>(ops[i])));
+        else
+        {
+            Base value = leaves[get<2>(ops[i])];
+            if (move)
+                st.Update(std::move(value), get<1>(ops[i]));
+            else
+                st.Update(value, get<1>(ops[i]));
+        }
+    }
+    sink = ans;
+    timestamp_t t1 = get_timestamp();
+    cout<<(t1 - t0)/1000000.0L<<'\n';
+}
+
+// Runs the option 13 workload on an iterative tree whose nodes come
+// from alloc, and prints the times of the build, the queries and the
+// updates on one line.
+template <typename Alloc>
+static void TimeAllocator(vector<int> const &leaves, vector<pair<int, int>> const &ranges,
+                          vector<pair<int, int>> const &updates, Alloc const &alloc)
+{
+    timestamp_t t0 = get_timestamp();
+    SegmentTree<int, SumOp<int>, Alloc> st{leaves, SumOp<int>{}, TREE_ITERATIVE, 1, alloc};
+    timestamp_t t1 = get_timestamp();
+    cout<<(t1 - t0)/1000000.0L;
+
+    int ans = 0;
+    t0 = get_timestamp();
+    for (size_t i = 0; i < ranges.size(); i++)
+        ans += st.Query(ranges[i].first, ranges[i].second);
+    t1 = get_timestamp();
+    cout<<' '<<(t1 - t0)/1000000.0L;
+
+    t0 = get_timestamp();
+    for (size_t i = 0; i < updates.size(); i++)
+        st.Update(updates[i].second, updates[i].first);
+    t1 = get_timestamp();
+    cout<<' '<<(t1 - t0)/1000000.0L<<'\n';
+    sink = ans;
+}
+
 vector<tuple <int, int, int>> queries;
 vector<int> init_val;
 
@@ -54,10 +136,21 @@ int main(int argc, char *argv[])
 {
     std::cout<<fixed;
     std::cout.precision(10);
-    if (argc != 3)
+    bool threaded = strcmp(argv[1], "4") == 0 || strcmp(argv[1], "5") == 0 || strcmp(argv[1], "3") == 0;
+    if (argc != 3 && !(argc == 4 && threaded))
     {
-        cout<<"Usage: performance_testing <Process Option> <Number of Elements>\n";
-        cout<<"Process Option: (1) Only query (2) Only update (3) Random queries and updates\n";
+        cout<<"Usage: performance_testing <Process Option> <Number of Elements> [Threads]\n";
+        cout<<"Process Option: (1) Only query (2) Only update\n";
+        cout<<"                (3) Random queries and updates, from 1..Threads threads if given\n";
+        cout<<"                (4) Build with 1..Threads threads (default: all cores)\n";
+        cout<<"                (5) Concurrent stress test, one writer and Threads readers\n";
+        cout<<"                (7) Random queries and updates on strings and structs\n";
+        cout<<"                (8) Random rectangle queries and updates on a grid\n";
+        cout<<"                (9) Fenwick tree against the iterative tree on sums\n";
+        cout<<"                (10) Sparse table against the iterative tree on minimums\n";
+        cout<<"                (11) Recursive against compact recursive layout\n";
+        cout<<"                (12) Iterative and recursive against vEB layout\n";
+        cout<<"                (13) Iterative tree on normal against huge pages\n";
         return 0;
     }
 
@@ -65,6 +158,426 @@ int main(int argc, char *argv[])
 
     int limit = atoi(argv[2]);
 
+    if (strcmp(argv[1], "5") == 0)
+    {
+        // One writer applies 10^5 updates to a ConcurrentSegmentTree
+        // while the readers query it. A reader notes how many updates
+        // had completed before and after each query, so its answer must
+        // match the tree after some number of updates in that window.
+        // That is checked afterwards by replaying the updates on
+        // BruteForce. Prints the time of the concurrent phase, then the
+        // number of answers that match no state in their window.
+        size_t readers = argc == 4 ? atoi(argv[3]) : thread::hardware_concurrency();
+        if (readers == 0)
+            readers = 1;
+
+        struct Answer { int l, r, ans; size_t before, after; };
+        vector<pair<int, int>> updates;
+        vector<vector<Answer>> answers(readers);
+        for (int i = 0; i < 100000; i++)
+            updates.push_back(make_pair(rand()%limit, rand()%5000));
+        for (int i = 0; i < limit; i++)
+            init_val.push_back(rand()%500);
+
+        ConcurrentSegmentTree<int> st{init_val, [](int& f, int& s){return f+s;}, false};
+        atomic<size_t> done(0);
+        atomic<bool> stop(false);
+
+        timestamp_t t0 = get_timestamp();
+        vector<thread> threads;
+        for (size_t t = 0; t < readers; t++)
+        {
+            threads.push_back(thread([&, t]()
+            {
+                unsigned seed = t + 1;
+                while (!stop.load())
+                {
+                    Answer a;
+                    a.l = rand_r(&seed)%limit;
+                    a.r = a.l + rand_r(&seed)%(limit - a.l);
+                    a.before = done.load();
+                    a.ans = st.Query(a.l, a.r);
+                    a.after = done.load();
+                    answers[t].push_back(a);
+                }
+            }));
+        }
+        for (size_t i = 0; i < updates.size(); i++)
+        {
+            st.Update(updates[i].second, updates[i].first);
+            done.store(i + 1);
+        }
+        stop.store(true);
+        for (size_t t = 0; t < readers; t++)
+            threads[t].join();
+        timestamp_t t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+
+        // Replaying the updates, every pending answer is compared with
+        // each state of its window until one matches.
+        vector<Answer> all;
+        for (size_t t = 0; t < readers; t++)
+            all.insert(all.end(), answers[t].begin(), answers[t].end());
+        sort(all.begin(), all.end(), [](Answer const &a, Answer const &b){return a.before < b.before;});
+
+        BruteForce<int> bf{init_val, [](int& f, int& s){return f+s;}};
+        vector<Answer> pending;
+        size_t next = 0, mismatches = 0;
+        for (size_t version = 0; version <= updates.size(); version++)
+        {
+            if (version > 0)
+                bf.Update(updates[version - 1].first, updates[version - 1].second);
+            while (next < all.size() && all[next].before == version)
+                pending.push_back(all[next++]);
+
+            vector<Answer> still_pending;
+            for (size_t i = 0; i < pending.size(); i++)
+            {
+                if (bf.Query(pending[i].l, pending[i].r) == pending[i].ans)
+                    continue;
+                if (pending[i].after + 1 <= version)
+                    mismatches++;
+                else
+                    still_pending.push_back(pending[i]);
+            }
+            pending.swap(still_pending);
+        }
+        cout<<all.size()<<" queries, "<<mismatches + pending.size()<<" mismatches\n";
+        return 0;
+    }
+
+    if (strcmp(argv[1], "7") == 0)
+    {
+        // 10^5 random queries over up to 1000 leaves, with one update
+        // for every nine queries, first on 16 character strings joined
+        // by concatenation, then on maximum subarray structs. Four lines
+        // each: returned values on the iterative and recursive trees,
+        // then in-place operations with moved updates on both.
+        vector<tuple<int, int, int>> ops;
+        for (int i = 0; i < 100000; i++)
+        {
+            int l = rand()%limit;
+            if (rand()%10 != 0)
+                ops.push_back(make_tuple(0, l, min(limit - 1, l + rand()%1000)));
+            else
+                ops.push_back(make_tuple(1, l, rand()%limit));
+        }
+
+        vector<string> strings;
+        vector<Subarray> structs;
+        for (int i = 0; i < limit; i++)
+        {
+            strings.push_back(string(16, 'a' + rand()%26));
+            structs.push_back(SubarrayLeaf(rand()%1000 - 500));
+        }
+
+        TimeHeavy<string, Concat>(strings, ops, TREE_ITERATIVE, false);
+        TimeHeavy<string, Concat>(strings, ops, TREE_RECURSIVE, false);
+        TimeHeavy<string, ConcatInPlace>(strings, ops, TREE_ITERATIVE, true);
+        TimeHeavy<string, ConcatInPlace>(strings, ops, TREE_RECURSIVE, true);
+        TimeHeavy<Subarray, SubarrayMerge>(structs, ops, TREE_ITERATIVE, false);
+        TimeHeavy<Subarray, SubarrayMerge>(structs, ops, TREE_RECURSIVE, false);
+        TimeHeavy<Subarray, SubarrayMergeInPlace>(structs, ops, TREE_ITERATIVE, true);
+        TimeHeavy<Subarray, SubarrayMergeInPlace>(structs, ops, TREE_RECURSIVE, true);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "8") == 0)
+    {
+        // 10^5 random rectangle queries on a grid of <Number of Elements>
+        // rows and as many columns, and one cell update for every nine
+        // queries. Two lines: SegmentTree2D, then one SegmentTree per
+        // row queried row by row.
+        vector<tuple<int, int, int, int, int>> ops;
+        for (int i = 0; i < 100000; i++)
+        {
+            int x = rand()%limit, y = rand()%limit;
+            if (rand()%10 != 0)
+                ops.push_back(make_tuple(x, y, x + rand()%(limit - x), y + rand()%(limit - y), -1));
+            else
+                ops.push_back(make_tuple(x, y, x, y, rand()%500));
+        }
+
+        vector<vector<int>> grid(limit, vector<int>(limit));
+        for (int x = 0; x < limit; x++)
+            for (int y = 0; y < limit; y++)
+                grid[x][y] = rand()%500;
+
+        SegmentTree2D<int, SumOp<int>> st2d{grid, SumOp<int>{}};
+        timestamp_t t0 = get_timestamp();
+        int ans = 0;
+        for (size_t i = 0; i < ops.size(); i++)
+        {
+            if (get<4>(ops[i]) < 0)
+                ans += st2d.Query(get<0>(ops[i]), get<1>(ops[i]), get<2>(ops[i]), get<3>(ops[i]));
+            else
+                st2d.Update(get<0>(ops[i]), get<1>(ops[i]), get<4>(ops[i]));
+        }
+        sink = ans;
+        timestamp_t t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+
+        vector<SegmentTree<int, SumOp<int>>> st_rows;
+        for (int x = 0; x < limit; x++)
+            st_rows.push_back(SegmentTree<int, SumOp<int>>(grid[x], SumOp<int>{}, TREE_ITERATIVE));
+        t0 = get_timestamp();
+        ans = 0;
+        for (size_t i = 0; i < ops.size(); i++)
+        {
+            if (get<4>(ops[i]) < 0)
+                for (int x = get<0>(ops[i]); x <= get<2>(ops[i]); x++)
+                    ans += st_rows[x].Query(get<1>(ops[i]), get<3>(ops[i]));
+            else
+                st_rows[get<0>(ops[i])].Update(get<4>(ops[i]), get<1>(ops[i]));
+        }
+        sink = ans;
+        t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+        return 0;
+    }
+
+    if (strcmp(argv[1], "9") == 0)
+    {
+        // 10^5 random updates, then 10^5 random queries and updates as
+        // in option 3, of integer sums. Four lines: updates on a
+        // FenwickTree, then on an iterative SegmentTree, then the mix on
+        // each. The Fenwick tree holds n values where the other holds 2n.
+        vector<pair<int, int>> updates;
+        vector<tuple<int, int, int>> mixed;
+        for (int i = 0; i < 100000; i++)
+        {
+            updates.push_back(make_pair(rand()%limit, rand()%500));
+            int l = rand()%limit;
+            if (rand()%2)
+                mixed.push_back(make_tuple(0, l, l + rand()%(limit - l)));
+            else
+                mixed.push_back(make_tuple(1, l, rand()%500));
+        }
+        for (int i = 0; i < limit; i++)
+            init_val.push_back(rand()%500);
+
+        FenwickTree<int, SumOp<int>, DifferenceOp<int>> ft{init_val, SumOp<int>{}, DifferenceOp<int>{}};
+        SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, TREE_ITERATIVE};
+
+        timestamp_t t0 = get_timestamp();
+        for (size_t i = 0; i < updates.size(); i++)
+            ft.Update(updates[i].second, updates[i].first);
+        timestamp_t t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+
+        t0 = get_timestamp();
+        for (size_t i = 0; i < updates.size(); i++)
+            st.Update(updates[i].second, updates[i].first);
+        t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+
+        int ans = 0;
+        t0 = get_timestamp();
+        for (size_t i = 0; i < mixed.size(); i++)
+        {
+            if (get<0>(mixed[i]) == 0)
+                ans += ft.Query(get<1>(mixed[i]), get<2>(mixed[i]));
+            else
+                ft.Update(get<2>(mixed[i]), get<1>(mixed[i]));
+        }
+        t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+
+        t0 = get_timestamp();
+        for (size_t i = 0; i < mixed.size(); i++)
+        {
+            if (get<0>(mixed[i]) == 0)
+                ans -= st.Query(get<1>(mixed[i]), get<2>(mixed[i]));
+            else
+                st.Update(get<2>(mixed[i]), get<1>(mixed[i]));
+        }
+        t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+
+        // Both trees saw the same operations, so the answers cancel
+        sink = ans;
+        if (ans != 0)
+            cout<<"The answers of the two trees differ\n";
+        return 0;
+    }
+
+    if (strcmp(argv[1], "10") == 0)
+    {
+        // 10^5 random minimum queries over the whole range of leaves.
+        // Two lines: SparseTable, then an iterative SegmentTree.
+        vector<pair<int, int>> ranges;
+        for (int i = 0; i < 100000; i++)
+        {
+            int l = rand()%limit;
+            ranges.push_back(make_pair(l, l + rand()%(limit - l)));
+        }
+        for (int i = 0; i < limit; i++)
+            init_val.push_back(rand()%1000000);
+
+        SparseTable<int, MinOp<int>> table{init_val, MinOp<int>{}};
+        SegmentTree<int, MinOp<int>> st{init_val, MinOp<int>{}, TREE_ITERATIVE};
+
+        int ans = 0;
+        timestamp_t t0 = get_timestamp();
+        for (size_t i = 0; i < ranges.size(); i++)
+            ans += table.Query(ranges[i].first, ranges[i].second);
+        timestamp_t t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+
+        t0 = get_timestamp();
+        for (size_t i = 0; i < ranges.size(); i++)
+            ans -= st.Query(ranges[i].first, ranges[i].second);
+        t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+
+        sink = ans;
+        if (ans != 0)
+            cout<<"The answers of the two trees differ\n";
+        return 0;
+    }
+
+    if (strcmp(argv[1], "11") == 0)
+    {
+        // The heap ordered TREE_RECURSIVE against TREE_COMPACT, on
+        // integer sums. One line each: nodes stored, then the times of
+        // the build, of 10^5 random queries and of 10^5 random updates.
+        vector<pair<int, int>> ranges, updates;
+        for (int i = 0; i < 100000; i++)
+        {
+            int l = rand()%limit;
+            ranges.push_back(make_pair(l, l + rand()%(limit - l)));
+            updates.push_back(make_pair(rand()%limit, rand()%500));
+        }
+        for (int i = 0; i < limit; i++)
+            init_val.push_back(rand()%500);
+
+        int types[] = {TREE_RECURSIVE, TREE_COMPACT};
+        int ans = 0;
+        for (int t = 0; t < 2; t++)
+        {
+            size_t nodes = types[t] == TREE_COMPACT ? 2 * (size_t)limit - 1
+                                                    : SegmentTree<int, SumOp<int>>::GetTreeSize(limit);
+            cout<<nodes;
+
+            timestamp_t t0 = get_timestamp();
+            SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, types[t]};
+            timestamp_t t1 = get_timestamp();
+            cout<<' '<<(t1 - t0)/1000000.0L;
+
+            t0 = get_timestamp();
+            for (size_t i = 0; i < ranges.size(); i++)
+                ans += st.Query(ranges[i].first, ranges[i].second);
+            t1 = get_timestamp();
+            cout<<' '<<(t1 - t0)/1000000.0L;
+
+            t0 = get_timestamp();
+            for (size_t i = 0; i < updates.size(); i++)
+                st.Update(updates[i].second, updates[i].first);
+            t1 = get_timestamp();
+            cout<<' '<<(t1 - t0)/1000000.0L<<'\n';
+        }
+        sink = ans;
+        return 0;
+    }
+
+    if (strcmp(argv[1], "12") == 0)
+    {
+        // TREE_ITERATIVE, TREE_RECURSIVE and TREE_VEB on integer sums,
+        // meant for trees larger than the last level cache. One line
+        // each: the times of the build, of 10^5 random queries and of
+        // 10^5 random updates. One tree is held at a time.
+        vector<pair<int, int>> ranges, updates;
+        for (int i = 0; i < 100000; i++)
+        {
+            int l = rand()%limit;
+            ranges.push_back(make_pair(l, l + rand()%(limit - l)));
+            updates.push_back(make_pair(rand()%limit, rand()%500));
+        }
+        for (int i = 0; i < limit; i++)
+            init_val.push_back(rand()%500);
+
+        int types[] = {TREE_ITERATIVE, TREE_RECURSIVE, TREE_VEB};
+        int ans = 0;
+        for (int t = 0; t < 3; t++)
+        {
+            timestamp_t t0 = get_timestamp();
+            SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, types[t]};
+            timestamp_t t1 = get_timestamp();
+            cout<<(t1 - t0)/1000000.0L;
+
+            t0 = get_timestamp();
+            for (size_t i = 0; i < ranges.size(); i++)
+                ans += st.Query(ranges[i].first, ranges[i].second);
+            t1 = get_timestamp();
+            cout<<' '<<(t1 - t0)/1000000.0L;
+
+            t0 = get_timestamp();
+            for (size_t i = 0; i < updates.size(); i++)
+                st.Update(updates[i].second, updates[i].first);
+            t1 = get_timestamp();
+            cout<<' '<<(t1 - t0)/1000000.0L<<'\n';
+        }
+        sink = ans;
+        return 0;
+    }
+
+    if (strcmp(argv[1], "13") == 0)
+    {
+        // The iterative tree on integer sums, its nodes from
+        // std::allocator, then HugePageAllocator with transparent and
+        // with explicit huge pages. One line each, as in option 12.
+        vector<pair<int, int>> ranges, updates;
+        for (int i = 0; i < 1000000; i++)
+        {
+            int l = rand()%limit;
+            ranges.push_back(make_pair(l, l + rand()%(limit - l)));
+            updates.push_back(make_pair(rand()%limit, rand()%500));
+        }
+        for (int i = 0; i < limit; i++)
+            init_val.push_back(rand()%500);
+
+        TimeAllocator(init_val, ranges, updates, std::allocator<int>());
+        TimeAllocator(init_val, ranges, updates, HugePageAllocator<int>(HUGE_PAGES_TRANSPARENT));
+        TimeAllocator(init_val, ranges, updates, HugePageAllocator<int>(HUGE_PAGES_EXPLICIT));
+        return 0;
+    }
+
+    if (strcmp(argv[1], "4") == 0)
+    {
+        // Build scaling: one line per thread count, with the build times
+        // of the iterative and recursive trees, std::function then SumOp.
+        size_t max_threads = argc == 4 ? atoi(argv[3]) : thread::hardware_concurrency();
+        if (max_threads == 0)
+            max_threads = 1;
+
+        init_val.clear();
+        for (int i = 0; i < limit; i++)
+            init_val.push_back(rand()%500);
+
+        for (size_t threads = 1; threads <= max_threads; threads++)
+        {
+            cout<<threads;
+            for (int type = 0; type < 2; type++)
+            {
+                timestamp_t t0 = get_timestamp();
+                SegmentTree<int> st{init_val, [](int& f, int& s){return f+s;}, type, threads};
+                sink = st.Query(0, limit - 1);
+                timestamp_t t1 = get_timestamp();
+                cout<<' '<<(t1 - t0)/1000000.0L;
+            }
+            for (int type = 0; type < 2; type++)
+            {
+                timestamp_t t0 = get_timestamp();
+                SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, type, threads};
+                sink = st.Query(0, limit - 1);
+                timestamp_t t1 = get_timestamp();
+                cout<<' '<<(t1 - t0)/1000000.0L;
+            }
+            cout<<'\n';
+        }
+        return 0;
+    }
+
     if (strcmp(argv[1], "1") == 0)
     {
         for (int i = 0; i < 100000; i++)
@@ -108,6 +621,63 @@ int main(int argc, char *argv[])
         init_val.push_back(val);
     }
 
+    if (strcmp(argv[1], "3") == 0 && argc == 4)
+    {
+        // The same workload split across 1..Threads threads. One line
+        // per thread count: a SegmentTree behind a single mutex, then a
+        // ShardedSegmentTree with 8 shards per thread.
+        size_t max_threads = atoi(argv[3]);
+        if (max_threads == 0)
+            max_threads = 1;
+
+        for (size_t threads = 1; threads <= max_threads; threads++)
+        {
+            cout<<threads;
+
+            SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, false};
+            ShardedSegmentTree<int, SumOp<int>> sh{init_val, SumOp<int>{}, false, 8 * threads};
+            mutex st_lock;
+
+            for (int variant = 0; variant < 2; variant++)
+            {
+                timestamp_t t0 = get_timestamp();
+                vector<thread> workers;
+                for (size_t t = 0; t < threads; t++)
+                {
+                    workers.push_back(thread([&, t]()
+                    {
+                        int ans = 0;
+                        for (size_t i = t; i < 100000; i += threads)
+                        {
+                            if (variant == 0)
+                            {
+                                lock_guard<mutex> lock(st_lock);
+                                if(get<0>(queries[i]) == 0)
+                                    ans += st.Query(get<1>(queries[i]), get<2>(queries[i]));
+                                else
+                                    st.Update(get<2>(queries[i]), get<1>(queries[i]));
+                            }
+                            else
+                            {
+                                if(get<0>(queries[i]) == 0)
+                                    ans += sh.Query(get<1>(queries[i]), get<2>(queries[i]));
+                                else
+                                    sh.Update(get<2>(queries[i]), get<1>(queries[i]));
+                            }
+                        }
+                        sink = ans;
+                    }));
+                }
+                for (size_t t = 0; t < threads; t++)
+                    workers[t].join();
+                timestamp_t t1 = get_timestamp();
+                cout<<' '<<(t1 - t0)/1000000.0L;
+            }
+            cout<<'\n';
+        }
+        return 0;
+    }
+
     {
         timestamp_t t0 = get_timestamp();
         //Segment Tree Iterative
@@ -115,8 +685,7 @@ int main(int argc, char *argv[])
         for (int i = 0; i < 100000; i++)
         {
             if(get<0>(queries[i]) == 0){
-                auto ans = st.Query(get<1>(queries[i]), get<2>(queries[i]));
-                //cout<<ans<<'\n';
+                sink = st.Query(get<1>(queries[i]), get<2>(queries[i]));
             }
             else
                 st.Update(get<2>(queries[i]), get<1>(queries[i]));
@@ -132,8 +701,7 @@ int main(int argc, char *argv[])
         for (int i = 0; i < 100000; i++)
         {
             if(get<0>(queries[i]) == 0){
-                auto ans = st.Query(get<1>(queries[i]), get<2>(queries[i]));
-                //cout<<ans<<'\n';
+                sink = st.Query(get<1>(queries[i]), get<2>(queries[i]));
             }
             else
                 st.Update(get<2>(queries[i]), get<1>(queries[i]));
@@ -149,8 +717,7 @@ int main(int argc, char *argv[])
         for (int i = 0; i < 100000; i++)
         {
             if(get<0>(queries[i]) == 0){
-                auto ans = st.Query(get<1>(queries[i]), get<2>(queries[i]));
-                //cout<<ans<<'\n';
+                sink = st.Query(get<1>(queries[i]), get<2>(queries[i]));
             }
             else
                 st.Update(get<1>(queries[i]), get<2>(queries[i]));
@@ -159,4 +726,163 @@ int main(int argc, char *argv[])
         cout<<(t1 - t0)/1000000.0L<<'\n';
 
     }
+
+    {
+        timestamp_t t0 = get_timestamp();
+        //Segment Tree Iterative, operation resolved at compile time
+        SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, false};
+        for (int i = 0; i < 100000; i++)
+        {
+            if(get<0>(queries[i]) == 0){
+                sink = st.Query(get<1>(queries[i]), get<2>(queries[i]));
+            }
+            else
+                st.Update(get<2>(queries[i]), get<1>(queries[i]));
+        }
+        timestamp_t t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+    }
+
+    {
+        timestamp_t t0 = get_timestamp();
+        //Segment Tree Recursive, operation resolved at compile time
+        SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, true};
+        for (int i = 0; i < 100000; i++)
+        {
+            if(get<0>(queries[i]) == 0){
+                sink = st.Query(get<1>(queries[i]), get<2>(queries[i]));
+            }
+            else
+                st.Update(get<2>(queries[i]), get<1>(queries[i]));
+        }
+        timestamp_t t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+    }
+
+    {
+        timestamp_t t0 = get_timestamp();
+        //Segment Tree Wide
+        SegmentTree<int> st{init_val, [](int& f, int& s){return f+s;}, TREE_WIDE};
+        for (int i = 0; i < 100000; i++)
+        {
+            if(get<0>(queries[i]) == 0){
+                sink = st.Query(get<1>(queries[i]), get<2>(queries[i]));
+            }
+            else
+                st.Update(get<2>(queries[i]), get<1>(queries[i]));
+        }
+        timestamp_t t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+    }
+
+    {
+        timestamp_t t0 = get_timestamp();
+        //Segment Tree Wide, operation resolved at compile time
+        SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, TREE_WIDE};
+        for (int i = 0; i < 100000; i++)
+        {
+            if(get<0>(queries[i]) == 0){
+                sink = st.Query(get<1>(queries[i]), get<2>(queries[i]));
+            }
+            else
+                st.Update(get<2>(queries[i]), get<1>(queries[i]));
+        }
+        timestamp_t t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+    }
+
+    {
+        timestamp_t t0 = get_timestamp();
+        //Segment Tree Blocked
+        SegmentTree<int> st{init_val, [](int& f, int& s){return f+s;}, TREE_BLOCKED};
+        for (int i = 0; i < 100000; i++)
+        {
+            if(get<0>(queries[i]) == 0){
+                sink = st.Query(get<1>(queries[i]), get<2>(queries[i]));
+            }
+            else
+                st.Update(get<2>(queries[i]), get<1>(queries[i]));
+        }
+        timestamp_t t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+    }
+
+    {
+        timestamp_t t0 = get_timestamp();
+        //Segment Tree Blocked, operation resolved at compile time
+        SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, TREE_BLOCKED};
+        for (int i = 0; i < 100000; i++)
+        {
+            if(get<0>(queries[i]) == 0){
+                sink = st.Query(get<1>(queries[i]), get<2>(queries[i]));
+            }
+            else
+                st.Update(get<2>(queries[i]), get<1>(queries[i]));
+        }
+        timestamp_t t1 = get_timestamp();
+        cout<<(t1 - t0)/1000000.0L<<'\n';
+    }
+
+    if (strcmp(argv[1], "1") == 0)
+    {
+        // Same queries answered in one QueryBatch call, compared
+        // against the iterative query loops above.
+        vector<pair<size_t, size_t>> ranges;
+        vector<int> results;
+        for (int i = 0; i < 100000; i++)
+            ranges.push_back(make_pair(get<1>(queries[i]), get<2>(queries[i])));
+
+        {
+            SegmentTree<int> st{init_val, [](int& f, int& s){return f+s;}, false};
+            timestamp_t t0 = get_timestamp();
+            //Segment Tree Iterative, batched queries
+            st.QueryBatch(ranges, results);
+            sink = results.back();
+            timestamp_t t1 = get_timestamp();
+            cout<<(t1 - t0)/1000000.0L<<'\n';
+        }
+
+        {
+            SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, false};
+            timestamp_t t0 = get_timestamp();
+            //Segment Tree Iterative, batched queries, compile-time operation
+            st.QueryBatch(ranges, results);
+            sink = results.back();
+            timestamp_t t1 = get_timestamp();
+            cout<<(t1 - t0)/1000000.0L<<'\n';
+        }
+    }
+
+    if (strcmp(argv[1], "2") == 0)
+    {
+        // Same updates applied through a single UpdateBatch call,
+        // compared against the iterative update loops above.
+        vector<size_t> indices;
+        vector<int> values;
+        for (int i = 0; i < 100000; i++)
+        {
+            indices.push_back(get<1>(queries[i]));
+            values.push_back(get<2>(queries[i]));
+        }
+
+        {
+            SegmentTree<int> st{init_val, [](int& f, int& s){return f+s;}, false};
+            timestamp_t t0 = get_timestamp();
+            //Segment Tree Iterative, batched updates
+            st.UpdateBatch(indices, values);
+            sink = st.Query(0, limit - 1);
+            timestamp_t t1 = get_timestamp();
+            cout<<(t1 - t0)/1000000.0L<<'\n';
+        }
+
+        {
+            SegmentTree<int, SumOp<int>> st{init_val, SumOp<int>{}, false};
+            timestamp_t t0 = get_timestamp();
+            //Segment Tree Iterative, batched updates, compile-time operation
+            st.UpdateBatch(indices, values);
+            sink = st.Query(0, limit - 1);
+            timestamp_t t1 = get_timestamp();
+            cout<<(t1 - t0)/1000000.0L<<'\n';
+        }
+    }
 }
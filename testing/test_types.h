@@ -0,0 +1,55 @@
+/**
+ * Base types shared by the performance tests and the benchmarks.
+ *
+ * Subarray answers the maximum sum subarray of a range, with the sum,
+ * best prefix, best suffix and best subarray of its leaves.
+ * SubarrayMerge returns the merged value, and SubarrayMergeInPlace
+ * accumulates into its left operand.
+ *
+ */
+
+#ifndef _TEST_TYPES_H_
+#define _TEST_TYPES_H_
+
+#include <algorithm>
+
+struct Subarray { long long sum, pre, suf, best; };
+
+/**
+ * Returns the leaf of value v, whose only subarray is v itself.
+ *
+ */
+inline Subarray SubarrayLeaf(long long v)
+{
+    Subarray leaf = {v, v, v, v};
+    return leaf;
+}
+
+struct SubarrayMerge
+{
+    Subarray operator()(Subarray const &a, Subarray const &b) const
+    {
+        Subarray r = {a.sum + b.sum, std::max(a.pre, a.sum + b.pre), std::max(b.suf, a.suf + b.sum),
+                      std::max(std::max(a.best, b.best), a.suf + b.pre)};
+        return r;
+    }
+
+    // Of non-empty subarrays: far below any sum, without overflowing
+    // when added to one.
+    static Subarray Identity() { Subarray r = {0, -(1LL << 50), -(1LL << 50), -(1LL << 50)}; return r; }
+};
+
+struct SubarrayMergeInPlace
+{
+    void operator()(Subarray &acc, Subarray const &b) const
+    {
+        acc.best = std::max(std::max(acc.best, b.best), acc.suf + b.pre);
+        acc.pre = std::max(acc.pre, acc.sum + b.pre);
+        acc.suf = std::max(b.suf, acc.suf + b.sum);
+        acc.sum += b.sum;
+    }
+
+    static Subarray Identity() { return SubarrayMerge::Identity(); }
+};
+
+#endif
@@ -1,7 +1,26 @@
 #include <iostream>
 #include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <sstream>
+#include <stdexcept>
+#include <map>
+#include <atomic>
+#include <thread>
 
 #include "segtree.h"
+#include "lazysegtree.h"
+#include "concurrentsegtree.h"
+#include "shardedsegtree.h"
+#include "persistentsegtree.h"
+#include "sparsesegtree.h"
+#include "slidingwindowtree.h"
+#include "segtree2d.h"
+#include "fenwicktree.h"
+#include "sparsetable.h"
+#include "hugepageallocator.h"
 
 
 /*
@@ -382,6 +401,1829 @@ int test_FunctionPointer_MaximumSubarray(){
 }
 
 
+/*
+ *  ---------------------------
+ *  TEST5 : Compile-time operation policies (min / sum)
+ *  --------------------------
+ */
+
+int test_Policy_MinAndSum(){
+    std::vector<int> value_vec;
+    for(int i = 0; i < 13; i++){
+        value_vec.push_back(-500 + rand() % 1000);
+    }
+
+    SegmentTree<int, MinOp<int>> s_tree1 = {value_vec, MinOp<int>{}, true};
+    SegmentTree<int, MinOp<int>> s_tree2 = {value_vec, MinOp<int>{}, false};
+    SegmentTree<int, SumOp<int>> s_tree3 = {0, 13, SumOp<int>{}, true};
+    SegmentTree<int, SumOp<int>> s_tree4 = {0, 13, SumOp<int>{}, false};
+
+    for(int i = 0; i < 13; i++){
+        s_tree3.Update(value_vec[i], i);
+        s_tree4.Update(value_vec[i], i);
+    }
+
+    for(int i = 0; i < 20; i++){
+        if(i == 10){
+            int ind = rand() % 13;
+            value_vec[ind] = -500 + rand() % 1000;
+            s_tree1.Update(value_vec[ind], ind);
+            s_tree2.Update(value_vec[ind], ind);
+            s_tree3.Update(value_vec[ind], ind);
+            s_tree4.Update(value_vec[ind], ind);
+        }
+
+        int r_ind = rand() % 13;
+        int l_ind = rand() % (13 - r_ind);
+        if(l_ind > r_ind) std::swap(l_ind, r_ind);
+
+        int min_ans = value_vec[l_ind], sum_ans = 0;
+        for(int j = l_ind; j <= r_ind; j++){
+            min_ans = std::min(min_ans, value_vec[j]);
+            sum_ans += value_vec[j];
+        }
+
+        // The iterative min tree only answers correctly because the
+        // policy identity (INT_MAX) replaces `int{}`.
+        if(min_ans != s_tree1.Query(l_ind, r_ind) || min_ans != s_tree2.Query(l_ind, r_ind)){
+            std::cerr << "test_Policy_MinAndSum:\n\tMinimum queries do not match.\n";
+            return 0;
+        }
+        if(sum_ans != s_tree3.Query(l_ind, r_ind) || sum_ans != s_tree4.Query(l_ind, r_ind)){
+            std::cerr << "test_Policy_MinAndSum:\n\tSum queries do not match.\n";
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST6 : Lazy range add / sum and range assign / concatenation
+ *  --------------------------
+ */
+
+int test_Lazy_RangeUpdates(){
+    std::vector<long long> value_vec;
+    for(int i = 0; i < 11; i++){
+        value_vec.push_back(rand() % 1000);
+    }
+
+    auto add_sum = [](long long &a, long long &b){ return a + b; };
+    auto add_apply = [](long long &sum, long long &add, std::size_t count){ return sum + add * (long long)count; };
+
+    LazySegmentTree<long long, long long> s_tree1 = {value_vec, add_sum, add_apply, add_sum, true};
+    LazySegmentTree<long long, long long> s_tree2 = {value_vec, add_sum, add_apply, add_sum, false};
+
+    // Non commutative: a range assign must land in the right order
+    // within the concatenation.
+    auto concat = [](std::string &a, std::string &b){ return a + b; };
+    auto assign_apply = [](std::string &, char &c, std::size_t count){ return std::string(count, c); };
+    auto assign_compose = [](char &, char &newer){ return newer; };
+
+    std::vector<std::string> str_vec(11, "x");
+    LazySegmentTree<std::string, char> s_tree3 = {"x", 11, concat, assign_apply, assign_compose, true};
+    LazySegmentTree<std::string, char> s_tree4 = {"x", 11, concat, assign_apply, assign_compose, false};
+
+    for(int i = 0; i < 50; i++){
+        int r_ind = rand() % 11;
+        int l_ind = rand() % (11 - r_ind);
+        if(l_ind > r_ind) std::swap(l_ind, r_ind);
+
+        if(i % 3 == 0){
+            long long add = rand() % 100;
+            char c = 'a' + rand() % 26;
+            s_tree1.RangeUpdate(l_ind, r_ind, add);
+            s_tree2.RangeUpdate(l_ind, r_ind, add);
+            s_tree3.RangeUpdate(l_ind, r_ind, c);
+            s_tree4.RangeUpdate(l_ind, r_ind, c);
+            for(int j = l_ind; j <= r_ind; j++){
+                value_vec[j] += add;
+                str_vec[j] = std::string(1, c);
+            }
+            continue;
+        }
+        if(i % 7 == 0){
+            value_vec[l_ind] = rand() % 1000;
+            str_vec[l_ind] = "z";
+            s_tree1.Update(value_vec[l_ind], l_ind);
+            s_tree2.Update(value_vec[l_ind], l_ind);
+            s_tree3.Update("z", l_ind);
+            s_tree4.Update("z", l_ind);
+            continue;
+        }
+
+        long long sum_ans = 0;
+        std::string str_ans = "";
+        for(int j = l_ind; j <= r_ind; j++){
+            sum_ans += value_vec[j];
+            str_ans += str_vec[j];
+        }
+
+        if(sum_ans != s_tree1.Query(l_ind, r_ind) || sum_ans != s_tree2.Query(l_ind, r_ind)){
+            std::cerr << "test_Lazy_RangeUpdates:\n\tRange add / sum queries do not match.\n";
+            return 0;
+        }
+        if(str_ans != s_tree3.Query(l_ind, r_ind) || str_ans != s_tree4.Query(l_ind, r_ind)){
+            std::cerr << "test_Lazy_RangeUpdates:\n\tRange assign / concatenation queries do not match.\n";
+            return 0;
+        }
+    }
+
+    // Without leaves, neither constructor may build a tree, on either type
+    for(int type = 0; type < 2; type++){
+        try{
+            LazySegmentTree<long long, long long> s_tree5 = {std::vector<long long>(), add_sum, add_apply, add_sum, type == 1};
+            std::cerr << "test_Lazy_RangeUpdates:\n\tEmpty vector did not throw.\n";
+            return 0;
+        }
+        catch(std::invalid_argument const &){
+        }
+        try{
+            LazySegmentTree<long long, long long> s_tree6 = {0, 0, add_sum, add_apply, add_sum, type == 1};
+            std::cerr << "test_Lazy_RangeUpdates:\n\tZero length did not throw.\n";
+            return 0;
+        }
+        catch(std::invalid_argument const &){
+        }
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST7 : Batched queries against single queries
+ *  --------------------------
+ */
+
+int test_QueryBatch_StringConcatenation(){
+    std::vector<std::string> value_vec;
+    for(int i = 0; i < 37; i++){
+        value_vec.push_back(std::string(1, 'a' + rand() % 26));
+    }
+
+    SegmentTree<std::string> s_tree1 = {value_vec, addString{}, true};
+    SegmentTree<std::string> s_tree2 = {value_vec, addString{}, false};
+
+    std::vector<std::pair<std::size_t, std::size_t> > ranges;
+    for(int i = 0; i < 100; i++){
+        int r_ind = rand() % 37;
+        int l_ind = rand() % (37 - r_ind);
+        if(l_ind > r_ind) std::swap(l_ind, r_ind);
+        ranges.push_back(std::make_pair(l_ind, r_ind));
+    }
+    // repeated range
+    ranges.push_back(ranges[0]);
+
+    std::vector<std::string> results1, results2;
+    s_tree1.QueryBatch(ranges, results1);
+    s_tree2.QueryBatch(ranges, results2);
+
+    if(results1.size() != ranges.size() || results2.size() != ranges.size()){
+        std::cerr << "test_QueryBatch_StringConcatenation:\n\tWrong number of results.\n";
+        return 0;
+    }
+
+    for(std::size_t i = 0; i < ranges.size(); i++){
+        std::string brute_force_ans = "";
+        for(std::size_t j = ranges[i].first; j <= ranges[i].second; j++){
+            brute_force_ans += value_vec[j];
+        }
+
+        if(brute_force_ans != results1[i] || brute_force_ans != results2[i]){
+            std::cerr << "test_QueryBatch_StringConcatenation:\n\tBatched queries do not match.\n";
+            return 0;
+        }
+    }
+
+    // A single invalid range rejects the whole batch
+    ranges.push_back(std::make_pair(3, 37));
+    try{
+        s_tree2.QueryBatch(ranges, results2);
+        std::cerr << "test_QueryBatch_StringConcatenation:\n\tOut of range batch was accepted.\n";
+        return 0;
+    }
+    catch(std::out_of_range const &){
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST8 : Batched point updates and contiguous overwrites
+ *  --------------------------
+ */
+
+int test_UpdateBatch_MaximumSubarray(){
+    std::vector<NodeEle> value_vec;
+    for(int i = 0; i < 21; i++){
+        value_vec.push_back(NodeEle(-500 + rand() % 1000));
+    }
+
+    SegmentTree<NodeEle> s_tree1 = {value_vec, combine, true};
+    SegmentTree<NodeEle> s_tree2 = {value_vec, combine, false};
+
+    for(int i = 0; i < 20; i++){
+        if(i % 2 == 0){
+            // repeated indices are likely, the last value must win
+            std::vector<std::size_t> indices;
+            std::vector<NodeEle> values;
+            for(int j = 0; j < 8; j++){
+                indices.push_back(rand() % 21);
+                values.push_back(NodeEle(-500 + rand() % 1000));
+                value_vec[indices.back()] = values.back();
+            }
+            s_tree1.UpdateBatch(indices, values);
+            s_tree2.UpdateBatch(indices, values);
+        }
+        else{
+            int first = rand() % 21;
+            std::vector<NodeEle> values;
+            for(int j = first; j < 21 && j < first + 6; j++){
+                values.push_back(NodeEle(-500 + rand() % 1000));
+                value_vec[j] = values.back();
+            }
+            s_tree1.Assign(first, values.begin(), values.end());
+            s_tree2.Assign(first, values.begin(), values.end());
+        }
+
+        for(int k = 0; k < 5; k++){
+            int r_ind = rand() % 21;
+            int l_ind = rand() % (21 - r_ind);
+            if(l_ind > r_ind) std::swap(l_ind, r_ind);
+
+            int ans = 0, cur = 0;
+            for(int j = l_ind; j <= r_ind; j++){
+                cur += value_vec[j].tot;
+                ans = std::max(ans, cur);
+                if (cur < 0) cur = 0;
+            }
+
+            if(ans != s_tree1.Query(l_ind, r_ind).bst || ans != s_tree2.Query(l_ind, r_ind).bst){
+                std::cerr << "test_UpdateBatch_MaximumSubarray:\n\tQueries after batched updates do not match.\n";
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST9 : Wide layout, std::string concatenation
+ *  --------------------------
+ */
+
+int test_Wide_StringConcatenation(){
+    // Enough leaves for three levels of wide nodes, and not
+    // a multiple of the fan-out, so every level is padded.
+    std::size_t len = 300;
+    std::vector<std::string> value_vec;
+    for(std::size_t i = 0; i < len; i++){
+        value_vec.push_back(std::string(1, 'a' + rand() % 26));
+    }
+
+    SegmentTree<std::string> s_tree1 = {value_vec, addString{}, TREE_WIDE};
+    SegmentTree<std::string> s_tree2 = {"", len, addString{}, TREE_WIDE};
+
+    for(std::size_t i = 0; i < len; i++){
+        s_tree2.Update(value_vec[i], i);
+    }
+
+    for(int i = 0; i < 60; i++){
+        if(i == 30){
+            for(int j = 0; j < 10; j++){
+                int ind = rand() % len;
+                value_vec[ind] = "PaaMAwI";
+                s_tree1.Update(value_vec[ind], ind);
+                s_tree2.Update(value_vec[ind], ind);
+            }
+        }
+
+        int r_ind = rand() % len;
+        int l_ind = rand() % (len - r_ind);
+        if(l_ind > r_ind) std::swap(l_ind, r_ind);
+
+        std::string brute_force_ans = "";
+        for(int j = l_ind; j <= r_ind; j++){
+            brute_force_ans += value_vec[j];
+        }
+
+        if(brute_force_ans != s_tree1.Query(l_ind, r_ind)){
+            std::cerr << "test_Wide_StringConcatenation:\n\tQueries do not match "
+                "for vector initialized segment tree.\n";
+            return 0;
+        }
+        if(brute_force_ans != s_tree2.Query(l_ind, r_ind)){
+            std::cerr << "test_Wide_StringConcatenation:\n\tQueries do not match "
+                "for value initialized segment tree.\n";
+            return 0;
+        }
+    }
+
+    // A lambda declares no identity, so Base{} = 0 must not leak into
+    // the maximum of negative leaves.
+    SegmentTree<int> s_tree3 = {-5, len, [](int &a, int &b){ return std::max(a, b); }, TREE_WIDE};
+    s_tree3.Update(-3, len - 1);
+    if(s_tree3.Query(0, 0) != -5 || s_tree3.Query(3, len - 2) != -5 || s_tree3.Query(3, len - 1) != -3){
+        std::cerr << "test_Wide_StringConcatenation:\n\tLambda maximum of negative leaves does not match.\n";
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST10 : SIMD kernels, long long maximum and int xor
+ *  --------------------------
+ */
+
+int test_Simd_MaxAndXor(){
+    // Not a multiple of any vector width, so every pass of the build
+    // and most leaf runs end in a scalar tail.
+    std::size_t len = 1003;
+    std::vector<long long> max_vec;
+    std::vector<int> xor_vec;
+    for(std::size_t i = 0; i < len; i++){
+        max_vec.push_back(-(1LL << 40) + rand() % 100000 * 1000003LL);
+        xor_vec.push_back(rand());
+    }
+
+    SegmentTree<long long, MaxOp<long long>> s_tree1 = {max_vec, MaxOp<long long>{}, TREE_ITERATIVE};
+    SegmentTree<long long, MaxOp<long long>> s_tree2 = {max_vec, MaxOp<long long>{}, TREE_WIDE};
+    SegmentTree<int, XorOp<int>> s_tree3 = {xor_vec, XorOp<int>{}, TREE_ITERATIVE};
+    SegmentTree<int, XorOp<int>> s_tree4 = {xor_vec, XorOp<int>{}, TREE_WIDE};
+
+    for(int i = 0; i < 400; i++){
+        if(i % 40 == 0){
+            int ind = rand() % len;
+            max_vec[ind] = rand() % 2 ? -(1LL << 41) : (1LL << 41);
+            xor_vec[ind] = rand();
+            s_tree1.Update(max_vec[ind], ind);
+            s_tree2.Update(max_vec[ind], ind);
+            s_tree3.Update(xor_vec[ind], ind);
+            s_tree4.Update(xor_vec[ind], ind);
+        }
+
+        // Half of the ranges are short enough to be folded
+        // straight from the leaves.
+        int l_ind = rand() % len;
+        int r_ind = l_ind + rand() % std::min<std::size_t>(i % 2 ? 200 : len, len - l_ind);
+
+        long long max_ans = max_vec[l_ind];
+        int xor_ans = 0;
+        for(int j = l_ind; j <= r_ind; j++){
+            max_ans = std::max(max_ans, max_vec[j]);
+            xor_ans ^= xor_vec[j];
+        }
+
+        if(max_ans != s_tree1.Query(l_ind, r_ind) || max_ans != s_tree2.Query(l_ind, r_ind)){
+            std::cerr << "test_Simd_MaxAndXor:\n\tMaximum queries do not match.\n";
+            return 0;
+        }
+        if(xor_ans != s_tree3.Query(l_ind, r_ind) || xor_ans != s_tree4.Query(l_ind, r_ind)){
+            std::cerr << "test_Simd_MaxAndXor:\n\tXor queries do not match.\n";
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST11 : Multi-threaded build, std::string concatenation
+ *  --------------------------
+ */
+
+int test_ParallelBuild_StringConcatenation(){
+    // Large enough for the leaves and the lowest levels
+    // to be split across the threads.
+    std::size_t len = 100000;
+    std::vector<std::string> value_vec;
+    for(std::size_t i = 0; i < len; i++){
+        value_vec.push_back(std::string(1, 'a' + rand() % 26));
+    }
+
+    for(int type = 0; type < 2; type++){
+        SegmentTree<std::string> s_tree1 = {value_vec, addString{}, type};
+        SegmentTree<std::string> s_tree2 = {value_vec, addString{}, type, 4};
+        SegmentTree<std::string> s_tree3 = {"ab", len, addString{}, type, 3};
+
+        if(s_tree1.Query(0, len - 1) != s_tree2.Query(0, len - 1)){
+            std::cerr << "test_ParallelBuild_StringConcatenation:\n\tWhole range does not match "
+                "the serial build.\n";
+            return 0;
+        }
+
+        for(int i = 0; i < 30; i++){
+            int r_ind = rand() % len;
+            int l_ind = rand() % (len - r_ind);
+            if(l_ind > r_ind) std::swap(l_ind, r_ind);
+
+            if(s_tree1.Query(l_ind, r_ind) != s_tree2.Query(l_ind, r_ind)){
+                std::cerr << "test_ParallelBuild_StringConcatenation:\n\tQueries do not match "
+                    "for vector initialized segment tree.\n";
+                return 0;
+            }
+
+            std::string brute_force_ans = "";
+            for(int j = l_ind; j <= r_ind; j++){
+                brute_force_ans += "ab";
+            }
+            if(brute_force_ans != s_tree3.Query(l_ind, r_ind)){
+                std::cerr << "test_ParallelBuild_StringConcatenation:\n\tQueries do not match "
+                    "for value initialized segment tree.\n";
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST12 : Concurrent readers with a single writer
+ *  --------------------------
+ */
+
+int test_Concurrent_MonotonicSums(){
+    // The writer only ever increases leaves, so the sum of a range
+    // can never decrease between two queries of the same reader, and
+    // a reader that saw a torn or stale tree would notice.
+    std::size_t len = 1000;
+    std::vector<long long> value_vec(len, 0);
+    ConcurrentSegmentTree<long long, SumOp<long long>> s_tree1 = {value_vec, SumOp<long long>{}, TREE_ITERATIVE};
+    ConcurrentSegmentTree<long long, SumOp<long long>> s_tree2 = {0LL, len, SumOp<long long>{}, TREE_RECURSIVE};
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> failures(0);
+    std::vector<std::thread> readers;
+    for(int t = 0; t < 3; t++){
+        readers.push_back(std::thread([&, t](){
+            int l_ind = t * 100, r_ind = len - 1 - t * 50;
+            long long last1 = 0, last2 = 0;
+            while(!stop.load()){
+                long long ans1 = s_tree1.Query(l_ind, r_ind);
+                long long ans2 = s_tree2.Query(l_ind, r_ind);
+                if(ans1 < last1 || ans2 < last2){
+                    failures++;
+                }
+                last1 = ans1;
+                last2 = ans2;
+            }
+        }));
+    }
+
+    for(int i = 0; i < 20000; i++){
+        int ind = rand() % len;
+        value_vec[ind] += rand() % 10;
+        s_tree1.Update(value_vec[ind], ind);
+        s_tree2.Update(value_vec[ind], ind);
+    }
+    stop.store(true);
+    for(std::size_t t = 0; t < readers.size(); t++){
+        readers[t].join();
+    }
+
+    if(failures.load() != 0){
+        std::cerr << "test_Concurrent_MonotonicSums:\n\tA reader saw a sum decrease.\n";
+        return 0;
+    }
+
+    for(int i = 0; i < 20; i++){
+        int r_ind = rand() % len;
+        int l_ind = rand() % (len - r_ind);
+        if(l_ind > r_ind) std::swap(l_ind, r_ind);
+
+        long long brute_force_ans = 0;
+        for(int j = l_ind; j <= r_ind; j++){
+            brute_force_ans += value_vec[j];
+        }
+        if(brute_force_ans != s_tree1.Query(l_ind, r_ind) || brute_force_ans != s_tree2.Query(l_ind, r_ind)){
+            std::cerr << "test_Concurrent_MonotonicSums:\n\tQueries do not match after the updates.\n";
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST13 : Sharded tree, std::string concatenation
+ *  --------------------------
+ */
+
+int test_Sharded_StringConcatenation(){
+    // 7 shards of 143 leaves, the last one shorter
+    std::size_t len = 1000;
+    std::vector<std::string> value_vec;
+    for(std::size_t i = 0; i < len; i++){
+        value_vec.push_back(std::string(1, 'a' + rand() % 26));
+    }
+
+    ShardedSegmentTree<std::string> s_tree1 = {value_vec, addString{}, TREE_ITERATIVE, 7};
+    ShardedSegmentTree<std::string> s_tree2 = {"", len, addString{}, TREE_RECURSIVE, 7};
+
+    // Four writers, each owning the leaves equal to it modulo 4,
+    // update concurrently. The final values are known in advance.
+    std::vector<std::thread> writers;
+    for(int t = 0; t < 4; t++){
+        writers.push_back(std::thread([&, t](){
+            for(std::size_t i = t; i < len; i += 4){
+                s_tree1.Update(value_vec[i], i);
+                s_tree2.Update(value_vec[i], i);
+                s_tree1.Query(i / 2, i);
+            }
+        }));
+    }
+    for(int t = 0; t < 4; t++){
+        writers[t].join();
+    }
+
+    for(int i = 0; i < 60; i++){
+        int r_ind = rand() % len;
+        int l_ind = rand() % (len - r_ind);
+        if(l_ind > r_ind) std::swap(l_ind, r_ind);
+
+        std::string brute_force_ans = "";
+        for(int j = l_ind; j <= r_ind; j++){
+            brute_force_ans += value_vec[j];
+        }
+
+        if(brute_force_ans != s_tree1.Query(l_ind, r_ind)){
+            std::cerr << "test_Sharded_StringConcatenation:\n\tQueries do not match "
+                "for vector initialized segment tree.\n";
+            return 0;
+        }
+        if(brute_force_ans != s_tree2.Query(l_ind, r_ind)){
+            std::cerr << "test_Sharded_StringConcatenation:\n\tQueries do not match "
+                "for value initialized segment tree.\n";
+            return 0;
+        }
+    }
+
+    // Trivially copyable roots take the other path. Leaves only grow,
+    // so a reader must always see a total between 0 and the final one.
+    ShardedSegmentTree<long long, SumOp<long long>> s_tree3 = {0, len, SumOp<long long>{}, TREE_ITERATIVE, 7};
+    std::atomic<bool> torn(false);
+    std::thread reader([&](){
+        for(int i = 0; i < 2000; i++){
+            long long total = s_tree3.Query(0, len - 1);
+            if(total < 0 || total > 3 * (long long)len)
+                torn.store(true);
+        }
+    });
+    writers.clear();
+    for(int t = 0; t < 4; t++){
+        writers.push_back(std::thread([&, t](){
+            for(long long v = 1; v <= 3; v++)
+                for(std::size_t i = t; i < len; i += 4)
+                    s_tree3.Update(v, i);
+        }));
+    }
+    for(int t = 0; t < 4; t++){
+        writers[t].join();
+    }
+    reader.join();
+
+    if(torn.load() || s_tree3.Query(0, len - 1) != 3 * (long long)len || s_tree3.Query(150, 850) != 3 * 701){
+        std::cerr << "test_Sharded_StringConcatenation:\n\tSums do not match for trivially copyable leaves.\n";
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST14 : Persistent tree, std::string concatenation
+ *  --------------------------
+ */
+
+int test_Persistent_StringConcatenation(){
+    std::size_t len = 200;
+    std::vector<std::string> value_vec;
+    for(std::size_t i = 0; i < len; i++){
+        value_vec.push_back(std::string(1, 'a' + rand() % 26));
+    }
+
+    PersistentSegmentTree<std::string> s_tree1 = {value_vec, addString{}};
+    PersistentSegmentTree<std::string> s_tree2 = {"x", len, addString{}};
+
+    // The value initialized tree shares its equal subtrees
+    if(s_tree2.NodeCount() > 40){
+        std::cerr << "test_Persistent_StringConcatenation:\n\tValue initialized tree is not shared.\n";
+        return 0;
+    }
+
+    // Brute force copy of the leaves of every retained snapshot, the
+    // two trees taking their snapshots in step so handles are equal.
+    std::vector<std::string> value_vec2(len, "x");
+    std::map<std::size_t, std::vector<std::string> > versions1, versions2;
+
+    for(int i = 0; i < 600; i++){
+        int ind = rand() % len;
+        value_vec[ind] = std::string(1, 'a' + rand() % 26);
+        value_vec2[ind] = value_vec[ind];
+        s_tree1.Update(value_vec[ind], ind);
+        s_tree2.Update(value_vec2[ind], ind);
+
+        if(i % 7 == 0){
+            versions1[s_tree1.Snapshot()] = value_vec;
+            versions2[s_tree2.Snapshot()] = value_vec2;
+        }
+        if(i % 11 == 0 && versions1.size() > 3){
+            // Releasing an older snapshot, which may compact the arena
+            std::map<std::size_t, std::vector<std::string> >::iterator it = versions1.begin();
+            std::advance(it, rand() % (versions1.size() - 1));
+            s_tree1.Release(it->first);
+            s_tree2.Release(it->first);
+            versions2.erase(it->first);
+            versions1.erase(it);
+        }
+
+        int r_ind = rand() % len;
+        int l_ind = rand() % (len - r_ind);
+        if(l_ind > r_ind) std::swap(l_ind, r_ind);
+
+        std::map<std::size_t, std::vector<std::string> >::iterator it = versions1.begin();
+        if(!versions1.empty()){
+            std::advance(it, rand() % versions1.size());
+        }
+
+        std::string current_ans = "", current_ans2 = "", version_ans = "", version_ans2 = "";
+        for(int j = l_ind; j <= r_ind; j++){
+            current_ans += value_vec[j];
+            current_ans2 += value_vec2[j];
+            if(it != versions1.end()){
+                version_ans += it->second[j];
+                version_ans2 += versions2[it->first][j];
+            }
+        }
+
+        if(current_ans != s_tree1.Query(l_ind, r_ind) || current_ans2 != s_tree2.Query(l_ind, r_ind)){
+            std::cerr << "test_Persistent_StringConcatenation:\n\tQueries on the current version do not match.\n";
+            return 0;
+        }
+        if(it != versions1.end() && (version_ans != s_tree1.Query(it->first, l_ind, r_ind)
+                                     || version_ans2 != s_tree2.Query(it->first, l_ind, r_ind))){
+            std::cerr << "test_Persistent_StringConcatenation:\n\tQueries on a snapshot do not match.\n";
+            return 0;
+        }
+    }
+
+    try{
+        s_tree1.Query(s_tree1.Snapshot() + 1, 0, 0);
+        std::cerr << "test_Persistent_StringConcatenation:\n\tUnknown version did not throw.\n";
+        return 0;
+    }
+    catch(std::invalid_argument const &){
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST15 : Sparse tree over 64-bit keys, std::string concatenation
+ *  --------------------------
+ */
+
+int test_Sparse_StringConcatenation(){
+    // Keys spread over the whole 64-bit range, and a few clustered
+    // next to its end and to each other.
+    std::vector<std::uint64_t> keys;
+    for(int i = 0; i < 100; i++){
+        std::uint64_t key = ((std::uint64_t)rand() << 40) ^ ((std::uint64_t)rand() << 20) ^ rand();
+        keys.push_back(key);
+        keys.push_back(key | 1);
+    }
+    keys.push_back(0);
+    keys.push_back(UINT64_MAX);
+    keys.push_back(UINT64_MAX - 1);
+
+    SparseSegmentTree<std::string> s_tree = {UINT64_MAX, addString{}};
+    std::map<std::uint64_t, std::string> brute_force;
+
+    if(s_tree.Query(0, UINT64_MAX) != ""){
+        std::cerr << "test_Sparse_StringConcatenation:\n\tEmpty tree is not the identity.\n";
+        return 0;
+    }
+
+    for(int i = 0; i < 300; i++){
+        std::uint64_t key = keys[rand() % keys.size()];
+        brute_force[key] = std::string(1, 'a' + rand() % 26);
+        s_tree.Update(brute_force[key], key);
+
+        std::uint64_t l_key = keys[rand() % keys.size()], r_key = keys[rand() % keys.size()];
+        if(l_key > r_key) std::swap(l_key, r_key);
+        if(i % 10 == 0){
+            r_key = UINT64_MAX;
+        }
+
+        std::string brute_force_ans = "";
+        for(std::map<std::uint64_t, std::string>::iterator it = brute_force.lower_bound(l_key);
+            it != brute_force.end() && it->first <= r_key; ++it){
+            brute_force_ans += it->second;
+        }
+
+        if(brute_force_ans != s_tree.Query(l_key, r_key)){
+            std::cerr << "test_Sparse_StringConcatenation:\n\tQueries do not match.\n";
+            return 0;
+        }
+    }
+
+    // At most one node per level for each distinct key
+    if(s_tree.NodeCount() > 1 + brute_force.size() * 64){
+        std::cerr << "test_Sparse_StringConcatenation:\n\tToo many nodes.\n";
+        return 0;
+    }
+
+    SparseSegmentTree<int, MinOp<int>> min_tree = {1000000, MinOp<int>{}};
+    min_tree.Update(5, 500000);
+    if(min_tree.Query(0, 499999) != MinOp<int>::Identity() || min_tree.Query(0, 1000000) != 5){
+        std::cerr << "test_Sparse_StringConcatenation:\n\tMinimum tree does not use the policy identity.\n";
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST16 : Saving and mapping trees, maximum subarray
+ *  --------------------------
+ */
+
+int test_SaveOpen_MaximumSubarray(){
+    std::size_t len = 777;
+    std::vector<NodeEle> value_vec;
+    for(std::size_t i = 0; i < len; i++){
+        value_vec.push_back(NodeEle(-500 + rand() % 1000));
+    }
+    std::string path = "test_SaveOpen.segtree";
+
+    for(int type = 0; type <= TREE_VEB; type++){
+        SegmentTree<NodeEle> s_tree = {value_vec, combine, type};
+        s_tree.Save(path);
+
+        SegmentTree<NodeEle> s_tree1 = SegmentTree<NodeEle>::Open(path, combine, MAP_READ_ONLY, true);
+        SegmentTree<NodeEle> s_tree2 = SegmentTree<NodeEle>::Open(path, combine, MAP_COPY_ON_WRITE);
+        std::vector<NodeEle> cow_vec = value_vec;
+
+        try{
+            s_tree1.Update(NodeEle(1), 0);
+            std::cerr << "test_SaveOpen_MaximumSubarray:\n\tUpdate on a read-only tree did not throw.\n";
+            return 0;
+        }
+        catch(std::logic_error const &){
+        }
+
+        for(int i = 0; i < 40; i++){
+            int ind = rand() % len;
+            cow_vec[ind] = NodeEle(-500 + rand() % 1000);
+            s_tree2.Update(cow_vec[ind], ind);
+
+            int r_ind = rand() % len;
+            int l_ind = rand() % (len - r_ind);
+            if(l_ind > r_ind) std::swap(l_ind, r_ind);
+
+            NodeEle brute_force_ans = value_vec[l_ind], cow_ans = cow_vec[l_ind];
+            for(int j = l_ind + 1; j <= r_ind; j++){
+                brute_force_ans = combine(brute_force_ans, value_vec[j]);
+                cow_ans = combine(cow_ans, cow_vec[j]);
+            }
+
+            if(brute_force_ans.bst != s_tree1.Query(l_ind, r_ind).bst){
+                std::cerr << "test_SaveOpen_MaximumSubarray:\n\tQueries do not match "
+                    "for read-only tree.\n";
+                return 0;
+            }
+            if(cow_ans.bst != s_tree2.Query(l_ind, r_ind).bst){
+                std::cerr << "test_SaveOpen_MaximumSubarray:\n\tQueries do not match "
+                    "for copy-on-write tree.\n";
+                return 0;
+            }
+        }
+
+        // The copy-on-write updates must not have reached the file
+        SegmentTree<NodeEle> s_tree3 = SegmentTree<NodeEle>::Open(path, combine, MAP_READ_ONLY, true);
+        if(s_tree3.Query(0, len - 1).bst != s_tree.Query(0, len - 1).bst){
+            std::cerr << "test_SaveOpen_MaximumSubarray:\n\tFile changed after copy-on-write updates.\n";
+            return 0;
+        }
+    }
+
+    try{
+        SegmentTree<int>::Open(path, [](int &a, int &b){ return a + b; });
+        std::cerr << "test_SaveOpen_MaximumSubarray:\n\tOpening with another type did not throw.\n";
+        return 0;
+    }
+    catch(std::runtime_error const &){
+    }
+
+    // Header fields, at their offsets in the file: the tree type, a
+    // type this build does not know, and more leaves than nodes. The
+    // last edit keeps the header consistent (a power of two capacity
+    // over fewer leaves), so only the checksum can catch it.
+    std::size_t offsets[] = {12, 12, 16, 16};
+    std::uint64_t fields[] = {TREE_WIDE, 9, 1000000, 100};
+    std::size_t sizes[] = {4, 4, 8, 8};
+    auto sum = [](int &a, int &b){ return a + b; };
+
+    for(int i = 0; i < 4; i++){
+        SegmentTree<int> s_tree = {std::vector<int>(i < 3 ? 100 : 128, 1), sum, TREE_ITERATIVE};
+        s_tree.Save(path);
+
+        std::fstream file(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offsets[i]);
+        file.write(reinterpret_cast<char const *>(&fields[i]), sizes[i]);
+        file.close();
+
+        try{
+            SegmentTree<int>::Open(path, sum, MAP_READ_ONLY, i == 3);
+            std::cerr << "test_SaveOpen_MaximumSubarray:\n\tOpening corrupted header " << i << " did not throw.\n";
+            return 0;
+        }
+        catch(std::runtime_error const &){
+        }
+    }
+
+    std::remove(path.c_str());
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST17 : Construction from iterators, moved vectors and files
+ *  --------------------------
+ */
+
+int test_IteratorAndLoad_Sum(){
+    std::size_t len = 999;
+    std::vector<long long> value_vec;
+    for(std::size_t i = 0; i < len; i++){
+        value_vec.push_back(-1000 + rand() % 2000);
+    }
+    std::list<std::string> string_list;
+    for(std::size_t i = 0; i < len; i++){
+        string_list.push_back(std::string(1, 'a' + rand() % 26));
+    }
+    std::vector<std::string> string_vec(string_list.begin(), string_list.end());
+
+    std::string text_path = "test_IteratorAndLoad.txt";
+    std::string binary_path = "test_IteratorAndLoad.bin";
+    {
+        std::ofstream text(text_path.c_str());
+        for(std::size_t i = 0; i < len; i++){
+            text << value_vec[i] << (i % 7 == 6 ? "\n" : " ");
+        }
+        std::ofstream binary(binary_path.c_str(), std::ios::binary);
+        binary.write(reinterpret_cast<char const *>(value_vec.data()), len * sizeof(long long));
+    }
+
+    for(int type = 0; type < 3; type++){
+        std::stringstream stream;
+        for(std::size_t i = 0; i < len; i++){
+            stream << value_vec[i] << ' ';
+        }
+        std::vector<long long> moved_vec = value_vec;
+
+        SegmentTree<long long, SumOp<long long>> s_trees[] = {
+            {std::istream_iterator<long long>(stream), std::istream_iterator<long long>(), SumOp<long long>{}, type},
+            {std::move(moved_vec), SumOp<long long>{}, type},
+            SegmentTree<long long, SumOp<long long>>::LoadText(text_path, SumOp<long long>{}, type),
+            SegmentTree<long long, SumOp<long long>>::LoadBinary(binary_path, SumOp<long long>{}, type)
+        };
+        SegmentTree<std::string, addString> s_tree = {string_list.begin(), string_list.end(), addString(), type};
+
+        if(!moved_vec.empty()){
+            std::cerr << "test_IteratorAndLoad_Sum:\n\tThe moved vector still holds its values.\n";
+            return 0;
+        }
+
+        for(int i = 0; i < 50; i++){
+            int r_ind = rand() % len;
+            int l_ind = rand() % (len - r_ind);
+            if(l_ind > r_ind) std::swap(l_ind, r_ind);
+
+            long long brute_force_ans = 0;
+            std::string brute_force_string;
+            for(int j = l_ind; j <= r_ind; j++){
+                brute_force_ans += value_vec[j];
+                brute_force_string += string_vec[j];
+            }
+
+            for(int t = 0; t < 4; t++){
+                if(s_trees[t].Query(l_ind, r_ind) != brute_force_ans){
+                    std::cerr << "test_IteratorAndLoad_Sum:\n\tQueries do not match for construction "
+                        << t << " of type " << type << ".\n";
+                    return 0;
+                }
+            }
+            if(s_tree.Query(l_ind, r_ind) != brute_force_string){
+                std::cerr << "test_IteratorAndLoad_Sum:\n\tQueries do not match for a list of strings.\n";
+                return 0;
+            }
+        }
+    }
+
+    {
+        std::ofstream text(text_path.c_str());
+        text << "1 2 x 4";  // 7 bytes, not a whole number of ints
+    }
+    try{
+        SegmentTree<long long, SumOp<long long>>::LoadText(text_path, SumOp<long long>{}, TREE_ITERATIVE);
+        std::cerr << "test_IteratorAndLoad_Sum:\n\tLoading an unparsable value did not throw.\n";
+        return 0;
+    }
+    catch(std::runtime_error const &){
+    }
+
+    try{
+        SegmentTree<int, SumOp<int>>::LoadBinary(text_path, SumOp<int>{}, TREE_ITERATIVE);
+        std::cerr << "test_IteratorAndLoad_Sum:\n\tLoading a truncated binary file did not throw.\n";
+        return 0;
+    }
+    catch(std::runtime_error const &){
+    }
+
+    // Empty input: files fail to load whatever the type, and only the
+    // iterative type can be built from an empty range or vector.
+    {
+        std::ofstream text(text_path.c_str());
+        text << " \n";
+        std::ofstream binary(binary_path.c_str(), std::ios::binary);
+    }
+    for(int type = 0; type <= TREE_VEB; type++){
+        try{
+            SegmentTree<long long, SumOp<long long>>::LoadText(text_path, SumOp<long long>{}, type);
+            std::cerr << "test_IteratorAndLoad_Sum:\n\tLoading a blank text file did not throw.\n";
+            return 0;
+        }
+        catch(std::runtime_error const &){
+        }
+        try{
+            SegmentTree<int, SumOp<int>>::LoadBinary(binary_path, SumOp<int>{}, type);
+            std::cerr << "test_IteratorAndLoad_Sum:\n\tLoading an empty binary file did not throw.\n";
+            return 0;
+        }
+        catch(std::runtime_error const &){
+        }
+
+        std::vector<int> empty;
+        std::istringstream no_values("");
+        for(int t = 0; t < 3 && type != TREE_ITERATIVE; t++){
+            try{
+                if(t == 0)
+                    SegmentTree<int, SumOp<int>>(std::vector<int>(), SumOp<int>{}, type);
+                else if(t == 1)
+                    SegmentTree<int, SumOp<int>>(empty.begin(), empty.end(), SumOp<int>{}, type);
+                else
+                    SegmentTree<int, SumOp<int>>(std::istream_iterator<int>(no_values),
+                                                 std::istream_iterator<int>(), SumOp<int>{}, type);
+                std::cerr << "test_IteratorAndLoad_Sum:\n\tBuilding from empty input " << t
+                    << " did not throw for type " << type << ".\n";
+                return 0;
+            }
+            catch(std::invalid_argument const &){
+            }
+        }
+    }
+
+    std::remove(text_path.c_str());
+    std::remove(binary_path.c_str());
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST18 : In-place operations and moved updates, std::string concatenation
+ *  --------------------------
+ */
+struct appendString {
+    void operator()(std::string &acc, std::string const &b) const {
+        acc += b;
+    }
+};
+
+static_assert(IsInPlaceOp<std::string, appendString>::value, "appendString accumulates in place.");
+static_assert(!IsInPlaceOp<std::string, addString>::value, "addString returns a new value.");
+static_assert(!IsInPlaceOp<int, SumOp<int>>::value, "SumOp returns a new value.");
+
+int test_InPlace_StringConcatenation(){
+    std::size_t len = 300;
+    std::vector<std::string> value_vec;
+    for(std::size_t i = 0; i < len; i++){
+        value_vec.push_back(std::string(1 + rand() % 20, 'a' + rand() % 26));
+    }
+
+    for(int type = 0; type < 3; type++){
+        std::vector<std::string> brute_vec = value_vec;
+        SegmentTree<std::string, appendString> s_tree1 = {value_vec, appendString{}, type};
+        SegmentTree<std::string, appendString> s_tree2 = {std::string(), len, appendString{}, type};
+        s_tree2.Assign(0, value_vec.begin(), value_vec.end());
+
+        for(int i = 0; i < 100; i++){
+            std::size_t ind = rand() % len;
+            std::string value(1 + rand() % 20, 'a' + rand() % 26);
+            brute_vec[ind] = value;
+
+            std::string moved = value;
+            s_tree1.Update(std::move(moved), ind);
+            s_tree2.UpdateBatch(std::vector<std::size_t>(1, ind), std::vector<std::string>(1, value));
+
+            std::vector<std::pair<std::size_t, std::size_t> > ranges;
+            for(int q = 0; q < 20; q++){
+                std::size_t r_ind = rand() % len;
+                std::size_t l_ind = rand() % (r_ind + 1);
+                ranges.push_back(std::make_pair(l_ind, r_ind));
+            }
+            std::vector<std::string> results;
+            s_tree2.QueryBatch(ranges, results);
+
+            for(std::size_t q = 0; q < ranges.size(); q++){
+                std::string brute_force_ans;
+                for(std::size_t j = ranges[q].first; j <= ranges[q].second; j++){
+                    brute_force_ans += brute_vec[j];
+                }
+
+                if(brute_force_ans != s_tree1.Query(ranges[q].first, ranges[q].second)){
+                    std::cerr << "test_InPlace_StringConcatenation:\n\tQueries do not match "
+                        "for type " << type << ".\n";
+                    return 0;
+                }
+                if(brute_force_ans != results[q]){
+                    std::cerr << "test_InPlace_StringConcatenation:\n\tBatched queries do not match "
+                        "for type " << type << ".\n";
+                    return 0;
+                }
+            }
+        }
+    }
+
+    // Wrappers of SegmentTree take the in-place form too
+    ShardedSegmentTree<std::string, appendString> s_tree3 = {value_vec, appendString{}, TREE_ITERATIVE, 7};
+    ConcurrentSegmentTree<std::string, appendString> s_tree4 = {value_vec, appendString{}, TREE_RECURSIVE};
+    s_tree3.Update(std::string("sharded"), len / 2);
+    s_tree4.Update(std::string("concurrent"), len / 2);
+
+    std::string sharded_ans, concurrent_ans;
+    for(std::size_t j = 0; j < len; j++){
+        sharded_ans += j == len / 2 ? std::string("sharded") : value_vec[j];
+        concurrent_ans += j == len / 2 ? std::string("concurrent") : value_vec[j];
+    }
+    if(s_tree3.Query(0, len - 1) != sharded_ans || s_tree4.Query(0, len - 1) != concurrent_ans){
+        std::cerr << "test_InPlace_StringConcatenation:\n\tQueries do not match "
+            "for sharded or concurrent tree.\n";
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST19 : Searches descending the tree, sums and string lengths
+ *  --------------------------
+ */
+
+int test_FindFirstAndLast_Sum(){
+    for(std::size_t len = 1; len < 200; len += (len < 20 ? 1 : 29)){
+        std::vector<long long> value_vec;
+        std::vector<std::string> string_vec;
+        for(std::size_t i = 0; i < len; i++){
+            value_vec.push_back(rand() % 10);
+            string_vec.push_back(std::string(1 + rand() % 3, 'a' + rand() % 26));
+        }
+
+        for(int type = 0; type < 3; type++){
+            SegmentTree<long long, SumOp<long long>> s_tree1 = {value_vec, SumOp<long long>{}, type};
+            SegmentTree<std::string, appendString> s_tree2 = {string_vec, appendString{}, type};
+
+            long long bound = rand() % (len * 5);
+            auto exceeds = [bound](long long const &sum){ return sum > bound; };
+            auto longer = [bound](std::string const &str){ return (long long)str.size() > bound; };
+
+            for(std::size_t i = 0; i < len; i++){
+                // First r with the sum of [i, r] over bound, and last l
+                // with the sum of [l, i] over bound, len_ if none
+                std::size_t first = len, last = len, first_str = len, last_str = len;
+                long long sum = 0;
+                std::string str;
+                for(std::size_t j = i; j < len && first == len; j++){
+                    sum += value_vec[j];
+                    if(sum > bound) first = j;
+                }
+                for(std::size_t j = i; j < len && first_str == len; j++){
+                    str += string_vec[j];
+                    if((long long)str.size() > bound) first_str = j;
+                }
+                sum = 0;
+                str.clear();
+                for(std::size_t j = i + 1; j-- > 0 && last == len; ){
+                    sum += value_vec[j];
+                    if(sum > bound) last = j;
+                }
+                for(std::size_t j = i + 1; j-- > 0 && last_str == len; ){
+                    str = string_vec[j] + str;
+                    if((long long)str.size() > bound) last_str = j;
+                }
+
+                if(s_tree1.FindFirst(i, exceeds) != first || s_tree1.FindLast(i, exceeds) != last){
+                    std::cerr << "test_FindFirstAndLast_Sum:\n\tSearches do not match for sums "
+                        "on type " << type << ".\n";
+                    return 0;
+                }
+                if(s_tree2.FindFirst(i, longer) != first_str || s_tree2.FindLast(i, longer) != last_str){
+                    std::cerr << "test_FindFirstAndLast_Sum:\n\tSearches do not match for strings "
+                        "on type " << type << ".\n";
+                    return 0;
+                }
+            }
+
+            // First prefix reaching the bound
+            std::size_t lower_bound = len;
+            long long prefix = 0;
+            for(std::size_t j = 0; j < len && lower_bound == len; j++){
+                prefix += value_vec[j];
+                if(prefix >= bound) lower_bound = j;
+            }
+            if(s_tree1.PrefixLowerBound(bound) != lower_bound){
+                std::cerr << "test_FindFirstAndLast_Sum:\n\tPrefixLowerBound does not match "
+                    "on type " << type << ".\n";
+                return 0;
+            }
+        }
+    }
+
+    SegmentTree<long long, SumOp<long long>> s_tree = {0LL, 10, SumOp<long long>{}, TREE_ITERATIVE};
+    try{
+        s_tree.FindFirst(10, [](long long const &){ return true; });
+        std::cerr << "test_FindFirstAndLast_Sum:\n\tSearching from outside the tree did not throw.\n";
+        return 0;
+    }
+    catch(std::out_of_range const &){
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST20 : Growing trees by appending leaves, std::string concatenation
+ *  --------------------------
+ */
+
+int test_PushBack_StringConcatenation(){
+    std::vector<std::string> initial = {"ab", "", "c", "def", "g"};
+
+    // Starting empty, from a power of two and from any other length
+    for(std::size_t start = 0; start <= initial.size(); start += 4){
+        std::vector<std::string> value_vec(initial.begin(), initial.begin() + start);
+        SegmentTree<std::string, addString> s_tree = {value_vec, addString{}, TREE_ITERATIVE};
+
+        for(int i = 0; i < 300; i++){
+            std::string value(rand() % 3, 'a' + rand() % 26);
+            value_vec.push_back(value);
+            s_tree.PushBack(std::move(value));
+
+            if(s_tree.Size() != value_vec.size()){
+                std::cerr << "test_PushBack_StringConcatenation:\n\tSize does not match.\n";
+                return 0;
+            }
+
+            if(i % 7 == 0){
+                std::size_t ind = rand() % value_vec.size();
+                value_vec[ind] = std::string(1, 'A' + rand() % 26);
+                s_tree.Update(value_vec[ind], ind);
+            }
+
+            // Trailing window, and a random range
+            std::size_t r_ind = value_vec.size() - 1;
+            std::size_t l_ind = r_ind - std::min<std::size_t>(r_ind, rand() % 20);
+            for(int q = 0; q < 2; q++){
+                std::string brute_force_ans;
+                for(std::size_t j = l_ind; j <= r_ind; j++){
+                    brute_force_ans += value_vec[j];
+                }
+                if(brute_force_ans != s_tree.Query(l_ind, r_ind)){
+                    std::cerr << "test_PushBack_StringConcatenation:\n\tQueries do not match "
+                        "after " << i + 1 << " appends.\n";
+                    return 0;
+                }
+                r_ind = rand() % value_vec.size();
+                l_ind = rand() % (r_ind + 1);
+            }
+        }
+    }
+
+    SegmentTree<std::string> s_tree = {initial, addString{}, TREE_RECURSIVE};
+    try{
+        s_tree.PushBack("x");
+        std::cerr << "test_PushBack_StringConcatenation:\n\tPushBack on a recursive tree did not throw.\n";
+        return 0;
+    }
+    catch(std::logic_error const &){
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST21 : Sliding windows, std::string concatenation and maximum
+ *  --------------------------
+ */
+
+int test_SlidingWindow_StringConcatenation(){
+    std::size_t capacity = 37;
+    SlidingWindowTree<std::string, addString> s_tree1 = {capacity, addString{}};
+    SlidingWindowTree<int, MaxOp<int>> s_tree2 = {capacity, MaxOp<int>{}};
+    std::vector<std::string> pushed;
+    std::vector<int> pushed_ints;
+
+    for(int i = 0; i < 200; i++){
+        std::string value(1, 'a' + rand() % 26);
+        pushed.push_back(value);
+        pushed_ints.push_back(rand() % 1000);
+        s_tree1.Push(std::move(value));
+        s_tree2.Push(pushed_ints.back());
+
+        if(s_tree1.Size() != std::min<std::size_t>(pushed.size(), capacity)){
+            std::cerr << "test_SlidingWindow_StringConcatenation:\n\tSize does not match.\n";
+            return 0;
+        }
+
+        // Every window size, so that windows wrap around the buffer at
+        // every possible position
+        for(std::size_t k = 1; k <= s_tree1.Size(); k++){
+            std::string brute_force_ans;
+            int brute_force_max = pushed_ints[pushed.size() - k];
+            for(std::size_t j = pushed.size() - k; j < pushed.size(); j++){
+                brute_force_ans += pushed[j];
+                brute_force_max = std::max(brute_force_max, pushed_ints[j]);
+            }
+            if(brute_force_ans != s_tree1.WindowQuery(k) || brute_force_max != s_tree2.WindowQuery(k)){
+                std::cerr << "test_SlidingWindow_StringConcatenation:\n\tWindow of " << k
+                    << " does not match after " << i + 1 << " pushes.\n";
+                return 0;
+            }
+        }
+    }
+
+    try{
+        s_tree1.WindowQuery(capacity + 1);
+        std::cerr << "test_SlidingWindow_StringConcatenation:\n\tWindow larger than the capacity did not throw.\n";
+        return 0;
+    }
+    catch(std::out_of_range const &){
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST22 : Rectangle sums and maxima on a grid
+ *  --------------------------
+ */
+
+int test_Grid_SumAndMax(){
+    std::size_t rows = 23, cols = 41;
+    std::vector<std::vector<int>> grid(rows, std::vector<int>(cols));
+    for(std::size_t x = 0; x < rows; x++)
+        for(std::size_t y = 0; y < cols; y++)
+            grid[x][y] = rand() % 1000 - 500;
+
+    SegmentTree2D<int, SumOp<int>> s_tree1 = {grid, SumOp<int>{}};
+    SegmentTree2D<int, MaxOp<int>> s_tree2 = {grid, MaxOp<int>{}};
+
+    for(int i = 0; i < 2000; i++){
+        std::size_t x = rand() % rows, y = rand() % cols;
+        if(rand() % 4 == 0){
+            grid[x][y] = rand() % 1000 - 500;
+            s_tree1.Update(x, y, grid[x][y]);
+            s_tree2.Update(x, y, grid[x][y]);
+            continue;
+        }
+
+        std::size_t x2 = x + rand() % (rows - x), y2 = y + rand() % (cols - y);
+        int brute_force_sum = 0, brute_force_max = grid[x][y];
+        for(std::size_t r = x; r <= x2; r++)
+            for(std::size_t c = y; c <= y2; c++){
+                brute_force_sum += grid[r][c];
+                brute_force_max = std::max(brute_force_max, grid[r][c]);
+            }
+
+        if(brute_force_sum != s_tree1.Query(x, y, x2, y2) || brute_force_max != s_tree2.Query(x, y, x2, y2)){
+            std::cerr << "test_Grid_SumAndMax:\n\tRectangle (" << x << ", " << y << ") to ("
+                << x2 << ", " << y2 << ") does not match.\n";
+            return 0;
+        }
+    }
+
+    try{
+        s_tree1.Query(0, 0, rows, 0);
+        std::cerr << "test_Grid_SumAndMax:\n\tQuery outside the grid did not throw.\n";
+        return 0;
+    }
+    catch(std::out_of_range const &){
+    }
+
+    try{
+        std::vector<std::vector<int>> ragged = {{1, 2}, {3}};
+        SegmentTree2D<int, SumOp<int>> s_tree3 = {ragged, SumOp<int>{}};
+        std::cerr << "test_Grid_SumAndMax:\n\tRagged grid did not throw.\n";
+        return 0;
+    }
+    catch(std::invalid_argument const &){
+    }
+
+    // A lambda declares no identity, so Base{} = 0 must not leak into
+    // the maximum of negative cells.
+    SegmentTree2D<int> s_tree4 = {-5, rows, cols, [](int &a, int &b){ return std::max(a, b); }};
+    s_tree4.Update(rows - 1, cols - 1, -3);
+    if(s_tree4.Query(0, 0, rows - 2, cols - 1) != -5 || s_tree4.Query(1, 1, rows - 1, cols - 1) != -3){
+        std::cerr << "test_Grid_SumAndMax:\n\tLambda maximum of negative cells does not match.\n";
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST23 : Fenwick tree, sums with lambdas and xor with policies
+ *  --------------------------
+ */
+
+int test_Fenwick_SumAndXor(){
+    std::size_t len = 1000;
+    std::vector<long long> values;
+    for(std::size_t i = 0; i < len; i++)
+        values.push_back(rand() % 2000 - 1000);
+
+    FenwickTree<long long> s_tree1 = {values,
+        [](long long &a, long long &b){ return a + b; },
+        [](long long &a, long long &b){ return a - b; }};
+    FenwickTree<long long, XorOp<long long>> s_tree2 = {values, XorOp<long long>{}, XorOp<long long>{}};
+    FenwickTree<long long, SumOp<long long>, DifferenceOp<long long>> s_tree3 = {7, len, SumOp<long long>{}, DifferenceOp<long long>{}};
+    std::vector<long long> sevens(len, 7);
+
+    for(int i = 0; i < 5000; i++){
+        std::size_t l = rand() % len;
+        if(rand() % 3 == 0){
+            values[l] = rand() % 2000 - 1000;
+            sevens[l] = rand() % 100;
+            s_tree1.Update(values[l], l);
+            s_tree2.Update(values[l], l);
+            s_tree3.Update(sevens[l], l);
+            continue;
+        }
+
+        std::size_t r = l + rand() % (len - l);
+        long long brute_force_sum = 0, brute_force_xor = 0, brute_force_sevens = 0;
+        for(std::size_t j = l; j <= r; j++){
+            brute_force_sum += values[j];
+            brute_force_xor ^= values[j];
+            brute_force_sevens += sevens[j];
+        }
+
+        if(brute_force_sum != s_tree1.Query(l, r) || brute_force_xor != s_tree2.Query(l, r)
+            || brute_force_sevens != s_tree3.Query(l, r)){
+            std::cerr << "test_Fenwick_SumAndXor:\n\tQuery from " << l << " to " << r << " does not match.\n";
+            return 0;
+        }
+    }
+
+    try{
+        s_tree1.Query(0, len);
+        std::cerr << "test_Fenwick_SumAndXor:\n\tQuery outside the tree did not throw.\n";
+        return 0;
+    }
+    catch(std::out_of_range const &){
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST24 : Sparse table, minimum and greatest common divisor
+ *  --------------------------
+ */
+
+int test_SparseTable_MinAndGcd(){
+    std::size_t len = 777;
+    std::vector<int> values;
+    for(std::size_t i = 0; i < len; i++)
+        values.push_back((rand() % 100 + 1) * 6);
+
+    auto gcd = [](int &a, int &b){
+        int x = a, y = b;
+        while(y != 0){
+            int t = x % y;
+            x = y;
+            y = t;
+        }
+        return x;
+    };
+
+    SparseTable<int, MinOp<int>> s_tree1 = {values, MinOp<int>{}};
+    SparseTable<int> s_tree2 = {values.begin(), values.end(), gcd};
+
+    for(std::size_t l = 0; l < len; l++){
+        int brute_force_min = values[l], brute_force_gcd = values[l];
+        for(std::size_t r = l; r < len; r++){
+            brute_force_min = std::min(brute_force_min, values[r]);
+            brute_force_gcd = gcd(brute_force_gcd, values[r]);
+            if(brute_force_min != s_tree1.Query(l, r) || brute_force_gcd != s_tree2.Query(l, r)){
+                std::cerr << "test_SparseTable_MinAndGcd:\n\tQuery from " << l << " to " << r << " does not match.\n";
+                return 0;
+            }
+        }
+    }
+
+    try{
+        s_tree1.Update(1, 0);
+        std::cerr << "test_SparseTable_MinAndGcd:\n\tUpdate on a sparse table did not throw.\n";
+        return 0;
+    }
+    catch(std::logic_error const &){
+    }
+
+    try{
+        s_tree1.Query(0, len);
+        std::cerr << "test_SparseTable_MinAndGcd:\n\tQuery outside the table did not throw.\n";
+        return 0;
+    }
+    catch(std::out_of_range const &){
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST25 : Blocked tree, std::string concatenation
+ *  --------------------------
+ */
+
+int test_Blocked_StringConcatenation(){
+    // Lengths around the block size, and one with many blocks
+    std::size_t lengths[] = {1, 63, 64, 65, 130, 1000};
+
+    for(std::size_t len : lengths){
+        std::vector<std::string> values;
+        for(std::size_t i = 0; i < len; i++)
+            values.push_back(std::string(1, 'a' + rand() % 26));
+
+        SegmentTree<std::string, addString> s_tree = {values, addString{}, TREE_BLOCKED};
+
+        for(int i = 0; i < 300; i++){
+            std::size_t l = rand() % len;
+            int op = rand() % 4;
+
+            if(op == 0){
+                values[l] = std::string(1 + rand() % 3, 'a' + rand() % 26);
+                s_tree.Update(values[l], l);
+                continue;
+            }
+            if(op == 1){
+                // A run of leaves that may span several blocks
+                std::size_t count = rand() % (len - l) + 1;
+                std::vector<std::string> run(count, std::string(1, 'A' + rand() % 26));
+                std::copy(run.begin(), run.end(), values.begin() + l);
+                s_tree.Assign(l, run.begin(), run.end());
+                continue;
+            }
+
+            std::size_t r = l + rand() % (len - l);
+            std::string brute_force_ans;
+            for(std::size_t j = l; j <= r; j++)
+                brute_force_ans += values[j];
+
+            // The first index whose prefix from l is as long as [l, r]
+            std::size_t length = brute_force_ans.size();
+            std::size_t first = s_tree.FindFirst(l, [length](std::string const &s){ return s.size() >= length; });
+            std::size_t brute_force_first = l;
+            for(std::size_t total = values[l].size(); total < length; total += values[++brute_force_first].size());
+
+            if(brute_force_ans != s_tree.Query(l, r) || first != brute_force_first){
+                std::cerr << "test_Blocked_StringConcatenation:\n\tRange from " << l << " to " << r
+                    << " of " << len << " leaves does not match.\n";
+                return 0;
+            }
+        }
+    }
+
+    // A lambda declares no identity, so Base{} = 0 must not leak into
+    // the maximum of negative leaves, with or without partial blocks.
+    SegmentTree<int> s_tree2 = {-5, 1000, [](int &a, int &b){ return std::max(a, b); }, TREE_BLOCKED};
+    s_tree2.Update(-3, 999);
+    if(s_tree2.Query(3, 900) != -5 || s_tree2.Query(64, 191) != -5 || s_tree2.Query(64, 999) != -3){
+        std::cerr << "test_Blocked_StringConcatenation:\n\tLambda maximum of negative leaves does not match.\n";
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST26 : Compact recursive tree, std::string concatenation
+ *  --------------------------
+ */
+
+int test_Compact_StringConcatenation(){
+    // Just above powers of two, where the heap order wastes most
+    std::size_t lengths[] = {1, 2, 3, 17, 65, 1025};
+
+    for(std::size_t len : lengths){
+        std::vector<std::string> values;
+        for(std::size_t i = 0; i < len; i++)
+            values.push_back(std::string(1, 'a' + rand() % 26));
+
+        SegmentTree<std::string, addString> s_tree1 = {values, addString{}, TREE_COMPACT};
+        SegmentTree<std::string, addString> s_tree2 = {values, addString{}, TREE_COMPACT, 4};
+
+        for(int i = 0; i < 300; i++){
+            std::size_t l = rand() % len;
+
+            if(rand() % 3 == 0){
+                std::vector<std::size_t> indices = {l, rand() % len};
+                std::vector<std::string> batch = {std::string(2, 'A' + rand() % 26), std::string(1, 'z')};
+                values[indices[0]] = batch[0];
+                values[indices[1]] = batch[1];
+                s_tree1.UpdateBatch(indices, batch);
+                s_tree2.Update(batch[0], indices[0]);
+                s_tree2.Update(batch[1], indices[1]);
+                continue;
+            }
+
+            std::size_t r = l + rand() % (len - l);
+            std::string brute_force_ans;
+            for(std::size_t j = l; j <= r; j++)
+                brute_force_ans += values[j];
+
+            if(brute_force_ans != s_tree1.Query(l, r) || brute_force_ans != s_tree2.Query(l, r)){
+                std::cerr << "test_Compact_StringConcatenation:\n\tRange from " << l << " to " << r
+                    << " of " << len << " leaves does not match.\n";
+                return 0;
+            }
+        }
+    }
+
+    if(SegmentTree<int>::GetTreeSize(1025) != 4095 || SegmentTree<int>::GetTreeSize(1024) != 2047){
+        std::cerr << "test_Compact_StringConcatenation:\n\tGetTreeSize does not match.\n";
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST27 : vEB ordered recursive tree, sums and prefix search
+ *  --------------------------
+ */
+
+int test_Veb_SumAndSearch(){
+    // One level, a power of two, and depths that split unevenly
+    std::size_t lengths[] = {1, 2, 5, 64, 100, 3000};
+    std::string path = "test_Veb.segtree";
+
+    for(std::size_t len : lengths){
+        std::vector<long long> values;
+        for(std::size_t i = 0; i < len; i++)
+            values.push_back(rand() % 100);
+
+        SegmentTree<long long, SumOp<long long>> s_tree1 = {values, SumOp<long long>{}, TREE_VEB};
+        SegmentTree<long long, SumOp<long long>> s_tree2 = {values, SumOp<long long>{}, TREE_VEB, 4};
+
+        for(int i = 0; i < 300; i++){
+            std::size_t l = rand() % len;
+
+            if(rand() % 3 == 0){
+                std::vector<std::size_t> indices = {l, rand() % len};
+                std::vector<long long> batch = {rand() % 100LL, rand() % 100LL};
+                values[indices[0]] = batch[0];
+                values[indices[1]] = batch[1];
+                s_tree1.UpdateBatch(indices, batch);
+                s_tree2.Update(batch[0], indices[0]);
+                s_tree2.Update(batch[1], indices[1]);
+                continue;
+            }
+
+            std::size_t r = l + rand() % (len - l);
+            long long brute_force_ans = 0;
+            for(std::size_t j = l; j <= r; j++)
+                brute_force_ans += values[j];
+
+            // First r from l whose prefix reaches a random bound
+            long long bound = rand() % 1000;
+            std::size_t first = len;
+            long long prefix = 0;
+            for(std::size_t j = l; j < len; j++){
+                prefix += values[j];
+                if(prefix >= bound){
+                    first = j;
+                    break;
+                }
+            }
+
+            if(brute_force_ans != s_tree1.Query(l, r) || brute_force_ans != s_tree2.Query(l, r)){
+                std::cerr << "test_Veb_SumAndSearch:\n\tRange from " << l << " to " << r
+                    << " of " << len << " leaves does not match.\n";
+                return 0;
+            }
+            if(s_tree1.FindFirst(l, [bound](long long const &sum){ return sum >= bound; }) != first){
+                std::cerr << "test_Veb_SumAndSearch:\n\tFindFirst from " << l
+                    << " of " << len << " leaves does not match.\n";
+                return 0;
+            }
+        }
+
+        // Saved nodes are in vEB order, and map back as they were
+        s_tree1.Save(path);
+        SegmentTree<long long, SumOp<long long>> s_tree3 =
+            SegmentTree<long long, SumOp<long long>>::Open(path, SumOp<long long>{});
+        for(std::size_t l = 0; l < len; l += 1 + len / 10){
+            if(s_tree3.Query(l, len - 1) != s_tree1.Query(l, len - 1)){
+                std::cerr << "test_Veb_SumAndSearch:\n\tOpened tree of " << len << " leaves does not match.\n";
+                std::remove(path.c_str());
+                return 0;
+            }
+        }
+    }
+    std::remove(path.c_str());
+
+    return 1;
+}
+
+
+/*
+ *  ---------------------------
+ *  TEST28 : Nodes from HugePageAllocator, sums
+ *  --------------------------
+ */
+
+// Stateful allocator that records the id of the last instance that
+// allocated, to check that a tree keeps the allocator it was given.
+int tagged_last_id = -1;
+
+template <typename T>
+struct TaggedAllocator{
+    typedef T value_type;
+    int id;
+
+    explicit TaggedAllocator(int id = 0) : id(id) {}
+    template <typename U>
+    TaggedAllocator(TaggedAllocator<U> const &other) : id(other.id) {}
+
+    T *allocate(std::size_t n){
+        tagged_last_id = id;
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, std::size_t n){ std::allocator<T>().deallocate(p, n); }
+};
+
+template <typename T, typename U>
+bool operator==(TaggedAllocator<T> const &, TaggedAllocator<U> const &){ return true; }
+template <typename T, typename U>
+bool operator!=(TaggedAllocator<T> const &, TaggedAllocator<U> const &){ return false; }
+
+int test_HugePage_Sum(){
+    // Enough nodes for the mapped path of the allocator
+    std::size_t len = 300000;
+    std::vector<long long> values;
+    for(std::size_t i = 0; i < len; i++)
+        values.push_back(rand() % 1000);
+
+    typedef HugePageAllocator<long long> Alloc;
+    // Explicit pages fall back when none are reserved, and mbind fails
+    // harmlessly where there is no NUMA support.
+    Alloc allocs[] = {Alloc(HUGE_PAGES_NONE), Alloc(HUGE_PAGES_TRANSPARENT),
+                      Alloc(HUGE_PAGES_EXPLICIT, NUMA_INTERLEAVE, 1), Alloc(HUGE_PAGES_TRANSPARENT, NUMA_BIND, 1)};
+    int types[] = {TREE_ITERATIVE, TREE_RECURSIVE, TREE_WIDE, TREE_BLOCKED};
+
+    for(int t = 0; t < 4; t++){
+        SegmentTree<long long, SumOp<long long>, Alloc> s_tree1 = {values, SumOp<long long>{}, types[t], 1, allocs[t]};
+        std::vector<long long> brute_force = values;
+
+        for(int i = 0; i < 200; i++){
+            std::size_t l = rand() % len;
+            std::size_t r = l + rand() % std::min<std::size_t>(len - l, 1000);
+
+            if(i % 2 == 0){
+                long long value = rand() % 1000;
+                brute_force[l] = value;
+                s_tree1.Update(value, l);
+            }
+
+            long long brute_force_ans = 0;
+            for(std::size_t j = l; j <= r; j++)
+                brute_force_ans += brute_force[j];
+
+            if(brute_force_ans != s_tree1.Query(l, r)){
+                std::cerr << "test_HugePage_Sum:\n\tRange from " << l << " to " << r
+                    << " of tree type " << types[t] << " does not match.\n";
+                return 0;
+            }
+        }
+
+        // A copy allocates from the same allocator
+        SegmentTree<long long, SumOp<long long>, Alloc> s_tree2 = s_tree1;
+        if(s_tree2.Query(0, len - 1) != s_tree1.Query(0, len - 1)){
+            std::cerr << "test_HugePage_Sum:\n\tCopy of tree type " << types[t] << " does not match.\n";
+            return 0;
+        }
+    }
+
+    // Small blocks, below a huge page, come from operator new
+    SegmentTree<long long, SumOp<long long>, Alloc> s_tree3 = {1LL, 10, SumOp<long long>{}, TREE_ITERATIVE};
+    for(int i = 0; i < 100; i++)
+        s_tree3.PushBack(1LL);
+    if(s_tree3.Query(0, 109) != 110){
+        std::cerr << "test_HugePage_Sum:\n\tGrown tree does not match.\n";
+        return 0;
+    }
+
+    // Every way to build a tree keeps the allocator it is given
+    typedef SegmentTree<int, SumOp<int>, TaggedAllocator<int>> TaggedTree;
+    std::string text_path = "test_HugePage.txt", binary_path = "test_HugePage.bin";
+    std::vector<int> ints(100, 1);
+    {
+        std::ofstream text(text_path.c_str());
+        for(int v : ints)
+            text << v << ' ';
+        std::ofstream binary(binary_path.c_str(), std::ios::binary);
+        binary.write(reinterpret_cast<char const *>(ints.data()), ints.size() * sizeof(int));
+    }
+    TaggedTree(ints, SumOp<int>{}, TREE_ITERATIVE).Save(binary_path + ".segtree");
+
+    for(int t = 0; t < 4; t++){
+        tagged_last_id = -1;
+        std::istringstream stream("1 2 3 4");
+
+        if(t == 0)
+            TaggedTree(std::istream_iterator<int>(stream), std::istream_iterator<int>(),
+                       SumOp<int>{}, TREE_RECURSIVE, 1, TaggedAllocator<int>(7));
+        else if(t == 1)
+            TaggedTree::LoadText(text_path, SumOp<int>{}, TREE_ITERATIVE, 1, TaggedAllocator<int>(7));
+        else if(t == 2)
+            TaggedTree::LoadBinary(binary_path, SumOp<int>{}, TREE_BLOCKED, 1, TaggedAllocator<int>(7));
+        else{
+            // Mapped nodes use no allocator until PushBack grows them
+            TaggedTree opened = TaggedTree::Open(binary_path + ".segtree", SumOp<int>{}, MAP_COPY_ON_WRITE,
+                                                 false, TaggedAllocator<int>(7));
+            opened.PushBack(1);
+        }
+
+        if(tagged_last_id != 7){
+            std::cerr << "test_HugePage_Sum:\n\tConstruction " << t << " did not use the given allocator.\n";
+            return 0;
+        }
+    }
+    std::remove(text_path.c_str());
+    std::remove(binary_path.c_str());
+    std::remove((binary_path + ".segtree").c_str());
+
+    return 1;
+}
+
+
 /*
  *  ---------------------------
  *  Main Function, calls every test 
@@ -392,7 +2234,7 @@ int main(){
     srand(time(NULL));
 
     int successful_tests = 0;
-    int total_tests = 4;
+    int total_tests = 28;
 
     // GetTreeSize testing
     successful_tests += test_GetTreeSize();
@@ -407,6 +2249,78 @@ int main(){
     // maximum contiguous sum using function pointer (recursive and iterative)
     successful_tests += test_FunctionPointer_MaximumSubarray();
 
+    // min and sum through compile-time Op policies (recursive and iterative)
+    successful_tests += test_Policy_MinAndSum();
+
+    // lazy range updates (recursive and iterative)
+    successful_tests += test_Lazy_RangeUpdates();
+
+    // batched queries (recursive and iterative)
+    successful_tests += test_QueryBatch_StringConcatenation();
+
+    // batched updates and overwrites (recursive and iterative)
+    successful_tests += test_UpdateBatch_MaximumSubarray();
+
+    // std::string concatenation on the wide layout
+    successful_tests += test_Wide_StringConcatenation();
+
+    // vectorized kernels for arithmetic policies (iterative and wide)
+    successful_tests += test_Simd_MaxAndXor();
+
+    // multi-threaded build (recursive and iterative)
+    successful_tests += test_ParallelBuild_StringConcatenation();
+
+    // lock-free readers alongside a writer (iterative and recursive)
+    successful_tests += test_Concurrent_MonotonicSums();
+
+    // sharded tree with concurrent writers (iterative and recursive)
+    successful_tests += test_Sharded_StringConcatenation();
+
+    // snapshots, path copying and compaction of a persistent tree
+    successful_tests += test_Persistent_StringConcatenation();
+
+    // nodes created on demand over 64-bit keys
+    successful_tests += test_Sparse_StringConcatenation();
+
+    // trees saved to and mapped from a file (all types)
+    successful_tests += test_SaveOpen_MaximumSubarray();
+
+    // iterators, moved vectors and leaf files (all types)
+    successful_tests += test_IteratorAndLoad_Sum();
+
+    // operations that accumulate in place, and moved updates (all types)
+    successful_tests += test_InPlace_StringConcatenation();
+
+    // FindFirst, FindLast and PrefixLowerBound (all types)
+    successful_tests += test_FindFirstAndLast_Sum();
+
+    // appending leaves to a growing iterative tree
+    successful_tests += test_PushBack_StringConcatenation();
+
+    // ring buffer windows with wraparound (iterative)
+    successful_tests += test_SlidingWindow_StringConcatenation();
+
+    // rectangle queries on a grid (2D iterative)
+    successful_tests += test_Grid_SumAndMax();
+
+    // prefix differences with an inverse operation (Fenwick)
+    successful_tests += test_Fenwick_SumAndXor();
+
+    // constant time queries of idempotent operations (sparse table)
+    successful_tests += test_SparseTable_MinAndGcd();
+
+    // leaves in contiguous blocks under a block tree (blocked)
+    successful_tests += test_Blocked_StringConcatenation();
+
+    // top-down tree in exactly 2n - 1 nodes (compact)
+    successful_tests += test_Compact_StringConcatenation();
+
+    // recursive tree in cache-oblivious vEB order (vEB)
+    successful_tests += test_Veb_SumAndSearch();
+
+    // nodes allocated on huge pages, with NUMA placement (HugePageAllocator)
+    successful_tests += test_HugePage_Sum();
+
     if(total_tests == successful_tests){
         std::cout << "\033[1;32mALL ("<< total_tests <<") TESTS PASSED\033[0m\n";
     }